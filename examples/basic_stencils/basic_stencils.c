@@ -343,9 +343,9 @@ void print_usage(char *argv[]) {
 		fprintf(stderr, " to use the generic stencil kernel for any shape,\n");
 		fprintf(stderr, "\t      instead of a shape-specific optimized one. E.g.: _2d4\n");
 		fprintf(stderr, "\nEnvironment variables:\n");
-		fprintf(stderr, "\tEPSILOD_READ_INPUT=none|array|tile Read input from file Matrix.in\n");
-		fprintf(stderr, "\tEPSILOD_WRITE_OUTPUT=none|array|tile Write output to file Matrix.out\n");
-		fprintf(stderr, "\tEPSILOD_WRITE_INPUT=none|array|tile Wite input to file Matrix.copy\n");
+		fprintf(stderr, "\tEPSILOD_READ_INPUT=none|array|tile|mpiio|chunked Read input from file Matrix.in\n");
+		fprintf(stderr, "\tEPSILOD_WRITE_OUTPUT=none|array|tile|mpiio|chunked Write output to file Matrix.out\n");
+		fprintf(stderr, "\tEPSILOD_WRITE_INPUT=none|array|tile|mpiio|chunked Wite input to file Matrix.copy\n");
 		epsilod_print_usage();
 		hit_filePrintUsage();
 		fprintf(stderr, "\n");
@@ -544,6 +544,7 @@ int main(int argc, char *argv[]) {
 	// Launch stencil computation
 	stencilComputation(sizes, shpStencil, stencilData, factor, numIter, NULL, f_init, NULL, f_stencil, NULL, NULL, device_selection_file);
 
+	epsilod_output_wait();
 	Ctrl_Finalize();
 	return 0;
 }
@@ -308,11 +308,22 @@ int main(int argc, char *argv[]) {
 	memcpy(ext_params.offsets, offsets, Q * sizeof(vec3f));
 	memcpy(ext_params.opposite, opposite, Q * sizeof(unsigned char));
 	memcpy(ext_params.wis, wis, Q * sizeof(GASSIMULATION_CELL_TYPE));
+
+	/* Halos only carry the distributions streamed from each neighbour. Same axes order as the kernel streaming step */
+	int component_offsets[Q * 3];
+	for (int i = 0; i < Q; i++) {
+		component_offsets[i * 3 + 0] = (int)offsets[i].y;
+		component_offsets[i * 3 + 1] = (int)offsets[i].x;
+		component_offsets[i * 3 + 2] = (int)offsets[i].z;
+	}
+	epsilod_set_component_offsets(Q, 3, component_offsets);
+
 	stencilComputation(sizes, shp_stencil_gassimulation, stencilData_gassimulation, 1.0f, iterations, NULL, f_init, NULL, f_stencil, outputData, &ext_params, device_selection_file);
 	// stencilComputation(sizes, shp_stencil_gassimulation, stencilData_gassimulation, 1.0f, iterations, initData, NULL, f_stencil, outputData, &ext_params, device_selection_file);
 	// stencilComputation(sizes, shp_stencil_gassimulation, stencilData_gassimulation, 1.0f, iterations, initData, f_init, f_stencil, outputData, &ext_params, device_selection_file);
 
 	/* END */
+	epsilod_output_wait();
 	Ctrl_Finalize();
 	return 0;
 }
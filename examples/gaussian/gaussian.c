@@ -276,6 +276,7 @@ int main(int argc, char *argv[]) {
 	stencilComputation(sizes, shp_stencil_gaussian, stencilData_gaussian, 1.0f, iterations, initData, NULL, NULL, f_stencil, outputData, &ext_params, device_selection_file);
 
 	/* END */
+	epsilod_output_wait();
 	Ctrl_Finalize();
 	return 0;
 }
@@ -79,6 +79,7 @@ int main(int argc, char *argv[]) {
 	stencilComputation(sizes, stencil_shp, stencil_data, 1.0f, iterations, NULL, f_init, NULL, f_stencil, NULL, &ext_params, device_selection_file);
 
 	/* END */
+	epsilod_output_wait();
 	Ctrl_Finalize();
 	return EXIT_SUCCESS;
 }
@@ -108,6 +108,7 @@ int main(int argc, char *argv[]) {
 	stencilComputation(sizes, shp_stencil_poisson, stencilData_poisson, 1.0f, iterations, initData, NULL, NULL, f_stencil, NULL, &ext_params, device_selection_file);
 
 	/* END */
+	epsilod_output_wait();
 	Ctrl_Finalize();
 	return 0;
 }
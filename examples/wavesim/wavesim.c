@@ -129,6 +129,7 @@ int main(int argc, char *argv[]) {
 	stencilComputation(sizes, shp_stencil, stencilData, 1.0f, iterations, NULL, f_init, f_init_copy, f_stencil, outputData, &ext_params, device_selection_file);
 
 	/* END */
+	epsilod_output_wait();
 	Ctrl_Finalize();
 	return 0;
 }
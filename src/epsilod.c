@@ -7,10 +7,21 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 
 #include "epsilod.h"
+#include "epsilod_codec.h"
 #include "epsilod_env.h"
+#include "epsilod_grid.h"
+#include "epsilod_mapping.h"
 #include "epsilod_log.h"
+#include "epsilod_progress.h"
+#include "epsilod_weights.h"
+
+// Device-aware support queries of Open MPI
+#if defined(OPEN_MPI) && OPEN_MPI
+#include <mpi-ext.h>
+#endif
 
 /* B. Generic kernel prototype and wrapper launchers */
 #if EPSILOD_IS_FLOAT(EPSILOD_BASE_TYPE)
@@ -112,6 +123,40 @@ CTRL_KERNEL_PROTO(epsilod_dev_copy_4d, 2,
 				  IN, HitTile(EPSILOD_BASE_TYPE), matrix,
 				  OUT, HitTile(EPSILOD_BASE_TYPE), matrix_out);
 
+#if CTRL_COUNTPARAM(EPSILOD_BASE_TYPE_COMPOUND) == 2
+CTRL_KERNEL_CHAR(epsilod_dev_copy_masked_1d, MANUAL, 0, 0, 0);
+CTRL_KERNEL_PROTO(epsilod_dev_copy_masked_1d, 1,
+				  GENERIC, DEFAULT,
+				  3,
+				  IN, HitTile(EPSILOD_BASE_TYPE), matrix,
+				  OUT, HitTile(EPSILOD_BASE_TYPE), matrix_out,
+				  INVAL, EpsilodComponentMask, mask);
+
+CTRL_KERNEL_CHAR(epsilod_dev_copy_masked_2d, MANUAL, 0, 0, 0);
+CTRL_KERNEL_PROTO(epsilod_dev_copy_masked_2d, 1,
+				  GENERIC, DEFAULT,
+				  3,
+				  IN, HitTile(EPSILOD_BASE_TYPE), matrix,
+				  OUT, HitTile(EPSILOD_BASE_TYPE), matrix_out,
+				  INVAL, EpsilodComponentMask, mask);
+
+CTRL_KERNEL_CHAR(epsilod_dev_copy_masked_3d, MANUAL, 0, 0, 0);
+CTRL_KERNEL_PROTO(epsilod_dev_copy_masked_3d, 1,
+				  GENERIC, DEFAULT,
+				  3,
+				  IN, HitTile(EPSILOD_BASE_TYPE), matrix,
+				  OUT, HitTile(EPSILOD_BASE_TYPE), matrix_out,
+				  INVAL, EpsilodComponentMask, mask);
+
+CTRL_KERNEL_CHAR(epsilod_dev_copy_masked_4d, MANUAL, 0, 0, 0);
+CTRL_KERNEL_PROTO(epsilod_dev_copy_masked_4d, 1,
+				  GENERIC, DEFAULT,
+				  3,
+				  IN, HitTile(EPSILOD_BASE_TYPE), matrix,
+				  OUT, HitTile(EPSILOD_BASE_TYPE), matrix_out,
+				  INVAL, EpsilodComponentMask, mask);
+#endif // CTRL_COUNTPARAM(EPSILOD_BASE_TYPE_COMPOUND) == 2
+
 /* D. False initialization of selections to avoid non-initialized warnings */
 CTRL_KERNEL_CHAR(epsilod_dev_touch, MANUAL, 0, 0, 0);
 CTRL_KERNEL_PROTO(epsilod_dev_touch, 2,
@@ -151,6 +196,24 @@ HitClock iter_clock;
 HitClock redistribute_clock;
 HitClock commClock;
 
+/**
+ * Parts of the time of the current iteration, for the ALB load
+ */
+static EpsilodIterTimes iter_times;
+
+/**
+ * Snapshots of the domain: two staging tiles, filled alternately in the device and written by the background writer
+ */
+static struct {
+	HitTile(EPSILOD_BASE_TYPE) mat[2];  /**< Staging copies of the local tile */
+	HitTile(EPSILOD_BASE_TYPE) io[2];   /**< IO tiles of the staging copies */
+	int                        next;    /**< Staging tile of the next snapshot */
+	int                        pending; /**< Iteration of the snapshot in the other staging tile, not yet handed to the writer. 0 if none */
+} snapshots = {
+	.mat = {HIT_TILE_NULL_STATIC, HIT_TILE_NULL_STATIC},
+	.io  = {HIT_TILE_NULL_STATIC, HIT_TILE_NULL_STATIC},
+};
+
 void epsilod_print_usage() {
 	if (hit_Rank == 0) {
 		fprintf(stderr, "\nEPSILOD environment variables:\n");
@@ -158,15 +221,56 @@ void epsilod_print_usage() {
 		fprintf(stderr, "\tEPSILOD_PARTITION=m          Regular blocks of similar sizes on a multidimensional grid topology with the matrix dimensions\n");
 		fprintf(stderr, "\tEPSILOD_PARTITION=m<n_dims>  Regular blocks of similar sizes on the first <n_dims> dimensions\n");
 		fprintf(stderr, "\tEPSILOD_PARTITION=s<dim>     Regular blocks of similar sizes on a single dimension topology\n");
+		fprintf(stderr, "\tEPSILOD_PARTITION=n<dim>     Regular blocks of similar sizes on every dimension except <dim>, that is not partitioned\n");
+		fprintf(stderr, "\tEPSILOD_PARTITION=auto       Regular partition (m, s or n) with the smallest halo volume for the domain and stencil radii\n");
 		fprintf(stderr, "\tEPSILOD_PARTITION=w<dim>     Weigthed block distribution in the single chosen dimension.\n");
 		fprintf(stderr, "\t                             Processes weigths are specified in the device selection configuratuion file.\n");
+		fprintf(stderr, "\tEPSILOD_PARTITION=g          Weighted blocks on a multidimensional grid topology. Each slab of the grid gets a share\n");
+		fprintf(stderr, "\t                             of its dimension proportional to the weights of its processes.\n");
+		fprintf(stderr, "\tEPSILOD_PARTITION=g<n_dims>  Weighted grid on the first <n_dims> dimensions\n");
 		fprintf(stderr, "\t" BOLD_TEXT "NOTE:" REGULAR_TEXT " The default behaviour corresponds to s0.\n");
+		fprintf(stderr, "\tEPSILOD_NODE_MAPPING=y|n     Map neighbour blocks of m and n partitions to processes in the same node and socket.\n");
 		fprintf(stderr, "\tEPSILOD_ALB_HEUR=none        Rebalancing deactivated.\n");
 		fprintf(stderr, "\tEPSILOD_ALB_HEUR=NextALB     Try to estimate in which iteration will a new rebalancing be needed.\n");
 		fprintf(stderr, "\tEPSILOD_ALB_HEUR=ConstIters  Rebalance after a constant number of iterations.\n");
 		fprintf(stderr, "\tEPSILOD_ALB_HEUR=ExpIters    Rebalance after a exponentially increasing number of iterations.\n");
 		fprintf(stderr, "\tEPSILOD_ALB_HEUR=DoubleIters Rebalance after an amount of iterations that doubles each time number of iterations.\n");
-		fprintf(stderr, "\t" BOLD_TEXT "NOTE:" REGULAR_TEXT " The default behaviour corresponds to none. Anything else requires w partition.\n");
+		fprintf(stderr, "\tEPSILOD_ALB_HEUR=CostBenefit Rebalance when the time saved over the remaining iterations exceeds the redistribution cost.\n");
+		fprintf(stderr, "\tEPSILOD_ALB_HEUR=<name>      Heuristic registered by the application with epsilod_register_heuristic().\n");
+		fprintf(stderr, "\tEPSILOD_ALB_MARGIN=<ratio>   Noise margin of CostBenefit: imbalance and cost ratio ignored. Default: 0.1.\n");
+		fprintf(stderr, "\tEPSILOD_ALB_LOAD=<c>,<p>,<t>,<w> Weights of the compute, pack, DtoH/HtoD and MPI wait times in the load. Default: 1,1,1,0.\n");
+		fprintf(stderr, "\tEPSILOD_CALIBRATE=y|n        Time a few iterations at startup and rebuild w and g partitions with the measured weights.\n");
+		fprintf(stderr, "\tEPSILOD_WEIGHTS_CACHE=<file> Keep the weights learned by calibration or ALB, by device configuration and problem.\n");
+		fprintf(stderr, "\t" BOLD_TEXT "NOTE:" REGULAR_TEXT " The default behaviour corresponds to none. Anything else requires w or g partition.\n");
+		fprintf(stderr, "\tEPSILOD_ALB_MIGRATION=full|incremental  Redistribute the whole domain, or move only the cells that change owner.\n");
+		fprintf(stderr, "\tEPSILOD_ALB_ASYNC=y|n           Build the new partition while iterating, then migrate incrementally.\n");
+		fprintf(stderr, "\tEPSILOD_ALB_MODEL=linear|fit    Kernel time proportional to the local size, or fitted with a fixed cost per process.\n");
+		fprintf(stderr, "\tEPSILOD_ALB_NODE_PERIOD=<n>     Rebalance the processes of each node every <n> iterations, between global rounds (w).\n");
+		fprintf(stderr, "\tEPSILOD_COMM_METHOD=host_early  Post halo receives before computing. Requires contiguous buffers.\n");
+		fprintf(stderr, "\tEPSILOD_COMM_METHOD=auto        Time the valid settings before the warm-up and keep the fastest. Also accepted by\n");
+		fprintf(stderr, "\t                                EPSILOD_COMMS_CONTIGUOUS_BUFFERS, EPSILOD_ALIGN and EPSILOD_MPI_DEV_AWARE.\n");
+		fprintf(stderr, "\tEPSILOD_PROGRESS_THREAD=y|n     Drive MPI progress from a helper thread while kernels run (host_early).\n");
+		fprintf(stderr, "\tEPSILOD_PROGRESS_CORE=<core>    Core of the progress thread. Default: last core of the process affinity mask.\n");
+		fprintf(stderr, "\tEPSILOD_HALO_CODEC=none         Halos are sent as they are packed.\n");
+		fprintf(stderr, "\tEPSILOD_HALO_CODEC=shuffle      Lossless byte shuffle of the cell components.\n");
+		fprintf(stderr, "\tEPSILOD_HALO_CODEC=lz4|zstd     Lossless byte shuffle and compression. Requires EPSILOD_WITH_LZ4/EPSILOD_WITH_ZSTD builds.\n");
+		fprintf(stderr, "\tEPSILOD_HALO_CODEC=fp32         Lossy transport of double precision components as single precision.\n");
+		fprintf(stderr, "\t" BOLD_TEXT "NOTE:" REGULAR_TEXT " Halo codecs require host staging and contiguous buffers, and imply host_early.\n");
+		fprintf(stderr, "\tEPSILOD_SKIP_UNCHANGED_HALOS=y|n Send an empty message instead of a halo equal to the last one sent (host_early).\n");
+		fprintf(stderr, "\tEPSILOD_HALO_CHUNK_KB=<size>    Split halos in chunks of <size> KiB to pipeline DtoH, MPI and HtoD transfers (host_early). Default: 0, no split.\n");
+		fprintf(stderr, "\tEPSILOD_INPUT_FILE=<file>       File read by EPSILOD_READ_INPUT. Default: Matrix.in.\n");
+		fprintf(stderr, "\tEPSILOD_INPUT_COPY_FILE=<file>  File written by EPSILOD_WRITE_INPUT. Default: Matrix.copy.\n");
+		fprintf(stderr, "\tEPSILOD_OUTPUT_FILE=<file>      File written by EPSILOD_WRITE_OUTPUT. Default: Matrix.out.\n");
+		fprintf(stderr, "\tEPSILOD_MPIIO_HINTS=<k>=<v>,... MPI-IO hints of the mpiio and chunked file modes, e.g. romio_cb_write=enable,cb_buffer_size=16777216.\n");
+		fprintf(stderr, "\tEPSILOD_CHUNK_KB=<size>         Approximate size of the chunks written in the chunked file mode. Default: 1024.\n");
+		fprintf(stderr, "\tEPSILOD_CHUNK_CHECKSUMS=y|n     Store a checksum per chunk in the chunked file mode. They are verified when reading.\n");
+		fprintf(stderr, "\tEPSILOD_CHUNK_CODEC=none|lz4|zstd Compress the chunked file mode in parallel, after a byte shuffle. Default: none.\n");
+		fprintf(stderr, "\tEPSILOD_ASYNC_OUTPUT=y|n        Write the final output in a background thread. Requires MPI_THREAD_MULTIPLE, and the default output in mpiio or chunked mode.\n");
+		fprintf(stderr, "\t" BOLD_TEXT "NOTE:" REGULAR_TEXT " Call epsilod_output_wait() before Ctrl_Finalize() when the output is asynchronous.\n");
+		fprintf(stderr, "\tEPSILOD_SNAPSHOT_EVERY=<n>      Write a snapshot of the domain every <n> iterations. Default: 0, none.\n");
+		fprintf(stderr, "\tEPSILOD_SNAPSHOT_AT=<i>,...     Write a snapshot of the domain after the listed iterations.\n");
+		fprintf(stderr, "\tEPSILOD_SNAPSHOT_FILE=<prefix>  Prefix of the snapshot files, followed by the iteration. Default: Snapshot.\n");
+		fprintf(stderr, "\t" BOLD_TEXT "NOTE:" REGULAR_TEXT " Snapshots use the EPSILOD_WRITE_OUTPUT mode, or chunked if it is none. Only mpiio and chunked snapshots are written in the background.\n");
 	}
 }
 
@@ -271,18 +375,9 @@ Ctrl_Info *get_ctrl_info() {
 
 typedef void (*CommsFunction)(PCtrl, EpsilodTiles *, EpsilodCommArgs *, EpsilodThreads, EpsilodThreads);
 typedef void (*CommsInnerFunction)(PCtrl, EpsilodTiles *, EpsilodCommArgs *);
+typedef void (*CommsPrepareFunction)(PCtrl, EpsilodTiles *, EpsilodCommArgs *);
 
-/**
- * @brief Transfer data from one tile to another using a compute kernel.
- * Input and output tiles must have the same shape.
- * @param comm Controller pointer
- * @param tile_src Input tile
- * @param tile_dst Output tile
- * @param thread Kernel thread space
- * @param block Kernel blocksize
- * @param stream Kernel stream number
- */
-void transfer_tile(PCtrl comm, HitTile(EPSILOD_BASE_TYPE) tile_src, HitTile(EPSILOD_BASE_TYPE) tile_dst, Ctrl_Thread thread, Ctrl_Thread block, int stream) {
+void transfer_tile(PCtrl comm, HitTile(EPSILOD_BASE_TYPE) tile_src, HitTile(EPSILOD_BASE_TYPE) tile_dst, Ctrl_Thread thread, Ctrl_Thread block, int stream, const EpsilodComponentMask *mask) {
 
 	if (!hit_shapeCmp(tile_src.shape, tile_dst.shape)) {
 		fprintf(stderr, "\nError: Tried to transfer tiles with no matching shapes.\n\n");
@@ -291,6 +386,16 @@ void transfer_tile(PCtrl comm, HitTile(EPSILOD_BASE_TYPE) tile_src, HitTile(EPSI
 	}
 
 	int dims = hit_tileDims(tile_src);
+	#if CTRL_COUNTPARAM(EPSILOD_BASE_TYPE_COMPOUND) == 2
+	if (mask != NULL) {
+		switch (dims) {
+			case 1: Ctrl_LaunchToStream(comm, epsilod_dev_copy_masked_1d, thread, block, stream, tile_src, tile_dst, *mask); return;
+			case 2: Ctrl_LaunchToStream(comm, epsilod_dev_copy_masked_2d, thread, block, stream, tile_src, tile_dst, *mask); return;
+			case 3: Ctrl_LaunchToStream(comm, epsilod_dev_copy_masked_3d, thread, block, stream, tile_src, tile_dst, *mask); return;
+			case 4: Ctrl_LaunchToStream(comm, epsilod_dev_copy_masked_4d, thread, block, stream, tile_src, tile_dst, *mask); return;
+		}
+	}
+	#endif // CTRL_COUNTPARAM(EPSILOD_BASE_TYPE_COMPOUND) == 2
 	switch (dims) {
 		case 1: Ctrl_LaunchToStream(comm, epsilod_dev_copy_1d, thread, block, stream, tile_src, tile_dst); break;
 		case 2: Ctrl_LaunchToStream(comm, epsilod_dev_copy_2d, thread, block, stream, tile_src, tile_dst); break;
@@ -319,13 +424,15 @@ void unmarshall_halos(PCtrl comm, EpsilodTiles *tiles, EpsilodThreads threads, E
 		if (hit_tileIsNull(tiles->cont_border_in[i]))
 			continue;
 		int stream = i % get_ctrl_info()->n_kernel_queues;
-		transfer_tile(comm, tiles->cont_border_in[i], tiles->border_in[i], threads.cont_border_in[i], chars.cont_border_in[i], stream);
+		const EpsilodComponentMask *mask = tiles->cont_mask_in == NULL ? NULL : &tiles->cont_mask_in[i];
+		transfer_tile(comm, tiles->cont_border_in[i], tiles->border_in[i], threads.cont_border_in[i], chars.cont_border_in[i], stream, mask);
 	}
 	for (int i = 0; i < num_borders; i++) {
 		// Skip empty borders
 		if (hit_tileIsNull(tiles->border_in[i]))
 			continue;
 		Ctrl_WaitTile(comm, tiles->border_in[i]);
+		iter_times.pack += Ctrl_TimeLastOp(comm, tiles->border_in[i]);
 	}
 }
 
@@ -343,6 +450,15 @@ CommsFunction do_comms;
  */
 CommsInnerFunction do_comms_inner;
 
+/**
+ * @brief Prepare communications of a set of tiles before its computation starts.
+ * Only called when the computation is followed by do_comms.
+ * @param comm Controller object
+ * @param tiles Tiles to communicate
+ * @param args Arguments for communications
+ */
+CommsPrepareFunction do_comms_prepare;
+
 /**
  * @brief Perform communications with host staging buffers.
  * This includes host-device communications and interprocess communications
@@ -353,8 +469,9 @@ CommsInnerFunction do_comms_inner;
  * @param chars Blocksizes for kernels
  */
 void do_comms_host(PCtrl comm, EpsilodTiles *tiles, EpsilodCommArgs *args, EpsilodThreads threads, EpsilodThreads chars) {
-	int dims        = hit_tileDims(tiles->mat);
-	int num_borders = epsilod_num_borders(dims);
+	int    dims        = hit_tileDims(tiles->mat);
+	int    num_borders = epsilod_num_borders(dims);
+	double start       = MPI_Wtime();
 
 	if (comms_contiguous_buffers()) {
 		for (int i = 0; i < num_borders; i++) {
@@ -385,13 +502,18 @@ void do_comms_host(PCtrl comm, EpsilodTiles *tiles, EpsilodCommArgs *args, Epsil
 	}
 
 	hit_clockStart(commClock);
+	double mpi_start = MPI_Wtime();
+	iter_times.transfer += mpi_start - start;
 	do_comms_inner(comm, tiles, args);
+	double mpi_end = MPI_Wtime();
+	iter_times.wait += mpi_end - mpi_start;
 	for (int i = 0; i < num_borders; i++) {
 		// Skip empty borders
 		if (!args->border_in_active[i])
 			continue;
 		Ctrl_WaitTile(comm, tiles->comms_border_in[i]);
 	}
+	iter_times.transfer += MPI_Wtime() - mpi_end;
 	if (comms_contiguous_buffers()) {
 		unmarshall_halos(comm, tiles, threads, chars);
 	}
@@ -454,6 +576,231 @@ static inline void do_comms_host_inner_commall(PCtrl comm, EpsilodTiles *tiles,
 	}
 }
 
+/**
+ * @brief Nothing to prepare for communication methods based on Hitmap patterns.
+ */
+void do_comms_prepare_none(PCtrl comm, EpsilodTiles *tiles, EpsilodCommArgs *args) {}
+
+/**
+ * @brief Size in bytes of a communication tile
+ * @param tile Contiguous communication tile
+ * @return Size in bytes
+ */
+static inline size_t halo_bytes(HitTile(EPSILOD_BASE_TYPE) tile) {
+	return (size_t)hit_tileCard(tile) * sizeof(EPSILOD_BASE_TYPE);
+}
+
+/**
+ * @brief Host buffer for halos reduced to their masked components before encoding, or after decoding.
+ * @param bytes Minimum size of the buffer
+ * @return Buffer, reused between calls
+ */
+static void *masked_halo_buffer(size_t bytes) {
+	static void  *buffer       = NULL;
+	static size_t buffer_bytes = 0;
+	if (bytes > buffer_bytes) {
+		free(buffer);
+		buffer       = malloc(bytes);
+		buffer_bytes = bytes;
+		if (buffer == NULL) {
+			fprintf(stderr, "\nError: Not enough memory for the masked halo buffer.\n\n");
+			MPI_Abort(MPI_COMM_WORLD, MPI_ERR_OTHER);
+			exit(EXIT_FAILURE);
+		}
+	}
+	return buffer;
+}
+
+/**
+ * @brief Whether an outbound chunk has the same contents as in its last send.
+ * Otherwise its contents are kept for the next comparison.
+ * @param tiles Tiles to communicate
+ * @param index Index of the outbound chunk in halo_shadows
+ * @param halo Outbound chunk, in the host
+ * @return true if the chunk is unchanged, false otherwise or in its first send.
+ */
+static bool halo_unchanged(EpsilodTiles *tiles, int index, HitTile(EPSILOD_BASE_TYPE) halo) {
+	size_t bytes  = halo_bytes(halo);
+	void  *shadow = tiles->halo_shadows[index];
+	if (shadow != NULL && memcmp(shadow, halo.data, bytes) == 0)
+		return true;
+
+	if (shadow == NULL) {
+		shadow = malloc(bytes);
+		if (shadow == NULL) {
+			fprintf(stderr, "\nError: Not enough memory for the copy of an outbound halo.\n\n");
+			MPI_Abort(MPI_COMM_WORLD, MPI_ERR_OTHER);
+			exit(EXIT_FAILURE);
+		}
+		tiles->halo_shadows[index] = shadow;
+	}
+	memcpy(shadow, halo.data, bytes);
+	return false;
+}
+
+/**
+ * @brief Post the receives of the inbound halos before computation starts.
+ * Sends of the neighbours can be matched while the kernels run,
+ * and the progress engine advances them in the meantime.
+ * Encoded halos are received in the codec buffers. Other halos are received chunk by chunk.
+ * @param comm Controller object
+ * @param tiles Tiles to communicate
+ * @param args Arguments for communications
+ */
+void do_comms_host_post_recvs(PCtrl comm, EpsilodTiles *tiles, EpsilodCommArgs *args) {
+	int           num_borders = epsilod_num_borders(hit_tileDims(tiles->mat));
+	int           max_chunks  = tiles->max_halo_chunks;
+	MPI_Request  *recvs       = tiles->halo_requests;
+	EpsilodCodec *codec       = epsilod_get_halo_codec();
+
+	for (int i = 0; i < num_borders; i++) {
+		// Skip empty borders
+		if (!args->border_in_active[i])
+			continue;
+		for (int c = 0; c < tiles->num_halo_chunks[i]; c++) {
+			HitTile(EPSILOD_BASE_TYPE) chunk = tiles->halo_chunks[i * max_chunks + c];
+			int ok;
+			if (codec == NULL)
+				ok = MPI_Irecv(chunk.data, (int)hit_tileCard(chunk), args->border_types[i], args->ranks_in[i], EPSILOD_HALO_TAG(i, c), hit_Comm, &recvs[i * max_chunks + c]);
+			else
+				ok = MPI_Irecv(tiles->codec_buffers[i], (int)codec->bound(halo_bytes(chunk)), MPI_BYTE, args->ranks_in[i], EPSILOD_HALO_TAG(i, c), hit_Comm, &recvs[i * max_chunks + c]);
+			hit_mpiTestError(ok, "Failed halo receive");
+		}
+	}
+	epsilod_progress_begin();
+}
+
+/**
+ * @brief Send a chunk of an outbound border, encoding it if a halo codec is selected.
+ * Encoded halos are never split in chunks.
+ * If unchanged halos are skipped, an empty message replaces a chunk equal to the one sent in the previous exchange of these tiles.
+ * @param tiles Tiles to communicate
+ * @param args Arguments for communications
+ * @param codec Halo codec, or NULL
+ * @param border Border index
+ * @param chunk Chunk index
+ */
+static void send_halo_chunk(EpsilodTiles *tiles, EpsilodCommArgs *args, EpsilodCodec *codec, int border, int chunk) {
+	int          num_borders = epsilod_num_borders(hit_tileDims(tiles->mat));
+	int          max_chunks  = tiles->max_halo_chunks;
+	MPI_Request *send        = &tiles->halo_requests[(num_borders + border) * max_chunks + chunk];
+	HitTile(EPSILOD_BASE_TYPE) halo = tiles->halo_chunks[(num_borders + border) * max_chunks + chunk];
+
+	int ok;
+	if (tiles->halo_shadows != NULL && halo_unchanged(tiles, border * max_chunks + chunk, halo)) {
+		ok = MPI_Isend(halo.data, 0, MPI_BYTE, args->ranks_out[border], EPSILOD_HALO_TAG(border, chunk), hit_Comm, send);
+	} else if (codec == NULL) {
+		ok = MPI_Isend(halo.data, (int)hit_tileCard(halo), args->border_types[border], args->ranks_out[border], EPSILOD_HALO_TAG(border, chunk), hit_Comm, send);
+	} else {
+		// Only the masked components are encoded
+		const void *raw       = halo.data;
+		size_t      raw_bytes = halo_bytes(halo);
+		if (args->border_masks != NULL) {
+			void *packed = masked_halo_buffer(raw_bytes);
+			raw_bytes    = epsilod_components_gather(halo.data, (size_t)hit_tileCard(halo), args->border_masks[border], packed);
+			raw          = packed;
+		}
+		void  *encoded       = tiles->codec_buffers[num_borders + border];
+		size_t encoded_bytes = epsilod_codec_encode(codec, raw, raw_bytes, encoded);
+		ok                   = MPI_Isend(encoded, (int)encoded_bytes, MPI_BYTE, args->ranks_out[border], EPSILOD_HALO_TAG(border, chunk), hit_Comm, send);
+	}
+	hit_mpiTestError(ok, "Failed halo send");
+}
+
+/**
+ * @brief Perform communications with host staging buffers and receives posted before computation.
+ * Halos split in chunks are pipelined: each chunk is sent as soon as its DtoH transfer is completed,
+ * and its HtoD transfer is started as soon as it is received.
+ * @see do_comms_host_post_recvs()
+ * @param comm Controller object
+ * @param tiles Tiles to communicate
+ * @param args Arguments for communications
+ * @param threads Thread spaces for kernels
+ * @param chars Blocksizes for kernels
+ */
+void do_comms_host_early(PCtrl comm, EpsilodTiles *tiles, EpsilodCommArgs *args, EpsilodThreads threads, EpsilodThreads chars) {
+	int           num_borders = epsilod_num_borders(hit_tileDims(tiles->mat));
+	int           max_chunks  = tiles->max_halo_chunks;
+	int          *num_chunks  = tiles->num_halo_chunks;
+	MPI_Request  *recvs       = tiles->halo_requests;
+	MPI_Request  *sends       = tiles->halo_requests + num_borders * max_chunks;
+	EpsilodCodec *codec       = epsilod_get_halo_codec();
+	double        start       = MPI_Wtime();
+
+	// Start all DtoH transfers of the buffers. Borders merged into a buffer are moved with it
+	for (int i = 0; i < num_borders; i++) {
+		if (hit_tileIsNull(tiles->cont_border_out[i]))
+			continue;
+		for (int c = 0; c < num_chunks[num_borders + i]; c++)
+			Ctrl_MoveFrom(comm, tiles->halo_chunks[(num_borders + i) * max_chunks + c]);
+	}
+
+	hit_clockStart(commClock);
+	// Send each chunk of a buffer as soon as it is in the host
+	for (int i = 0; i < num_borders; i++) {
+		if (hit_tileIsNull(tiles->cont_border_out[i]))
+			continue;
+		for (int c = 0; c < num_chunks[num_borders + i]; c++) {
+			Ctrl_WaitTile(comm, tiles->halo_chunks[(num_borders + i) * max_chunks + c]);
+			send_halo_chunk(tiles, args, codec, i, c);
+		}
+	}
+	// Borders merged into other buffers, once every buffer is in the host
+	for (int i = 0; i < num_borders; i++) {
+		if (!args->border_out_active[i] || !hit_tileIsNull(tiles->cont_border_out[i]))
+			continue;
+		for (int c = 0; c < num_chunks[num_borders + i]; c++)
+			send_halo_chunk(tiles, args, codec, i, c);
+	}
+	double mpi_start = MPI_Wtime();
+	iter_times.transfer += mpi_start - start;
+
+	// Start move-to for each recv as soon as it is completed (and decoded)
+	for (;;) {
+		int        index;
+		MPI_Status status;
+		int        ok = MPI_Waitany(num_borders * max_chunks, recvs, &index, &status);
+		hit_mpiTestError(ok, "Failed halo wait");
+		if (index == MPI_UNDEFINED)
+			break;
+		int border = index / max_chunks;
+		HitTile(EPSILOD_BASE_TYPE) halo = tiles->halo_chunks[index];
+		int received_bytes;
+		MPI_Get_count(&status, MPI_BYTE, &received_bytes);
+		// Unchanged halo. The buffer still holds it from the previous exchange of these tiles
+		if (tiles->halo_shadows != NULL && received_bytes == 0)
+			continue;
+		if (codec != NULL) {
+			if (args->border_masks == NULL) {
+				epsilod_codec_decode(codec, tiles->codec_buffers[border], (size_t)received_bytes, halo.data, halo_bytes(halo));
+			} else {
+				size_t num_cells = (size_t)hit_tileCard(halo);
+				size_t bytes     = num_cells * args->border_masks[border].count * sizeof(EPSILOD_SCALAR_TYPE);
+				void  *packed    = masked_halo_buffer(bytes);
+				epsilod_codec_decode(codec, tiles->codec_buffers[border], (size_t)received_bytes, packed, bytes);
+				epsilod_components_scatter(packed, num_cells, args->border_masks[border], halo.data);
+			}
+		}
+		Ctrl_MoveTo(comm, halo);
+	}
+	MPI_Waitall(num_borders * max_chunks, sends, MPI_STATUSES_IGNORE);
+	epsilod_progress_end();
+	double mpi_end = MPI_Wtime();
+	iter_times.wait += mpi_end - mpi_start;
+
+	for (int i = 0; i < num_borders; i++) {
+		// Skip empty borders
+		if (!args->border_in_active[i])
+			continue;
+		for (int c = 0; c < num_chunks[i]; c++)
+			Ctrl_WaitTile(comm, tiles->halo_chunks[i * max_chunks + c]);
+	}
+	iter_times.transfer += MPI_Wtime() - mpi_end;
+	unmarshall_halos(comm, tiles, threads, chars);
+
+	hit_clockStop(commClock);
+}
+
 /**
  * @brief Perform interprocess communications with device buffers.
  * @param comm Controller object
@@ -463,17 +810,29 @@ static inline void do_comms_host_inner_commall(PCtrl comm, EpsilodTiles *tiles,
  * @param chars Blocksizes for kernels
  */
 void do_comms_device(PCtrl comm, EpsilodTiles *tiles, EpsilodCommArgs *args, EpsilodThreads threads, EpsilodThreads chars) {
+	double start = MPI_Wtime();
 	hit_patternDo((tiles->neighSync));
+	iter_times.wait += MPI_Wtime() - start;
 
 	if (comms_contiguous_buffers()) {
 		unmarshall_halos(comm, tiles, threads, chars);
 	}
 }
 
+/**
+ * @brief Whether halo messages need explicit MPI requests, outside Hitmap patterns.
+ * Encoded halos, halo chunks and skipped unchanged halos are only supported by host_early.
+ * @return true if halo messages need explicit requests, false otherwise.
+ */
+static bool halo_explicit_requests() {
+	return epsilod_get_halo_codec() != NULL || epsilod_halo_chunk_kb() > 0 || epsilod_skip_unchanged_halos();
+}
+
 /**
  * @brief Sets the communication method to be used
  */
 void setup_comm_method() {
+	do_comms_prepare = do_comms_prepare_none;
 	if (mpi_dev_aware())
 		do_comms = do_comms_device;
 	else {
@@ -488,12 +847,44 @@ void setup_comm_method() {
 			case HOST_WAITALL:
 				do_comms_inner = do_comms_host_inner_commall;
 				break;
+			case HOST_EARLY_RECV:
+				do_comms_inner = do_comms_host_inner_commany;
+				break;
+		}
+
+		// Receives posted before computation also need explicit MPI requests
+		bool explicit_requests = epsilod_comm_method() == HOST_EARLY_RECV || halo_explicit_requests();
+		if (epsilod_get_halo_codec() != NULL && epsilod_halo_chunk_kb() > 0)
+			print_once("Warning: EPSILOD_HALO_CHUNK_KB is ignored with halo codecs. Encoded halos are sent whole.\n");
+		if (explicit_requests && !comms_contiguous_buffers()) {
+			print_once("Warning: EPSILOD_COMM_METHOD=host_early requires contiguous buffers. Using host_waitany.\n");
+		} else if (explicit_requests) {
+			do_comms         = do_comms_host_early;
+			do_comms_prepare = do_comms_host_post_recvs;
 		}
 	}
 }
 
+/**
+ * @brief Waits for the packing of the outbound borders in their contiguous buffers.
+ * @param comm Controller object
+ * @param tiles Tiles whose borders are packed
+ */
+static void sync_packed_borders(PCtrl comm, EpsilodTiles tiles) {
+	if (!comms_contiguous_buffers())
+		return;
+	for (int i = 0; i < epsilod_num_borders(hit_tileDims(tiles.mat)); i++) {
+		if (hit_tileIsNull(tiles.cont_border_out[i]))
+			continue;
+		Ctrl_WaitTile(comm, tiles.cont_border_out[i]);
+		iter_times.pack += Ctrl_TimeLastOp(comm, tiles.cont_border_out[i]);
+	}
+}
+
 /**
  * @brief Launch stencil computation kernels
+ * The outbound borders are computed first and packed while the inner region is computed, unless the inner
+ * compute tile is extended over the borders (EPSILOD_MEM_ALIGN_THREADS). Then packing is completed first.
  * @param comm Controller object
  * @param f_updateCell Stencil kernel wrapper function
  * @param tiles Tiles to update (write)
@@ -522,35 +913,46 @@ void compute(PCtrl comm, stencilDeviceFunction f_updateCell,
 			}
 		}
 	}
+	epsilod_progress_poll();
 
 	// Sync borders before inner
 	for (int i = 0; i < dims; i++) {
 		for (int j = 0; j < 2; j++) {
 			if (validShape(tiles.border_out_dev[i][j].shape) && validShape(tiles_copy.border_out_dev[i][j].shape)) {
 				Ctrl_WaitTile(comm, tiles.border_out_dev[i][j]);
+				iter_times.compute += Ctrl_TimeLastOp(comm, tiles.border_out_dev[i][j]);
 			}
 		}
 	}
 
+	// Pack borders. Queue 0 is left to the inner computation when there are more queues
+	int num_borders = epsilod_num_borders(dims);
 	if (comms_contiguous_buffers()) {
-		int num_borders = epsilod_num_borders(dims);
 		for (int i = 0; i < num_borders; i++) {
 			if (hit_tileIsNull(tiles.cont_border_out[i]))
 				continue;
-			int stream = i % get_ctrl_info()->n_kernel_queues;
-			transfer_tile(comm, tiles.border_out[i], tiles.cont_border_out[i], threads.cont_border_out[i], chars.cont_border_out[i], stream);
-		}
-		for (int i = 0; i < num_borders; i++) {
-			if (hit_tileIsNull(tiles.cont_border_out[i]))
-				continue;
-			Ctrl_WaitTile(comm, tiles.cont_border_out[i]);
+			int stream = (i + 1) % get_ctrl_info()->n_kernel_queues;
+			const EpsilodComponentMask *mask = tiles.cont_mask_out == NULL ? NULL : &tiles.cont_mask_out[i];
+			transfer_tile(comm, tiles.border_out[i], tiles.cont_border_out[i], threads.cont_border_out[i], chars.cont_border_out[i], stream, mask);
 		}
+		epsilod_progress_poll();
 	}
 
-	// Compute inner
-	if (validShape(tiles.inner.shape) && validShape(tiles_copy.inner.shape)) {
+	// Inner compute tiles extended over the outbound borders rewrite them: packing must be completed first
+	bool inner_overlaps = epsilod_align() == EPSILOD_MEM_ALIGN_THREADS && dims > 1;
+	if (inner_overlaps)
+		sync_packed_borders(comm, tiles);
+
+	// Compute inner. Otherwise it does not touch the outbound borders, so it runs concurrently with packing
+	// Inner regions without active cells are skipped
+	if (tiles.inner_active && validShape(tiles.inner.shape) && validShape(tiles_copy.inner.shape)) {
 		f_updateCell(comm, threads.inner, chars.inner, 0, tiles.inner_compute, tiles_copy.inner_compute, coords.inner, stencil, factor, ext_params);
 	}
+	epsilod_progress_poll();
+
+	// Sync packed borders before communications
+	if (!inner_overlaps)
+		sync_packed_borders(comm, tiles);
 }
 
 /**
@@ -608,6 +1010,11 @@ HitTopology get_topology(PartitionInfo info) {
 	switch (info.type) {
 		case EPSILOD_PARTITION_MULTI_DIM:
 		case EPSILOD_PARTITION_NOT_DIM:
+			topo = hit_topology(plug_topArray, info.dims);
+			if (epsilod_node_mapping())
+				epsilod_map_topology(&topo);
+			break;
+		case EPSILOD_PARTITION_WEIGHTED_GRID:
 			topo = hit_topology(plug_topArray, info.dims);
 			break;
 		default:
@@ -622,9 +1029,10 @@ HitTopology get_topology(PartitionInfo info) {
  * @brief Create data partition layout
  * @param shp_global Shape of the global partition matrix
  * @param borders Stencil border sizes
+ * @param stencil The stencil tile. Used to select the partition with EPSILOD_PARTITION=auto
  * @return The layout
  */
-HitLayout get_layout(HitShape shp_global, EpsilodBorders borders) {
+HitLayout get_layout(HitShape shp_global, EpsilodBorders borders, HitTile_float stencil) {
 	// Shape to distribute computation (without borders)
 	HitShape shp_inner = shp_global;
 	for (int i = 0; i < hit_shapeDims(shp_inner); i++) {
@@ -634,6 +1042,14 @@ HitLayout get_layout(HitShape shp_global, EpsilodBorders borders) {
 
 	// Select and build partition/distribution
 	PartitionInfo info = get_partition_info(hit_shapeDims(shp_global));
+	if (info.type == EPSILOD_PARTITION_AUTO) {
+		info = select_auto_partition(shp_inner, borders, stencil);
+		epsilod_set_auto_partition(info);
+		if (info.type == EPSILOD_PARTITION_MULTI_DIM)
+			print_once("Epsilod auto partition: m%d\n", info.dims);
+		else
+			print_once("Epsilod auto partition: %c%d\n", (info.type == EPSILOD_PARTITION_SINGLE_DIM) ? 's' : 'n', info.dim);
+	}
 
 	HitTopology topo = get_topology(info);
 	HitLayout   lay;
@@ -643,12 +1059,26 @@ HitLayout get_layout(HitShape shp_global, EpsilodBorders borders) {
 			break;
 		case EPSILOD_PARTITION_WEIGHTED:
 			// Weighted distribution
-			lay = hit_layout_freeTopo(plug_layDimWeighted_Blocks, topo, shp_inner, info.dim, Ctrl_GetWeights());
+			lay = hit_layout_freeTopo(plug_layDimWeighted_Blocks, topo, shp_inner, info.dim, epsilod_weights());
+			break;
+		case EPSILOD_PARTITION_WEIGHTED_GRID:
+			// Weighted distribution on every dimension of the topology
+			lay = epsilod_grid_layout(topo, shp_inner, epsilod_weights(), epsilod_grid());
 			break;
 		case EPSILOD_PARTITION_SINGLE_DIM:
 			// Regular distribution on a dimension
 			lay = hit_layout_freeTopo(plug_layDimBlocks, topo, shp_inner, info.dim);
 			break;
+		case EPSILOD_PARTITION_NOT_DIM: {
+			// Regular distribution on the topology dimensions. The skipped dimension is moved after them
+			int order[EPSILOD_MAX_DIMS];
+			partition_dims_order(hit_shapeDims(shp_global), order);
+			lay = hit_layout_freeTopo(plug_layBlocks, topo, shape_reorder(shp_inner, order, false));
+			// Local shapes in the domain order
+			lay.shape     = shape_reorder(lay.shape, order, true);
+			lay.origShape = shape_reorder(lay.origShape, order, true);
+			break;
+		}
 		default:
 			fprintf(stderr, "Error: EPSILOD partition type not yet implemented\n");
 			MPI_Abort(MPI_COMM_WORLD, MPI_ERR_TOPOLOGY);
@@ -661,6 +1091,359 @@ HitLayout get_layout(HitShape shp_global, EpsilodBorders borders) {
 	return lay;
 }
 
+/** Maximum number of communication settings compared by the runtime selection */
+#define EPSILOD_MAX_COMM_CANDIDATES 48
+
+/**
+ * @brief Whether the MPI library reports support for device buffers at runtime.
+ * @return true if CUDA-aware or ROCm-aware support is reported, false otherwise or if it cannot be queried.
+ */
+static bool mpi_dev_supported() {
+	#if defined(MPIX_CUDA_AWARE_SUPPORT) && MPIX_CUDA_AWARE_SUPPORT
+	if (MPIX_Query_cuda_support())
+		return true;
+	#endif // MPIX_CUDA_AWARE_SUPPORT
+	#if defined(MPIX_ROCM_AWARE_SUPPORT) && MPIX_ROCM_AWARE_SUPPORT
+	if (MPIX_Query_rocm_support())
+		return true;
+	#endif // MPIX_ROCM_AWARE_SUPPORT
+	return false;
+}
+
+/**
+ * @brief Enumerates the valid communication settings for the runtime selection.
+ * Settings not set to \e auto keep their value. Combinations that would be changed by setup_comm_method() are skipped.
+ * Device-aware MPI is only tried if the MPI library reports its support in every active process.
+ * @param active_comm Communicator of the active processes
+ * @param[out] candidates Array of at least EPSILOD_MAX_COMM_CANDIDATES settings.
+ * @return Number of candidates.
+ */
+static int comm_candidates(MPI_Comm active_comm, EpsilodCommConfig *candidates) {
+	int               fields = epsilod_comm_auto();
+	EpsilodCommConfig base   = epsilod_comm_config();
+
+	EpsilodCommMethod   methods[]    = {HOST_WAITANY, HOST_WAITANY_RECVFIRST, HOST_WAITALL, HOST_EARLY_RECV};
+	bool                contiguous[] = {true, false};
+	EpsilodMemAlignMode aligns[]     = {EPSILOD_MEM_ALIGN_NONE, EPSILOD_MEM_ALIGN, EPSILOD_MEM_ALIGN_THREADS};
+	bool                dev_aware[]  = {false, true};
+	int                 n_methods    = (fields & EPSILOD_AUTO_COMM_METHOD) ? 4 : 1;
+	int                 n_contiguous = (fields & EPSILOD_AUTO_CONTIGUOUS) ? 2 : 1;
+	int                 n_aligns     = (fields & EPSILOD_AUTO_ALIGN) ? 3 : 1;
+	int                 n_dev_aware  = (fields & EPSILOD_AUTO_DEV_AWARE) ? 2 : 1;
+	if (n_dev_aware == 2) {
+		int supported = mpi_dev_supported();
+		int ok        = MPI_Allreduce(MPI_IN_PLACE, &supported, 1, MPI_INT, MPI_LAND, active_comm);
+		hit_mpiTestError(ok, "Failed reducing the device-aware MPI support");
+		if (!supported) {
+			print_once("Warning: Device-aware MPI support is not reported by the MPI library. EPSILOD_MPI_DEV_AWARE=auto only tries n.\n");
+			n_dev_aware    = 1;
+			base.dev_aware = false;
+		}
+	}
+	if (n_methods == 1) methods[0] = base.method;
+	if (n_contiguous == 1) contiguous[0] = base.contiguous;
+	if (n_aligns == 1) aligns[0] = base.align;
+	if (n_dev_aware == 1) dev_aware[0] = base.dev_aware;
+
+	// Encoded, chunked and skipped halos are always sent with host_early
+	bool explicit_requests = halo_explicit_requests();
+
+	int n = 0;
+	for (int d = 0; d < n_dev_aware; d++) {
+		for (int c = 0; c < n_contiguous; c++) {
+			if (explicit_requests && (dev_aware[d] || !contiguous[c]))
+				continue;
+			for (int a = 0; a < n_aligns; a++) {
+				// The method is only used by host staging without explicit requests
+				int used_methods = (dev_aware[d] || explicit_requests) ? 1 : n_methods;
+				for (int m = 0; m < used_methods; m++) {
+					if (methods[m] == HOST_EARLY_RECV && !contiguous[c])
+						continue;
+					candidates[n++] = (EpsilodCommConfig){.method = methods[m], .contiguous = contiguous[c], .align = aligns[a], .dev_aware = dev_aware[d]};
+				}
+			}
+		}
+	}
+	return n;
+}
+
+/**
+ * @brief Prints a set of communication settings.
+ * @param prefix Text printed before the settings.
+ * @param config Communication settings.
+ * @param time Time per iteration with these settings.
+ */
+static void print_comm_config(const char *prefix, EpsilodCommConfig config, double time) {
+	const char *methods[] = {"host_waitany", "host_waitany_recvfirst", "host_waitall", "host_early"};
+	const char *aligns[]  = {"no", "yes", "threads"};
+	print_once("%sEPSILOD_COMM_METHOD=%s EPSILOD_COMMS_CONTIGUOUS_BUFFERS=%c EPSILOD_ALIGN=%s EPSILOD_MPI_DEV_AWARE=%c: %lf s/iter\n",
+			   prefix, config.dev_aware ? "-" : methods[config.method], config.contiguous ? 'y' : 'n', aligns[config.align], config.dev_aware ? 'y' : 'n', time);
+}
+
+/**
+ * @brief Selects the communication settings set to \e auto.
+ * Each valid combination is timed with a few iterations on its own tiles. The slowest active process
+ * determines the time of a combination, so every process selects the same one.
+ * The selected settings are left in place with epsilod_set_comm_config() and setup_comm_method().
+ * @param comm Controller object
+ * @param active_comm Communicator of the active processes of \p lay
+ * @param lay Layout of the domain
+ * @param global_mat Global tile
+ * @param borders Border sizes
+ * @param comm_args Arguments for communications
+ * @param HIT_CELL MPI type of domain cells
+ * @param f_updateCell Stencil kernel wrapper function
+ * @param stencil Stencil tile
+ * @param factor Divisor factor
+ * @param ext_params Extra parameters. Defined by the user
+ */
+static void select_comm_config(PCtrl comm, MPI_Comm active_comm, HitLayout lay, HitTile(EPSILOD_BASE_TYPE) * global_mat, EpsilodBorders borders,
+							   EpsilodCommArgs comm_args, HitType HIT_CELL, stencilDeviceFunction f_updateCell,
+							   HitTile_float stencil, float factor, Epsilod_ext *ext_params) {
+	const int         AUTO_ITERS   = 4;
+	int               dims         = hit_tileDims(*global_mat);
+	int               num_borders  = epsilod_num_borders(dims);
+	EpsilodCommConfig candidates[EPSILOD_MAX_COMM_CANDIDATES];
+	int               n_candidates = comm_candidates(active_comm, candidates);
+	double            times[EPSILOD_MAX_COMM_CANDIDATES];
+	double            max_times[EPSILOD_MAX_COMM_CANDIDATES];
+
+	print_once("Selecting communication settings (%d candidates)...\n", n_candidates);
+	for (int k = 0; k < n_candidates; k++) {
+		epsilod_set_comm_config(candidates[k]);
+		setup_comm_method();
+
+		EpsilodTiles *p_tiles      = create_tiles(comm, lay, global_mat, borders, comm_args);
+		EpsilodTiles *p_tiles_copy = create_tiles(comm, lay, global_mat, borders, comm_args);
+		CommCompIndex sorted_comm_indexes[num_borders];
+		sort_comm_indexes(*p_tiles, sorted_comm_indexes);
+		p_tiles->neighSync      = create_comm_pattern(comm, p_tiles, comm_args, sorted_comm_indexes, lay, HIT_CELL);
+		p_tiles_copy->neighSync = create_comm_pattern(comm, p_tiles_copy, comm_args, sorted_comm_indexes, lay, HIT_CELL);
+
+		EpsilodThreads      chars   = get_chars(dims, comm->type, *p_tiles);
+		EpsilodThreads      threads = get_threads(*p_tiles);
+		EpsilodGlobalCoords coords  = get_global_coords(*p_tiles, borders);
+
+		markTiles(comm, threads.touch, chars.touch, p_tiles, p_tiles_copy, &comm_args);
+		// The first iteration is not timed. It includes lazy initializations
+		double start = 0;
+		for (int iter = 0; iter <= AUTO_ITERS; iter++) {
+			if (iter == 1) {
+				Ctrl_Synchronize();
+				start = MPI_Wtime();
+			}
+			swap(p_tiles, p_tiles_copy, EpsilodTiles *);
+			do_comms_prepare(comm, p_tiles, &comm_args);
+			compute(comm, f_updateCell, *p_tiles, *p_tiles_copy, threads, chars, coords, stencil, factor, ext_params);
+			do_comms(comm, p_tiles, &comm_args, threads, chars);
+			Ctrl_WaitTile(comm, p_tiles->inner_compute);
+		}
+		Ctrl_Synchronize();
+		times[k] = (MPI_Wtime() - start) / AUTO_ITERS;
+
+		// Tiles depend on the settings. They are freed before changing them
+		free_threads(&threads);
+		free_threads(&chars);
+		free_epsilod_tiles(p_tiles);
+		free_epsilod_tiles(p_tiles_copy);
+	}
+
+	int ok = MPI_Allreduce(times, max_times, n_candidates, MPI_DOUBLE, MPI_MAX, active_comm);
+	hit_mpiTestError(ok, "Failed reducing the communication settings times");
+
+	int best = 0;
+	for (int k = 0; k < n_candidates; k++) {
+		if (!epsilod_exp_mode())
+			print_comm_config("\t", candidates[k], max_times[k]);
+		if (max_times[k] < max_times[best])
+			best = k;
+	}
+	epsilod_set_comm_config(candidates[best]);
+	setup_comm_method();
+	print_comm_config("Epsilod communication settings selected: ", candidates[best], max_times[best]);
+}
+
+/**
+ * @brief Calibrates the weights of weighted partitions and rebuilds the layout with them.
+ * The active processes time a few iterations on the tiles of the initial layout, and the weights are set
+ * proportional to the throughput of each process. @see epsilod_weights_from_times()
+ * Nothing is done if calibration is not selected, the weights are already learned or the partition is not
+ * weighted. Collective on all the processes: the inactive ones take part with no time.
+ * @param comm Controller object
+ * @param p_lay Layout of the domain. Replaced by the calibrated one
+ * @param global_mat Global tile
+ * @param borders Border sizes
+ * @param HIT_CELL MPI type of domain cells
+ * @param f_updateCell Stencil kernel wrapper function
+ * @param stencil Stencil tile
+ * @param factor Divisor factor
+ * @param ext_params Extra parameters. Defined by the user
+ */
+static void calibrate_layout(PCtrl comm, HitLayout *p_lay, HitTile(EPSILOD_BASE_TYPE) * global_mat, EpsilodBorders borders,
+							 HitType HIT_CELL, stencilDeviceFunction f_updateCell, HitTile_float stencil, float factor, Epsilod_ext *ext_params) {
+	int           dims      = hit_tileDims(*global_mat);
+	PartitionInfo part_info = get_partition_info(dims);
+	if (!epsilod_calibrate() || epsilod_weights_learned() || (part_info.type != EPSILOD_PARTITION_WEIGHTED && part_info.type != EPSILOD_PARTITION_WEIGHTED_GRID))
+		return;
+
+	double local_size = 0.0;
+	double calib_time = 0.0;
+	print_once("Calibration...\n");
+	if (hit_layImActive(*p_lay)) {
+		int      num_borders = epsilod_num_borders(dims);
+		bool     border_in_active[num_borders];
+		bool     border_out_active[num_borders];
+		int      index_comm_border[num_borders];
+		HitRanks shifts_in[num_borders];
+		HitRanks shifts_out[num_borders];
+		int      ranks_in[num_borders];
+		int      ranks_out[num_borders];
+
+		EpsilodCommArgs comm_args;
+		comm_args.border_in_active  = border_in_active;
+		comm_args.border_out_active = border_out_active;
+		comm_args.index_comm_border = index_comm_border;
+		comm_args.shifts_in         = shifts_in;
+		comm_args.shifts_out        = shifts_out;
+		comm_args.ranks_in          = ranks_in;
+		comm_args.ranks_out         = ranks_out;
+		comm_args.cell_type         = HIT_CELL;
+		init_comm_args(&comm_args, stencil, *p_lay);
+		init_border_types(&comm_args, dims);
+
+		EpsilodTiles *p_tiles      = create_tiles(comm, *p_lay, global_mat, borders, comm_args);
+		EpsilodTiles *p_tiles_copy = create_tiles(comm, *p_lay, global_mat, borders, comm_args);
+		CommCompIndex sorted_comm_indexes[num_borders];
+		sort_comm_indexes(*p_tiles, sorted_comm_indexes);
+		p_tiles->neighSync      = create_comm_pattern(comm, p_tiles, comm_args, sorted_comm_indexes, *p_lay, HIT_CELL);
+		p_tiles_copy->neighSync = create_comm_pattern(comm, p_tiles_copy, comm_args, sorted_comm_indexes, *p_lay, HIT_CELL);
+
+		EpsilodThreads      chars   = get_chars(dims, comm->type, *p_tiles);
+		EpsilodThreads      threads = get_threads(*p_tiles);
+		EpsilodGlobalCoords coords  = get_global_coords(*p_tiles, borders);
+
+		markTiles(comm, threads.touch, chars.touch, p_tiles, p_tiles_copy, &comm_args);
+		// The first iteration is not timed. It includes lazy initializations
+		for (int iter = 0; iter < EPSILOD_CALIBRATION_ITERS; iter++) {
+			iter_times = (EpsilodIterTimes){0};
+			swap(p_tiles, p_tiles_copy, EpsilodTiles *);
+			do_comms_prepare(comm, p_tiles, &comm_args);
+			compute(comm, f_updateCell, *p_tiles, *p_tiles_copy, threads, chars, coords, stencil, factor, ext_params);
+			do_comms(comm, p_tiles, &comm_args, threads, chars);
+			Ctrl_WaitTile(comm, p_tiles->inner_compute);
+			iter_times.compute += Ctrl_TimeLastOp(comm, p_tiles->inner_compute);
+			if (iter > 0) calib_time += EPSILOD_ALB_load(iter_times);
+		}
+		calib_time /= EPSILOD_CALIBRATION_ITERS - 1;
+		local_size = (part_info.type == EPSILOD_PARTITION_WEIGHTED_GRID) ? hit_shapeCard(p_lay->shape) : hit_shapeSigCard(p_lay->shape, part_info.dim);
+
+		free_epsilod_tiles(p_tiles);
+		free_epsilod_tiles(p_tiles_copy);
+		free_border_types(&comm_args, dims);
+	}
+
+	// Rebuild the partition with weights proportional to the measured throughput
+	print_weight_info(epsilod_weights_from_times(local_size, calib_time));
+	hit_layFree(*p_lay);
+	epsilod_grid_free(epsilod_grid());
+	*p_lay = get_layout(global_mat->shape, borders, stencil);
+	print_lay_info(*p_lay);
+}
+
+/**
+ * @brief Copies a local tile to another one with the same shape and allocation, in the device.
+ * @param comm Pointer to the EPSILOD Controller.
+ * @param src Source tile.
+ * @param dst Destination tile.
+ * @param threads Threads of the kernels.
+ * @param chars Block sizes of the kernels.
+ */
+static void dev_copy_mat(PCtrl comm, HitTile(EPSILOD_BASE_TYPE) src, HitTile(EPSILOD_BASE_TYPE) dst, EpsilodThreads threads, EpsilodThreads chars) {
+	int dims = hit_tileDims(src);
+	// This is limited by Controllers kernel thread id type, not by Ctrl_Thread
+	// Cannot perform a 1D copy when the tile is memory aligned
+	if (src.acumCard <= INT_MAX && (epsilod_align() == EPSILOD_MEM_ALIGN_NONE || dims == 1)) {
+		Ctrl_Launch(comm, epsilod_dev_copy_1d, threads.flat, chars.flat, src, dst);
+	} else {
+		switch (dims) {
+			case 1: Ctrl_Launch(comm, epsilod_dev_copy_1d, threads.mat, chars.mat, src, dst); break;
+			case 2: Ctrl_Launch(comm, epsilod_dev_copy_2d, threads.mat, chars.mat, src, dst); break;
+			case 3: Ctrl_Launch(comm, epsilod_dev_copy_3d, threads.mat, chars.mat, src, dst); break;
+			case 4: Ctrl_Launch(comm, epsilod_dev_copy_4d, threads.mat, chars.mat, src, dst); break;
+			default:
+				fprintf(stderr, "\nError: Matrix copy: unexpected number of dimensions (%d, max. %d).\n\n", dims, EPSILOD_MAX_DIMS);
+				MPI_Abort(MPI_COMM_WORLD, MPI_ERR_OTHER);
+				exit(EXIT_FAILURE);
+				break;
+		}
+	}
+}
+
+/**
+ * @brief Hands the pending snapshot, if any, to the snapshot writer. @see epsilod_output_snapshot()
+ * Its transfer to the host was issued at least one iteration before, so the wait is usually over.
+ * @param comm Pointer to the EPSILOD Controller.
+ */
+static void snapshot_flush(PCtrl comm) {
+	if (snapshots.pending == 0)
+		return;
+	int pending = 1 - snapshots.next;
+	Ctrl_WaitTile(comm, snapshots.mat[pending]);
+	epsilod_output_snapshot(snapshots.io[pending], snapshots.pending);
+	snapshots.pending = 0;
+}
+
+/**
+ * @brief Takes a snapshot of the local tile if it is scheduled after an iteration.
+ * The tile is copied in the device to the free staging tile, and the copy is moved to the host asynchronously,
+ * overlapped with the next iterations. The staging tile is reallocated when ALB changes the local tile.
+ * The previous snapshot, if pending, is handed to the writer first. Then its write has completed when
+ * the staging tile of the snapshot before it is reused.
+ * @param comm Pointer to the EPSILOD Controller.
+ * @param p_tiles Tiles with the current values.
+ * @param threads Threads of the kernels.
+ * @param chars Block sizes of the kernels.
+ * @param iteration Number of iterations computed.
+ */
+static void snapshot_take(PCtrl comm, EpsilodTiles *p_tiles, EpsilodThreads threads, EpsilodThreads chars, int iteration) {
+	snapshot_flush(comm);
+	if (!epsilod_snapshot_scheduled(iteration))
+		return;
+
+	int next = snapshots.next;
+	if (hit_tileIsNull(snapshots.mat[next]) || !hit_shapeCmp(snapshots.mat[next].shape, p_tiles->mat.shape)) {
+		if (!hit_tileIsNull(snapshots.mat[next]))
+			Ctrl_Free(NULL, snapshots.mat[next], snapshots.io[next]);
+		HitTile(EPSILOD_BASE_TYPE) *global_mat = (HitTile(EPSILOD_BASE_TYPE) *)hit_tileRoot(&p_tiles->mat);
+		snapshots.mat[next]                    = Ctrl_Select(EPSILOD_BASE_TYPE, *global_mat, p_tiles->mat.shape, CTRL_SELECT_ARR_COORD);
+		if (epsilod_align() == EPSILOD_MEM_ALIGN_NONE)
+			Ctrl_Alloc(comm, snapshots.mat[next]);
+		else
+			Ctrl_Alloc(comm, snapshots.mat[next], CTRL_MEM_ALIGNED);
+		snapshots.io[next] = Ctrl_Select(EPSILOD_BASE_TYPE, snapshots.mat[next], p_tiles->io.shape, CTRL_SELECT_ARR_COORD);
+	}
+	dev_copy_mat(comm, p_tiles->mat, snapshots.mat[next], threads, chars);
+	Ctrl_MoveFrom(comm, snapshots.mat[next]);
+	snapshots.pending = iteration;
+	snapshots.next    = 1 - next;
+}
+
+/**
+ * @brief Writes the pending snapshot, waits for the writer and frees the staging tiles.
+ * @param comm Pointer to the EPSILOD Controller.
+ */
+static void snapshot_finalize(PCtrl comm) {
+	snapshot_flush(comm);
+	epsilod_output_wait();
+	for (int i = 0; i < 2; i++) {
+		if (!hit_tileIsNull(snapshots.mat[i]))
+			Ctrl_Free(NULL, snapshots.mat[i], snapshots.io[i]);
+		snapshots.mat[i] = EPSILOD_TILE_NULL;
+		snapshots.io[i]  = EPSILOD_TILE_NULL;
+	}
+	snapshots.next = 0;
+}
+
 /**
  * @brief Create the MPI type to be used for communications
  * @return Type to use for communications
@@ -755,11 +1538,26 @@ void stencilComputation(
 		}
 
 		/* 3.2. Build distributed shape */
-		HitLayout lay = get_layout(globalMat.shape, borders);
+		epsilod_weights_key(device_selection_file, dims, sizes, borders);
+		HitLayout lay = get_layout(globalMat.shape, borders, stencil);
 
-		print_weight_info(Ctrl_GetWeights());
+		print_weight_info(epsilod_weights());
 		print_lay_info(lay);
 
+		// External/extra parameters
+		Epsilod_ext *ext_params = (ext_params_arg == NULL) ? &(Epsilod_ext){0} : ext_params_arg;
+
+		/* 3.3. Calibrated weights, before the active processes are known */
+		calibrate_layout(comm, &lay, &globalMat, borders, HIT_CELL, f_updateCell, stencil, factor, ext_params);
+		epsilod_io_init(hit_layImActive(lay));
+
+		// The topology of the layout also has the inactive processes
+		MPI_Comm active_comm = MPI_COMM_NULL;
+		if (epsilod_comm_auto()) {
+			int ok = MPI_Comm_split(hit_Comm, hit_layImActive(lay) ? 0 : MPI_UNDEFINED, hit_Rank, &active_comm);
+			hit_mpiTestError(ok, "Failed splitting the communicator of the active processes");
+		}
+
 		/* 4. Active processes */
 		if (hit_layImActive(lay)) {
 
@@ -770,6 +1568,8 @@ void stencilComputation(
 			int      index_comm_border[num_borders];
 			HitRanks shifts_in[num_borders];
 			HitRanks shifts_out[num_borders];
+			int      ranks_in[num_borders];
+			int      ranks_out[num_borders];
 
 			/* Border status */
 			EpsilodCommArgs comm_args;
@@ -778,7 +1578,20 @@ void stencilComputation(
 			comm_args.index_comm_border = index_comm_border;
 			comm_args.shifts_in         = shifts_in;
 			comm_args.shifts_out        = shifts_out;
+			comm_args.ranks_in          = ranks_in;
+			comm_args.ranks_out         = ranks_out;
+			comm_args.cell_type         = HIT_CELL;
 			init_comm_args(&comm_args, stencil, lay);
+			init_border_types(&comm_args, dims);
+
+			// MPI progress engine
+			epsilod_progress_init();
+
+			// Communication settings selected at runtime
+			if (epsilod_comm_auto()) {
+				select_comm_config(comm, active_comm, lay, &globalMat, borders, comm_args, HIT_CELL, f_updateCell, stencil, factor, ext_params);
+				MPI_Comm_free(&active_comm);
+			}
 
 			EpsilodTiles *p_tiles      = create_tiles(comm, lay, &globalMat, borders, comm_args);
 			EpsilodTiles *p_tiles_copy = create_tiles(comm, lay, &globalMat, borders, comm_args);
@@ -795,9 +1608,6 @@ void stencilComputation(
 
 			EpsilodGlobalCoords coords = get_global_coords(*p_tiles, borders);
 
-			// External/extra parameters
-			Epsilod_ext *ext_params = (ext_params_arg == NULL) ? &(Epsilod_ext){0} : ext_params_arg;
-
 			// Logging
 			if (epsilod_log_tiles())
 				log_tiles(lay, p_tiles);
@@ -813,6 +1623,7 @@ void stencilComputation(
 				print_once("Warm-up...\n");
 				for (int iter = 0; iter < WARMUP_ITERS; iter++) {
 					swap(p_tiles, p_tiles_copy, EpsilodTiles *);
+					do_comms_prepare(comm, p_tiles, &comm_args);
 					compute(comm, f_updateCell, *p_tiles, *p_tiles_copy, threads, chars, coords, stencil, factor, ext_params);
 					do_comms(comm, p_tiles, &comm_args, threads, chars);
 					Ctrl_WaitTile(comm, p_tiles->inner_compute);
@@ -869,30 +1680,18 @@ void stencilComputation(
 				print_once("\tInitializing copy in the device...\n");
 				fflush(stdout);
 				Ctrl_Launch(comm, epsilod_dev_touch, threads.touch, chars.touch, p_tiles->mat);
-				// This is limited by Controllers kernel thread id type, not by Ctrl_Thread
-				// Cannot perform a 1D copy when the tile is memory aligned
-				if (p_tiles->mat.acumCard <= INT_MAX && (epsilod_align() == EPSILOD_MEM_ALIGN_NONE || dims == 1)) {
-					Ctrl_Launch(comm, epsilod_dev_copy_1d, threads.flat, chars.flat, p_tiles->mat, p_tiles_copy->mat);
-				} else {
-					switch (dims) {
-						case 1: Ctrl_Launch(comm, epsilod_dev_copy_1d, threads.mat, chars.mat, p_tiles->mat, p_tiles_copy->mat); break;
-						case 2: Ctrl_Launch(comm, epsilod_dev_copy_2d, threads.mat, chars.mat, p_tiles->mat, p_tiles_copy->mat); break;
-						case 3: Ctrl_Launch(comm, epsilod_dev_copy_3d, threads.mat, chars.mat, p_tiles->mat, p_tiles_copy->mat); break;
-						case 4: Ctrl_Launch(comm, epsilod_dev_copy_4d, threads.mat, chars.mat, p_tiles->mat, p_tiles_copy->mat); break;
-						default:
-							fprintf(stderr, "\nError: Matrix copy: unexpected number of dimensions (%d, max. %d).\n\n", dims, EPSILOD_MAX_DIMS);
-							MPI_Abort(MPI_COMM_WORLD, MPI_ERR_OTHER);
-							exit(EXIT_FAILURE);
-							break;
-					}
-				}
+				dev_copy_mat(comm, p_tiles->mat, p_tiles_copy->mat, threads, chars);
 				#endif // EPSILOD_INITIALIZE_COPY_IN_HOST
 				markTiles(comm, threads.touch, chars.touch, p_tiles, p_tiles_copy, &comm_args);
 			} else {
 				// NOTE: this exists like this for wavesim example. We should find a cleaner way to support it
 				markTiles(comm, threads.touch, chars.touch, p_tiles, p_tiles_copy, &comm_args);
 				swap(p_tiles, p_tiles_copy, EpsilodTiles *);
-				compute(comm, f_init_copy, *p_tiles, *p_tiles_copy, threads, chars, coords, stencil, factor, ext_params);
+				do_comms_prepare(comm, p_tiles, &comm_args);
+				// The copy is initialized in full: inner regions without active cells are not skipped
+				EpsilodTiles init_tiles = *p_tiles;
+				init_tiles.inner_active = true;
+				compute(comm, f_init_copy, init_tiles, *p_tiles_copy, threads, chars, coords, stencil, factor, ext_params);
 				do_comms(comm, p_tiles, &comm_args, threads, chars);
 				swap(p_tiles, p_tiles_copy, EpsilodTiles *);
 			}
@@ -913,14 +1712,18 @@ void stencilComputation(
 
 			for (int iter = 0; iter < numIterations - 1; iter++) {
 				hit_clockStart(iter_clock);
+				iter_times = (EpsilodIterTimes){0};
 
 				swap(p_tiles, p_tiles_copy, EpsilodTiles *);
+				do_comms_prepare(comm, p_tiles, &comm_args);
 				compute(comm, f_updateCell, *p_tiles, *p_tiles_copy, threads, chars, coords, stencil, factor, ext_params);
+				EPSILOD_ALB_prepare(comm, p_tiles, coords, comm_args, stencil, HIT_CELL);
 				do_comms(comm, p_tiles, &comm_args, threads, chars);
 
 				double k_time = Ctrl_TimeLastOp(comm, p_tiles->inner_compute);
+				iter_times.compute += k_time;
 				hit_clockStart(redistribute_clock);
-				bool is_ALB = EPSILOD_ALB(comm, &p_tiles, &p_tiles_copy, &coords, comm_args, &lay, &threads, stencil, HIT_CELL, k_time, (iter == (numIterations - 2)));
+				bool is_ALB = EPSILOD_ALB(comm, &p_tiles, &p_tiles_copy, &coords, comm_args, &lay, &threads, stencil, HIT_CELL, iter_times, numIterations - 1 - iter, (iter == (numIterations - 2)));
 				// TODO move this inside EPSILOD_ALB to avoid checking if ALB was performed outside (requires kernel access from ALB)
 				if (is_ALB) {
 					Ctrl_Launch(comm, epsilod_dev_copy_1d, threads.flat, chars.flat, p_tiles->mat, p_tiles_copy->mat);
@@ -929,6 +1732,7 @@ void stencilComputation(
 					markTiles(comm, threads.touch, chars.touch, p_tiles, p_tiles_copy, &comm_args);
 				}
 				hit_clockStop(redistribute_clock);
+				snapshot_take(comm, p_tiles, threads, chars, iter + 1);
 				hit_clockStop(iter_clock);
 				#ifdef _EPS_ALB_EXP_MODE_
 				expALB_print("&0& %d,%d,%lf,%lf,%lf,%d\n", hit_Rank, iter, iter_clock.seconds, redistribute_clock.seconds, k_time, is_ALB);
@@ -948,6 +1752,10 @@ void stencilComputation(
 				#endif //_EPS_ALB_EXP_MODE_
 			}
 
+			if (numIterations > 0)
+				snapshot_take(comm, p_tiles, threads, chars, numIterations);
+			snapshot_finalize(comm);
+
 			Ctrl_Synchronize();
 			hit_clockStop(loop_clock);
 
@@ -967,6 +1775,7 @@ void stencilComputation(
 
 			reduceClocks(lay);
 			print_clock_info();
+			epsilod_codec_report();
 
 			#ifdef _EPS_ALB_EXP_MODE_
 			expALB_dump();
@@ -976,9 +1785,9 @@ void stencilComputation(
 			if (epsilod_write_output() != EPSILOD_FILE_NONE)
 				f_output = epsilod_write_output_default;
 			if (f_output != NULL)
-				f_output(p_tiles->io, ext_params);
+				epsilod_output_start(f_output, p_tiles->io, ext_params);
 
-			print_once("Output finished\n");
+			print_once(epsilod_output_test() ? "Output finished\n" : "Output continues in the background\n");
 			fflush(stdout);
 
 			// Free tiles
@@ -986,6 +1795,8 @@ void stencilComputation(
 			fflush(stdout);
 			free_epsilod_tiles(p_tiles);
 			free_epsilod_tiles(p_tiles_copy);
+			free_border_types(&comm_args, dims);
+			epsilod_progress_finalize();
 		} else {
 			/* 5. Inactive processes: only collective clock operations */
 			fprintf(stderr, "[%d] Warning, process not active\n", hit_Rank);
@@ -996,6 +1807,7 @@ void stencilComputation(
 
 			reduceClocks(lay);
 			print_clock_info();
+			epsilod_codec_report();
 		}
 
 		/* 6. Free other resources */
@@ -1003,6 +1815,8 @@ void stencilComputation(
 		fflush(stdout);
 		Ctrl_Free(comm, stencil);
 		hit_layFree(lay);
+		epsilod_io_finalize();
+		epsilod_weights_save();
 
 		print_once("Stopping distributed Controllers...\n");
 		fflush(stdout);
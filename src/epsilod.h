@@ -11,6 +11,8 @@
 
 #include "epsilod_structs.h"
 #include "epsilod_io.h"
+#include "epsilod_components.h"
+#include "epsilod_mask.h"
 #include "epsilod_alb.h"
 #include "epsilod_alb_heuristics.h"
 
@@ -25,6 +27,19 @@ hitNewType(epsilod_error);
  */
 void epsilod_print_usage();
 
+/**
+ * @brief Transfer data from one tile to another using a compute kernel.
+ * Input and output tiles must have the same shape.
+ * @param comm Controller pointer
+ * @param tile_src Input tile
+ * @param tile_dst Output tile
+ * @param thread Kernel thread space
+ * @param block Kernel blocksize
+ * @param stream Kernel stream number
+ * @param mask Components to transfer, or NULL to transfer whole cells
+ */
+void transfer_tile(PCtrl comm, HitTile(EPSILOD_BASE_TYPE) tile_src, HitTile(EPSILOD_BASE_TYPE) tile_dst, Ctrl_Thread thread, Ctrl_Thread block, int stream, const EpsilodComponentMask *mask);
+
 /**
  * @brief Parform a stencil computation.
  *
@@ -6,9 +6,14 @@
  * The relevant license, warranty and copyright notice is available in the EPSILOD project repository.
  */
 
+#include <string.h>
+
+#include "epsilod.h"
 #include "epsilod_alb.h"
 #include "epsilod_env.h"
+#include "epsilod_grid.h"
 #include "epsilod_log.h"
+#include "epsilod_weights.h"
 
 HitShape expandShapeBorders(HitTile *globalMat, HitInd *borderLow, HitInd *borderHigh, HitShape shape) {
 	int dims = hit_shapeDims(shape);
@@ -38,8 +43,613 @@ HitShape expandShapeBordersAndHalos(HitTile *globalMat, HitInd *borderLow, HitIn
 	return shape;
 }
 
+/**
+ * @brief Intersection of two shapes.
+ * @param a A shape.
+ * @param b A shape with the same dimensions.
+ * @return The intersection, or HIT_SHAPE_NULL if it is empty.
+ */
+static HitShape shape_intersect(HitShape a, HitShape b) {
+	HitShape res = a;
+	for (int i = 0; i < hit_shapeDims(a); i++) {
+		HitInd begin = (hit_shapeSig(a, i).begin > hit_shapeSig(b, i).begin) ? hit_shapeSig(a, i).begin : hit_shapeSig(b, i).begin;
+		HitInd end   = (hit_shapeSig(a, i).end < hit_shapeSig(b, i).end) ? hit_shapeSig(a, i).end : hit_shapeSig(b, i).end;
+		if (begin > end)
+			return HIT_SHAPE_NULL;
+		hit_shapeSig(res, i) = hit_sig(begin, end, 1);
+	}
+	return res;
+}
+
+/**
+ * @brief Redistributes the domain between two weighted grid partitions.
+ * Grid blocks are not described by a Hitmap layout plug-in, so each process builds the intersections
+ * of its old block with the new tiles of the others, and of the old blocks of the others with its new tile.
+ * The old blocks include the global borders; the new tiles include the halos.
+ * @param comm Controller object
+ * @param globalMat Global tile
+ * @param borders Border sizes
+ * @param old_grid Grid of the current partition
+ * @param new_grid Grid of the new partition
+ * @param new_lay Layout of the new partition. Used to address the processes
+ * @param old_mat Local tile of the current partition, in the host
+ * @param new_mat Local tile of the new partition, in the host
+ * @param HIT_CELL Type for a stencil cell
+ */
+static void grid_redistribute(PCtrl comm, HitTile *globalMat, EpsilodBorders borders, EpsilodGrid old_grid, EpsilodGrid new_grid, HitLayout new_lay,
+							  HitTile(EPSILOD_BASE_TYPE) * old_mat, HitTile(EPSILOD_BASE_TYPE) * new_mat, HitType HIT_CELL) {
+	int      num_procs = epsilod_grid_num_procs(new_grid);
+	HitRanks self      = new_lay.topo.self;
+	HitShape shp_old   = expandShapeBorders(globalMat, borders.low, borders.high, epsilod_grid_shape(old_grid, self));
+	HitShape shp_new   = new_mat->shape;
+
+	HitTile(EPSILOD_BASE_TYPE) *sends = malloc(sizeof(HitTile(EPSILOD_BASE_TYPE)) * num_procs);
+	HitTile(EPSILOD_BASE_TYPE) *recvs = malloc(sizeof(HitTile(EPSILOD_BASE_TYPE)) * num_procs);
+	HitPattern pattern                = hit_pattern(HIT_PAT_UNORDERED);
+	for (int p = 0; p < num_procs; p++) {
+		HitRanks ranks       = epsilod_grid_ranks(new_grid, p);
+		HitShape shp_send    = shape_intersect(shp_old, expandShapeBordersAndHalos(globalMat, borders.low, borders.high, epsilod_grid_shape(new_grid, ranks)));
+		HitShape shp_recv    = shape_intersect(expandShapeBorders(globalMat, borders.low, borders.high, epsilod_grid_shape(old_grid, ranks)), shp_new);
+		bool     send_active = validShape(shp_send);
+		bool     recv_active = validShape(shp_recv);
+
+		sends[p] = send_active ? Ctrl_Select(EPSILOD_BASE_TYPE, *old_mat, shp_send, CTRL_SELECT_ARR_COORD) : EPSILOD_TILE_NULL;
+		recvs[p] = recv_active ? Ctrl_Select(EPSILOD_BASE_TYPE, *new_mat, shp_recv, CTRL_SELECT_ARR_COORD) : EPSILOD_TILE_NULL;
+		if (send_active || recv_active)
+			hit_patternAdd(&pattern, hit_comSendRecv(new_lay, send_active ? ranks : HIT_RANKS_NULL, &sends[p], recv_active ? ranks : HIT_RANKS_NULL, &recvs[p], HIT_CELL));
+	}
+	hit_patternDo(pattern);
+	hit_patternFree(&pattern);
+
+	for (int p = 0; p < num_procs; p++) {
+		if (!hit_tileIsNull(sends[p]))
+			Ctrl_Free(comm, sends[p]);
+		if (!hit_tileIsNull(recvs[p]))
+			Ctrl_Free(comm, recvs[p]);
+	}
+	free(sends);
+	free(recvs);
+}
+
+/**
+ * @brief Gathers the old and new local tiles of the processes of a communicator.
+ * @param comm Communicator of the processes
+ * @param old_lay Layout of the current partition
+ * @param new_lay Layout of the new partition
+ * @return Old and new shapes of each process, in this order. Null shapes for inactive processes. To be freed by the caller
+ */
+static HitShape *gather_shapes(MPI_Comm comm, HitLayout old_lay, HitLayout new_lay) {
+	int num_procs;
+	MPI_Comm_size(comm, &num_procs);
+
+	HitShape  own[2] = {hit_layImActive(old_lay) ? old_lay.shape : HIT_SHAPE_NULL, hit_layImActive(new_lay) ? new_lay.shape : HIT_SHAPE_NULL};
+	HitShape *shapes = malloc(sizeof(HitShape) * 2 * num_procs);
+	int       ok     = MPI_Allgather(own, (int)sizeof(own), MPI_BYTE, shapes, (int)sizeof(own), MPI_BYTE, comm);
+	hit_mpiTestError(ok, "Failed gathering the ALB partitions");
+	return shapes;
+}
+
+/**
+ * @brief Migrates only the cells that change owner between two partitions.
+ * Each process sends the part of its old tile that falls in the new tiles of the others, and receives the parts
+ * of their old tiles that fall in its new one. The old tiles include the global borders; the new tiles include the halos.
+ * The part of the old tile that is kept, halos included, is copied in the device. Only the exchanged regions are
+ * moved through the host, and only processes with overlapping tiles communicate.
+ * Only the processes in the range take part, so the tiles of the processes out of it must not change.
+ * @param comm Controller object
+ * @param lay_comm Layout with all the processes. Used to address them
+ * @param first Rank in \p lay_comm of the first process that takes part
+ * @param num_procs Number of processes that take part, with consecutive ranks
+ * @param shapes Old and new shapes of the processes that take part. @see gather_shapes()
+ * @param globalMat Global tile
+ * @param borders Border sizes
+ * @param old_mat Local tile of the current partition, in the device
+ * @param new_mat Local tile of the new partition. Filled in the device
+ * @param HIT_CELL Type for a stencil cell
+ */
+static void alb_migrate(PCtrl comm, HitLayout lay_comm, int first, int num_procs, HitShape *shapes, HitTile *globalMat, EpsilodBorders borders,
+						HitTile(EPSILOD_BASE_TYPE) * old_mat, HitTile(EPSILOD_BASE_TYPE) * new_mat, HitType HIT_CELL) {
+	int      me  = lay_comm.topo.self.rank[0] - first;
+	HitShape own = shapes[2 * me];
+
+	HitShape shp_old = validShape(own) ? expandShapeBorders(globalMat, borders.low, borders.high, own) : HIT_SHAPE_NULL;
+	HitShape shp_new = new_mat->shape;
+
+	// Cells kept by this process are copied in the device. Halos are current after the communications of the iteration
+	HitShape shp_keep = (validShape(shp_old) && !hit_tileIsNull(*new_mat)) ? shape_intersect(old_mat->shape, shp_new) : HIT_SHAPE_NULL;
+	if (validShape(shp_keep)) {
+		HitTile(EPSILOD_BASE_TYPE) keep_src = Ctrl_Select(EPSILOD_BASE_TYPE, *old_mat, shp_keep, CTRL_SELECT_ARR_COORD);
+		HitTile(EPSILOD_BASE_TYPE) keep_dst = Ctrl_Select(EPSILOD_BASE_TYPE, *new_mat, shp_keep, CTRL_SELECT_ARR_COORD);
+		transfer_tile(comm, keep_src, keep_dst, init_thread_from_tile(&keep_dst), get_char_from_shape(shp_keep), 0, NULL);
+		Ctrl_WaitTile(comm, keep_dst);
+		Ctrl_Free(comm, keep_src);
+		Ctrl_Free(comm, keep_dst);
+	}
+
+	// Cells that change owner go through the host
+	HitTile(EPSILOD_BASE_TYPE) *sends = malloc(sizeof(HitTile(EPSILOD_BASE_TYPE)) * num_procs);
+	HitTile(EPSILOD_BASE_TYPE) *recvs = malloc(sizeof(HitTile(EPSILOD_BASE_TYPE)) * num_procs);
+	HitPattern pattern                = hit_pattern(HIT_PAT_UNORDERED);
+	for (int p = 0; p < num_procs; p++) {
+		HitShape shp_send = HIT_SHAPE_NULL;
+		HitShape shp_recv = HIT_SHAPE_NULL;
+		if (p != me && validShape(shp_old) && validShape(shapes[2 * p + 1]))
+			shp_send = shape_intersect(shp_old, expandShapeBordersAndHalos(globalMat, borders.low, borders.high, shapes[2 * p + 1]));
+		if (p != me && validShape(shapes[2 * p]) && !hit_tileIsNull(*new_mat))
+			shp_recv = shape_intersect(expandShapeBorders(globalMat, borders.low, borders.high, shapes[2 * p]), shp_new);
+		bool send_active = validShape(shp_send);
+		bool recv_active = validShape(shp_recv);
+
+		sends[p] = send_active ? Ctrl_Select(EPSILOD_BASE_TYPE, *old_mat, shp_send, CTRL_SELECT_ARR_COORD) : EPSILOD_TILE_NULL;
+		recvs[p] = recv_active ? Ctrl_Select(EPSILOD_BASE_TYPE, *new_mat, shp_recv, CTRL_SELECT_ARR_COORD) : EPSILOD_TILE_NULL;
+		if (send_active)
+			Ctrl_MoveFrom(comm, sends[p]);
+		if (send_active || recv_active) {
+			HitRanks ranks = HIT_RANKS_NULL;
+			ranks.rank[0]  = first + p;
+			hit_patternAdd(&pattern, hit_comSendRecv(lay_comm, send_active ? ranks : HIT_RANKS_NULL, &sends[p], recv_active ? ranks : HIT_RANKS_NULL, &recvs[p], HIT_CELL));
+		}
+	}
+	for (int p = 0; p < num_procs; p++)
+		if (!hit_tileIsNull(sends[p]))
+			Ctrl_WaitTile(comm, sends[p]);
+
+	hit_patternDo(pattern);
+	hit_patternFree(&pattern);
+
+	for (int p = 0; p < num_procs; p++)
+		if (!hit_tileIsNull(recvs[p]))
+			Ctrl_MoveTo(comm, recvs[p]);
+	for (int p = 0; p < num_procs; p++) {
+		if (!hit_tileIsNull(sends[p]))
+			Ctrl_Free(comm, sends[p]);
+		if (!hit_tileIsNull(recvs[p])) {
+			Ctrl_WaitTile(comm, recvs[p]);
+			Ctrl_Free(comm, recvs[p]);
+		}
+	}
+	free(sends);
+	free(recvs);
+}
+
+/**
+ * Partition decided by an asynchronous redistribution and not applied yet
+ */
+static struct {
+	bool            pending;      /**< Whether there is a partition to apply */
+	HitLayout       lay;          /**< Layout of the new partition */
+	EpsilodGrid     grid;         /**< Grid of the new partition. Unused if it is not a grid partition */
+	EpsilodTiles   *p_tiles;      /**< Tiles of the new partition. NULL until they are prepared */
+	EpsilodTiles   *p_tiles_copy; /**< Auxiliary tiles of the new partition. NULL until they are prepared */
+	EpsilodCommArgs comm_args;    /**< Communication arguments of the new partition, in its own arrays until it is applied */
+} next;
+
+/**
+ * @brief Copies the arrays of the communication arguments that depend on the partition.
+ * The cell type and the per-border components and types do not depend on it, so they are shared.
+ * @param dst Destination arguments
+ * @param src Source arguments
+ * @param num_borders Number of borders
+ */
+static void copy_comm_args(EpsilodCommArgs dst, EpsilodCommArgs src, int num_borders) {
+	memcpy(dst.border_in_active, src.border_in_active, sizeof(bool) * num_borders);
+	memcpy(dst.border_out_active, src.border_out_active, sizeof(bool) * num_borders);
+	memcpy(dst.shifts_in, src.shifts_in, sizeof(HitRanks) * num_borders);
+	memcpy(dst.shifts_out, src.shifts_out, sizeof(HitRanks) * num_borders);
+	memcpy(dst.index_comm_border, src.index_comm_border, sizeof(int) * num_borders);
+	memcpy(dst.ranks_in, src.ranks_in, sizeof(int) * num_borders);
+	memcpy(dst.ranks_out, src.ranks_out, sizeof(int) * num_borders);
+}
+
+/**
+ * @brief Frees the arrays of the communication arguments of the prepared partition.
+ */
+static void free_next_comm_args() {
+	free(next.comm_args.border_in_active);
+	free(next.comm_args.border_out_active);
+	free(next.comm_args.shifts_in);
+	free(next.comm_args.shifts_out);
+	free(next.comm_args.index_comm_border);
+	free(next.comm_args.ranks_in);
+	free(next.comm_args.ranks_out);
+}
+
+/**
+ * @brief Prints the weights of a new partition.
+ * @param weights Weights of the processes
+ */
+static void print_weights(HitWeights weights) {
+	print_once("\nPartition weights = {");
+	for (int i = 0; i < weights.num_procs; i++)
+		print_once(" %f,", weights.ratios[i]);
+	print_once("\b }\n");
+	fflush(stdout);
+	#ifdef _EPS_ALB_EXP_MODE_
+	expALB_print("&1& %d,", hit_Rank);
+	expALB_print(" %f", weights.ratios[0]);
+	for (int i = 1; i < weights.num_procs; i++)
+		expALB_print(", %f", weights.ratios[i]);
+	expALB_print("\n");
+	#endif //_EPS_ALB_EXP_MODE_
+}
+
+void EPSILOD_ALB_prepare(PCtrl comm, EpsilodTiles *p_tiles, EpsilodGlobalCoords coords, EpsilodCommArgs comm_args, HitTile_float stencil, HitType HIT_CELL) {
+	if (!next.pending || next.p_tiles != NULL)
+		return;
+
+	HitTile(EPSILOD_BASE_TYPE) *globalMat = (HitTile(EPSILOD_BASE_TYPE) *)hit_tileRoot(&p_tiles->mat);
+	int num_borders                       = epsilod_num_borders(hit_layNumDims(next.lay));
+
+	// The arrays of the caller are still used by the communications of the current partition
+	next.comm_args                   = comm_args;
+	next.comm_args.border_in_active  = malloc(sizeof(bool) * num_borders);
+	next.comm_args.border_out_active = malloc(sizeof(bool) * num_borders);
+	next.comm_args.shifts_in         = malloc(sizeof(HitRanks) * num_borders);
+	next.comm_args.shifts_out        = malloc(sizeof(HitRanks) * num_borders);
+	next.comm_args.index_comm_border = calloc(num_borders, sizeof(int));
+	next.comm_args.ranks_in          = malloc(sizeof(int) * num_borders);
+	next.comm_args.ranks_out         = malloc(sizeof(int) * num_borders);
+
+	init_comm_args(&next.comm_args, stencil, next.lay);
+	next.p_tiles      = create_tiles(comm, next.lay, globalMat, coords.inner.borders, next.comm_args);
+	next.p_tiles_copy = create_tiles(comm, next.lay, globalMat, coords.inner.borders, next.comm_args);
+
+	CommCompIndex sorted_comm_indexes[num_borders];
+	sort_comm_indexes(*next.p_tiles, sorted_comm_indexes);
+	next.p_tiles->neighSync      = create_comm_pattern(comm, next.p_tiles, next.comm_args, sorted_comm_indexes, next.lay, HIT_CELL);
+	next.p_tiles_copy->neighSync = create_comm_pattern(comm, next.p_tiles_copy, next.comm_args, sorted_comm_indexes, next.lay, HIT_CELL);
+}
+
+/**
+ * @brief Switches to the partition prepared by EPSILOD_ALB_prepare(), migrating the cells that change owner.
+ * It must be called after the communications of the iteration, as it overwrites the communication arguments.
+ * @param comm Controller object
+ * @param lay_comm Layout with all the processes
+ * @param first Rank in \p lay_comm of the first process that takes part in the migration
+ * @param num_procs Number of processes that take part in the migration
+ * @param shapes Old and new shapes of the processes that take part. @see gather_shapes()
+ * @param pp_tiles Set of tiles. Replaced by the prepared ones
+ * @param pp_tiles_copy Auxiliary set of tiles. Replaced by the prepared ones
+ * @param p_coords Set of epsilod coordinates. Updated to the new tiles
+ * @param comm_args Communication arguments. Their arrays are updated to the new partition
+ * @param p_lay Distributed layout. Replaced by the new one
+ * @param p_threads Computation thread spaces for kernels. Updated to the new tiles
+ * @param HIT_CELL Type for a stencil cell
+ */
+static void alb_apply(PCtrl comm, HitLayout lay_comm, int first, int num_procs, HitShape *shapes, EpsilodTiles **pp_tiles, EpsilodTiles **pp_tiles_copy,
+					  EpsilodGlobalCoords *p_coords, EpsilodCommArgs comm_args, HitLayout *p_lay, EpsilodThreads *p_threads, HitType HIT_CELL) {
+	EpsilodTiles  *p_tiles   = *pp_tiles;
+	EpsilodBorders borders   = p_coords->inner.borders;
+	HitTile       *globalMat = (HitTile *)hit_tileRoot(&p_tiles->mat);
+
+	alb_migrate(comm, lay_comm, first, num_procs, shapes, globalMat, borders, &p_tiles->mat, &next.p_tiles->mat, HIT_CELL);
+	copy_comm_args(comm_args, next.comm_args, epsilod_num_borders(hit_layNumDims(next.lay)));
+	free_next_comm_args();
+	if (epsilod_grid()->dims > 0) {
+		epsilod_grid_free(epsilod_grid());
+		*epsilod_grid() = next.grid;
+	}
+	hit_layFree(*p_lay);
+	*p_lay = next.lay;
+
+	free_epsilod_tiles(p_tiles);
+	free_epsilod_tiles(*pp_tiles_copy);
+	*pp_tiles      = next.p_tiles;
+	*pp_tiles_copy = next.p_tiles_copy;
+	*p_threads     = get_threads(**pp_tiles);
+	*p_coords      = get_global_coords(**pp_tiles, borders);
+
+	next.pending      = false;
+	next.p_tiles      = NULL;
+	next.p_tiles_copy = NULL;
+}
+
+/**
+ * Intra-node level of the hierarchical ALB. @see epsilod_alb_node_period()
+ */
+static struct {
+	bool        enabled;   /**< Whether intra-node rounds are run */
+	int         period;    /**< Iterations between intra-node rounds */
+	int         dim;       /**< Partitioned dimension */
+	MPI_Comm    comm;      /**< Processes of the node */
+	int         first;     /**< Rank of the first process of the node in the ALB communications layout */
+	int         size;      /**< Number of processes of the node */
+	float      *rows;      /**< Rows of every process, as known in this node. Weights of the intra-node layouts */
+	double      sample[2]; /**< Time per row and rows of this process */
+	double     *samples;   /**< Time per row and rows of the processes of the node */
+	MPI_Request req;       /**< Request of the gather of the samples */
+	bool        gathering; /**< Whether the samples are being gathered */
+} node;
+
+/**
+ * @brief Updates the rows of some processes with the shapes of a new partition.
+ * @param first Rank of the first process
+ * @param num_procs Number of processes, with consecutive ranks
+ * @param shapes Old and new shapes of the processes. @see gather_shapes()
+ */
+static void node_rows_update(int first, int num_procs, HitShape *shapes) {
+	if (!node.enabled)
+		return;
+	for (int i = 0; i < num_procs; i++)
+		node.rows[first + i] = validShape(shapes[2 * i + 1]) ? (float)hit_shapeSigCard(shapes[2 * i + 1], node.dim) : 0.0f;
+}
+
+/**
+ * @brief Sets up the intra-node rounds, if they are enabled.
+ * Collective on the processes of \p lay_comm.
+ * @param lay_comm Layout with all the processes
+ * @param lay Layout of the current partition
+ * @param grid Whether the partition is a grid partition
+ */
+static void node_init(HitLayout lay_comm, HitLayout lay, bool grid) {
+	node.period = epsilod_alb_node_period();
+	if (node.period == 0)
+		return;
+	if (grid) {
+		print_once("Warning: Intra-node ALB rounds skipped, they require w partitions.\n");
+		return;
+	}
+
+	MPI_Comm comm      = lay_comm.pTopology[0]->comm;
+	int      rank      = lay_comm.topo.self.rank[0];
+	int      num_procs = lay_comm.topo.card[0];
+	int      last;
+	MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &node.comm);
+	MPI_Comm_size(node.comm, &node.size);
+	MPI_Allreduce(&rank, &node.first, 1, MPI_INT, MPI_MIN, node.comm);
+	MPI_Allreduce(&rank, &last, 1, MPI_INT, MPI_MAX, node.comm);
+
+	// The rows of a node are only kept together if its processes have consecutive ranks
+	int consecutive = (last - node.first + 1 == node.size);
+	MPI_Allreduce(MPI_IN_PLACE, &consecutive, 1, MPI_INT, MPI_LAND, comm);
+	if (!consecutive) {
+		print_once("Warning: Intra-node ALB rounds skipped, the processes of a node do not have consecutive ranks.\n");
+		MPI_Comm_free(&node.comm);
+		return;
+	}
+
+	node.enabled     = true;
+	node.dim         = get_partition_info(hit_layNumDims(lay)).dim;
+	node.rows        = malloc(sizeof(float) * num_procs);
+	node.samples     = malloc(sizeof(double) * 2 * node.size);
+	HitShape *shapes = gather_shapes(comm, lay, lay);
+	node_rows_update(0, num_procs, shapes);
+	free(shapes);
+}
+
+/**
+ * @brief Starts gathering the times of the processes of the node.
+ * @param lay Layout of the current partition
+ * @param average Average load of this process
+ */
+static void node_start(HitLayout lay, double average) {
+	double rows    = hit_layImActive(lay) ? hit_shapeSigCard(lay.shape, node.dim) : 0.0;
+	node.sample[0] = (rows > 0.0) ? average / rows : 0.0;
+	node.sample[1] = rows;
+	int ok         = MPI_Iallgather(node.sample, 2, MPI_DOUBLE, node.samples, 2, MPI_DOUBLE, node.comm, &node.req);
+	hit_mpiTestError(ok, "Failed iallgather send");
+	node.gathering = true;
+}
+
+/**
+ * @brief Checks that a new partition keeps the range of the node and its active processes.
+ * The processes of the other nodes then keep their tiles, halos and neighbours.
+ * @param shapes Old and new shapes of the processes of the node. @see gather_shapes()
+ * @return true if the range and the active processes are kept, false otherwise
+ */
+static bool node_range_kept(HitShape *shapes) {
+	HitInd begin[2] = {0, 0};
+	HitInd end[2]   = {-1, -1};
+	bool   any[2]   = {false, false};
+	for (int i = 0; i < node.size; i++) {
+		if (validShape(shapes[2 * i]) != validShape(shapes[2 * i + 1]))
+			return false;
+		for (int k = 0; k < 2; k++) {
+			if (!validShape(shapes[2 * i + k]))
+				continue;
+			HitSig sig = hit_shapeSig(shapes[2 * i + k], node.dim);
+			begin[k]   = (!any[k] || sig.begin < begin[k]) ? sig.begin : begin[k];
+			end[k]     = (!any[k] || sig.end > end[k]) ? sig.end : end[k];
+			any[k]     = true;
+		}
+	}
+	return begin[0] == begin[1] && end[0] == end[1];
+}
+
+/**
+ * @brief Moves rows between the processes of the node if they are imbalanced.
+ * The rows of the node are shared in proportion to the throughput of its processes. The processes of the node
+ * take the same decision, and the other nodes do not take part.
+ * @param comm Controller object
+ * @param lay_comm Layout with all the processes
+ * @param pp_tiles Set of tiles. Replaced if the rows are moved
+ * @param pp_tiles_copy Auxiliary set of tiles. Replaced if the rows are moved
+ * @param p_coords Set of epsilod coordinates. Updated if the rows are moved
+ * @param comm_args Communication arguments
+ * @param p_lay Distributed layout. Replaced if the rows are moved
+ * @param p_threads Computation thread spaces for kernels. Updated if the rows are moved
+ * @param stencil Weights for the stencil. Used to recalculate active borders
+ * @param HIT_CELL Type for a stencil cell
+ * @return Whether the rows were moved
+ */
+static bool node_move(PCtrl comm, HitLayout lay_comm, EpsilodTiles **pp_tiles, EpsilodTiles **pp_tiles_copy, EpsilodGlobalCoords *p_coords,
+					  EpsilodCommArgs comm_args, HitLayout *p_lay, EpsilodThreads *p_threads, HitTile_float stencil, HitType HIT_CELL) {
+	int ok = MPI_Wait(&node.req, MPI_STATUS_IGNORE);
+	hit_mpiTestError(ok, "Failed iallgather wait");
+	node.gathering = false;
+
+	// Imbalance of the node, relative to the average load of its active processes
+	double total_rows = 0.0;
+	double throughput = 0.0;
+	double sum_load   = 0.0;
+	double max_load   = 0.0;
+	int    active     = 0;
+	for (int i = 0; i < node.size; i++) {
+		double time_per_row = node.samples[2 * i];
+		double rows         = node.samples[2 * i + 1];
+		total_rows += rows;
+		if (time_per_row <= 0.0 || rows <= 0.0)
+			continue;
+		double load = time_per_row * rows;
+		throughput += 1.0 / time_per_row;
+		sum_load += load;
+		max_load = (load > max_load) ? load : max_load;
+		active++;
+	}
+	if (active < 2 || max_load <= (1.0 + epsilod_alb_margin()) * sum_load / active)
+		return false;
+
+	// The other nodes keep their rows as known in this node
+	int   num_procs = lay_comm.topo.card[0];
+	float weights[num_procs];
+	for (int p = 0; p < num_procs; p++)
+		weights[p] = node.rows[p];
+	for (int i = 0; i < node.size; i++) {
+		double time_per_row     = node.samples[2 * i];
+		bool   is_active        = time_per_row > 0.0 && node.samples[2 * i + 1] > 0.0;
+		weights[node.first + i] = is_active ? (float)(total_rows / (time_per_row * throughput)) : 0.0f;
+	}
+	HitLayout new_lay = hit_layout_freeTopo(plug_layDimWeighted_Blocks, hit_topology(plug_topPlain), p_lay->origShape, node.dim, hitWeights(num_procs, weights));
+
+	HitShape *shapes = gather_shapes(node.comm, *p_lay, new_lay);
+	if (!node_range_kept(shapes)) {
+		hit_layFree(new_lay);
+		free(shapes);
+		return false;
+	}
+
+	if (lay_comm.topo.self.rank[0] == node.first && !epsilod_exp_mode())
+		printf("[%d] ALB Node redistribution: processes %d to %d\n", hit_Rank, node.first, node.first + node.size - 1);
+	next.pending = true;
+	next.lay     = new_lay;
+	next.grid    = (EpsilodGrid){0};
+	EPSILOD_ALB_prepare(comm, *pp_tiles, *p_coords, comm_args, stencil, HIT_CELL);
+	alb_apply(comm, lay_comm, node.first, node.size, shapes, pp_tiles, pp_tiles_copy, p_coords, comm_args, p_lay, p_threads, HIT_CELL);
+	node_rows_update(node.first, node.size, shapes);
+	free(shapes);
+	return true;
+}
+
+/**
+ * @brief Finishes an intra-node round. @see node_move()
+ * Collective on the processes of \p lay_comm. If any node moved its rows, the neighbours in other nodes
+ * have new tiles: every process sends all its halos in the next exchange. The rows of every process are then
+ * shared, and the learned weights become these rows. @see epsilod_weights_update()
+ * @param comm Controller object
+ * @param lay_comm Layout with all the processes
+ * @param pp_tiles Set of tiles. Replaced if the rows of the node are moved
+ * @param pp_tiles_copy Auxiliary set of tiles. Replaced if the rows of the node are moved
+ * @param p_coords Set of epsilod coordinates. Updated if the rows of the node are moved
+ * @param comm_args Communication arguments
+ * @param p_lay Distributed layout. Replaced if the rows of the node are moved
+ * @param p_threads Computation thread spaces for kernels. Updated if the rows of the node are moved
+ * @param stencil Weights for the stencil. Used to recalculate active borders
+ * @param HIT_CELL Type for a stencil cell
+ * @return Whether the rows of the node were moved
+ */
+static bool node_balance(PCtrl comm, HitLayout lay_comm, EpsilodTiles **pp_tiles, EpsilodTiles **pp_tiles_copy, EpsilodGlobalCoords *p_coords,
+						 EpsilodCommArgs comm_args, HitLayout *p_lay, EpsilodThreads *p_threads, HitTile_float stencil, HitType HIT_CELL) {
+	bool moved     = node_move(comm, lay_comm, pp_tiles, pp_tiles_copy, p_coords, comm_args, p_lay, p_threads, stencil, HIT_CELL);
+	int  any_moved = moved;
+	int  ok        = MPI_Allreduce(MPI_IN_PLACE, &any_moved, 1, MPI_INT, MPI_LOR, lay_comm.pTopology[0]->comm);
+	hit_mpiTestError(ok, "Failed allreduce");
+	if (!any_moved)
+		return false;
+
+	// The halos of the neighbours with new tiles are no longer in their buffers
+	forget_halo_shadows(*pp_tiles);
+	forget_halo_shadows(*pp_tiles_copy);
+
+	// Each node only knows its own rows: share the rows of every process
+	float rows = hit_layImActive(*p_lay) ? (float)hit_shapeSigCard(p_lay->shape, node.dim) : 0.0f;
+	ok         = MPI_Allgather(&rows, 1, MPI_FLOAT, node.rows, 1, MPI_FLOAT, lay_comm.pTopology[0]->comm);
+	hit_mpiTestError(ok, "Failed allgather");
+
+	// The learned weights follow the partition, as in the global rounds
+	epsilod_weights_update(hitWeights(lay_comm.topo.card[0], node.rows));
+	return moved;
+}
+
+/**
+ * @brief Fits the load of this process as an affine function of its local size.
+ * The fixed term captures the costs that do not scale with the tile, like kernel launches, cache effects and
+ * borders of constant size. With a single sample size, or when the fit is not meaningful, the time is taken
+ * as proportional to the size.
+ * @param num Number of samples
+ * @param sizes Local sizes of the samples
+ * @param times Kernel times of the samples
+ * @param[out] params Fixed time and time per unit of size
+ */
+static void fit_throughput(int num, const double *sizes, const double *times, double *params) {
+	double sum_s = 0, sum_t = 0, sum_ss = 0, sum_st = 0;
+	for (int i = 0; i < num; i++) {
+		sum_s += sizes[i];
+		sum_t += times[i];
+		sum_ss += sizes[i] * sizes[i];
+		sum_st += sizes[i] * times[i];
+	}
+	double det = num * sum_ss - sum_s * sum_s;
+	params[0]  = 0.0;
+	params[1]  = (sum_s > 0) ? sum_t / sum_s : 0.0;
+	if (num < 2 || det <= 1e-9 * sum_ss * num)
+		return;
+
+	double slope     = (num * sum_st - sum_s * sum_t) / det;
+	double intercept = (sum_t - slope * sum_s) / num;
+	if (slope <= 0.0 || intercept < 0.0)
+		return;
+	params[0] = intercept;
+	params[1] = slope;
+}
+
+/**
+ * @brief Shares of the domain that equalise the times predicted by the throughput models.
+ * Solves sum_i (T - fixed_i) / slope_i = total for the common time T. Processes whose fixed time
+ * exceeds T get no share, and T is recomputed without them.
+ * @param num Number of processes
+ * @param params Fixed time and time per unit of size of each process. Processes without model have slope 0
+ * @param total Size of the domain
+ * @param[out] shares Predicted local size of each process
+ */
+static void model_shares(int num, const double *params, double total, float *shares) {
+	bool active[num];
+	for (int i = 0; i < num; i++) {
+		active[i] = params[2 * i + 1] > 0.0;
+		shares[i] = 0.0f;
+	}
+
+	bool changed = true;
+	while (changed) {
+		double sum_inv = 0, sum_fixed = 0;
+		for (int i = 0; i < num; i++) {
+			if (!active[i]) continue;
+			sum_inv += 1.0 / params[2 * i + 1];
+			sum_fixed += params[2 * i] / params[2 * i + 1];
+		}
+		if (sum_inv == 0.0) {
+			shares[0] = 1;
+			return;
+		}
+		double common = (total + sum_fixed) / sum_inv;
+
+		changed = false;
+		for (int i = 0; i < num; i++) {
+			shares[i] = active[i] ? (float)((common - params[2 * i]) / params[2 * i + 1]) : 0.0f;
+			if (active[i] && shares[i] <= 0.0f) {
+				active[i] = false;
+				changed   = true;
+			}
+		}
+	}
+}
+
+double EPSILOD_ALB_load(EpsilodIterTimes times) {
+	EpsilodIterTimes weights = epsilod_alb_load_weights();
+	return weights.compute * times.compute + weights.pack * times.pack + weights.transfer * times.transfer + weights.wait * times.wait;
+}
+
 bool EPSILOD_ALB(PCtrl comm, EpsilodTiles **pp_tiles, EpsilodTiles **pp_tiles_copy, EpsilodGlobalCoords *p_coords, EpsilodCommArgs comm_args,
-				 HitLayout *p_lay, EpsilodThreads *p_threads, HitTile_float stencil, HitType HIT_CELL, double time, bool is_last) {
+				 HitLayout *p_lay, EpsilodThreads *p_threads, HitTile_float stencil, HitType HIT_CELL, EpsilodIterTimes times, int remaining_iters, bool is_last) {
 
 	#ifdef DEBUG
 	static HitClock call_clock = {HIT_CLOCK_STOPPED, -1, 0, 0, 0, 0};
@@ -53,12 +663,21 @@ bool EPSILOD_ALB(PCtrl comm, EpsilodTiles **pp_tiles, EpsilodTiles **pp_tiles_co
 	static MPI_Request    req_all_times;
 	static MPI_Request    req_avg_times;
 	static MPI_Request    req_redis_times;
+	static HitTile_double model_params;
+	static MPI_Request    req_model_params;
+	static double         sample_sizes[EPSILOD_ALB_MODEL_SAMPLES];
+	static double         sample_times[EPSILOD_ALB_MODEL_SAMPLES];
+	static int            num_samples = 0;
 	static int            curr_alb_iter = 0;
 	static int            curr_iter     = 0;
 	static bool           comm_times    = false;
 	static Heuristic      heur;
 
-	bool isALB = false;
+	bool isALB       = false;
+	bool grid        = epsilod_grid()->dims > 0;
+	bool async       = epsilod_alb_async();
+	bool incremental = async || epsilod_alb_incremental() || node.enabled;
+	bool fit         = epsilod_alb_fit_model();
 
 	// First call to the function, initialization
 	if (curr_iter == 0) {
@@ -72,6 +691,8 @@ bool EPSILOD_ALB(PCtrl comm, EpsilodTiles **pp_tiles, EpsilodTiles **pp_tiles_co
 			hit_tileDomainAlloc(&row_times, double, 1, comm_procs);
 			hit_tileDomainAlloc(&avg_times, double, 1, comm_procs);
 			hit_tileDomainAlloc(&redis_times, double, 1, comm_procs);
+			hit_tileDomainAlloc(&model_params, double, 1, 2 * comm_procs);
+			node_init(lay_comm, *p_lay, grid);
 		}
 	} else {
 		#ifdef DEBUG
@@ -86,6 +707,7 @@ bool EPSILOD_ALB(PCtrl comm, EpsilodTiles **pp_tiles, EpsilodTiles **pp_tiles_co
 		return false;
 	}
 
+	double time = (heur.load != NULL) ? heur.load(heur.state, times) : EPSILOD_ALB_load(times);
 	// TODO @seralpa this should never happen because epsilod inactive procs don't enter this function
 	if (!hit_layImActive(*p_lay)) time = 0.0;
 
@@ -95,17 +717,37 @@ bool EPSILOD_ALB(PCtrl comm, EpsilodTiles **pp_tiles, EpsilodTiles **pp_tiles_co
 	hit_avgInsertData(&avg, time);
 	double average = hit_avgGetAvg(avg);
 
-	if ((average != HITAVG_NOT_FULL) && (heur.check(heur.state, curr_iter, curr_alb_iter))) {
+	if (next.p_tiles != NULL) {
+		// Asynchronous redistribution prepared during this iteration: only the migration is left
+		hit_clockStart(redis_clock);
+		int       comm_procs = lay_comm.topo.card[0];
+		HitShape *shapes     = gather_shapes(lay_comm.pTopology[0]->comm, *p_lay, next.lay);
+		print_once("ALB Redistribution\n");
+		alb_apply(comm, lay_comm, 0, comm_procs, shapes, pp_tiles, pp_tiles_copy, p_coords, comm_args, p_lay, p_threads, HIT_CELL);
+		node_rows_update(0, comm_procs, shapes);
+		free(shapes);
+		hit_avgResetData(&avg);
+		hit_clockStop(redis_clock);
+		isALB = true;
+	} else if (node.gathering) {
+		// Intra-node round: the averages are gathered again in every process, whatever its node decides
+		isALB = node_balance(comm, lay_comm, pp_tiles, pp_tiles_copy, p_coords, comm_args, p_lay, p_threads, stencil, HIT_CELL);
+		hit_avgResetData(&avg);
+	} else if (!next.pending && (average != HITAVG_NOT_FULL) && (heur.check(heur.state, curr_iter, curr_alb_iter))) {
 		if (!comm_times) { // First time that the data array is full and heur returns true comm the times across procs
 			double zero = 0;
 			hit_tileFill(&row_times, &zero);
 			hit_tileFill(&avg_times, &zero);
 			hit_tileFill(&redis_times, &zero);
-			double timePerRow;
+			// Grid partitions balance the time per cell, as blocks change in every partitioned dimension
+			double localSize;
 			if (!hit_layImActive(*p_lay))
-				timePerRow = 0.0;
+				localSize = 0.0;
+			else if (grid)
+				localSize = hit_shapeCard(p_lay->shape);
 			else
-				timePerRow = average / hit_tileDimCard((*pp_tiles)->mat, 0);
+				localSize = hit_tileDimCard((*pp_tiles)->mat, get_partition_info(hit_layNumDims(*p_lay)).dim);
+			double timePerRow = (localSize > 0.0) ? average / localSize : 0.0;
 
 			double redisTime = redis_clock.seconds;
 
@@ -117,143 +759,224 @@ bool EPSILOD_ALB(PCtrl comm, EpsilodTiles **pp_tiles, EpsilodTiles **pp_tiles_co
 			ok = MPI_Iallgather(&redisTime, 1, HIT_DOUBLE, redis_times.data, 1, HIT_DOUBLE, lay_comm.pTopology[0]->comm, &req_redis_times);
 			hit_mpiTestError(ok, "Failed iallgather send");
 
+			// Throughput model fitted to the samples of the previous partitions
+			if (fit) {
+				static double params[2];
+				if (localSize > 0.0) {
+					sample_sizes[num_samples % EPSILOD_ALB_MODEL_SAMPLES] = localSize;
+					sample_times[num_samples % EPSILOD_ALB_MODEL_SAMPLES] = average;
+					num_samples++;
+				}
+				int num = (num_samples < EPSILOD_ALB_MODEL_SAMPLES) ? num_samples : EPSILOD_ALB_MODEL_SAMPLES;
+				fit_throughput(num, sample_sizes, sample_times, params);
+				if (localSize == 0.0) params[1] = 0.0;
+				ok = MPI_Iallgather(params, 2, HIT_DOUBLE, model_params.data, 2, HIT_DOUBLE, lay_comm.pTopology[0]->comm, &req_model_params);
+				hit_mpiTestError(ok, "Failed iallgather send");
+			}
+
 			comm_times = true;
 		} else {
-			hit_clockStart(redis_clock);
 			int ok = MPI_Wait(&req_all_times, MPI_STATUS_IGNORE);
 			hit_mpiTestError(ok, "Failed iallgather wait");
 			ok = MPI_Wait(&req_avg_times, MPI_STATUS_IGNORE);
 			hit_mpiTestError(ok, "Failed iallgather wait");
 			ok = MPI_Wait(&req_redis_times, MPI_STATUS_IGNORE);
 			hit_mpiTestError(ok, "Failed iallgather wait");
-
-			curr_alb_iter++;
-			isALB = true;
-
-			heur.redis(heur.state, curr_iter, curr_alb_iter, row_times, avg_times, redis_times);
-
-			double sum = 0;
-			for (int k = 0; k < hit_tileCard(row_times); k++) {
-				sum += hit(row_times, k);
+			if (fit) {
+				ok = MPI_Wait(&req_model_params, MPI_STATUS_IGNORE);
+				hit_mpiTestError(ok, "Failed iallgather wait");
 			}
 
-			// Compute new weights
-			float normalizedWeights[hit_tileCard(row_times)];
-			for (int k = 0; k < hit_tileCard(row_times); k++) {
-				if (hit(row_times, k) == 0.0)
-					normalizedWeights[k] = 0.0;
-				else
-					normalizedWeights[k] = (float)(sum / hit(row_times, k));
-			}
-			if (sum == 0.0) normalizedWeights[0] = 1;
-			HitWeights weights = hitWeights(hit_tileCard(row_times), normalizedWeights);
-
-			#ifdef DEBUG
-			if (hit_layImLeader((lay_comm))) {
-				printf("Process[%d] weights: ", hit_Rank);
-				for (int i = 0; i < hit_tileCard(row_times); i++) {
-					printf("%.5f ", normalizedWeights[i]);
+			bool accepted = heur.accept == NULL || heur.accept(heur.state, curr_iter, curr_alb_iter, remaining_iters, row_times, avg_times, redis_times);
+			if (!accepted) {
+				// Not worth it: gather new times when the averages are full again
+				hit_avgResetData(&avg);
+				comm_times = false;
+			} else {
+				hit_clockStart(redis_clock);
+				curr_alb_iter++;
+				isALB = true;
+
+				heur.redis(heur.state, curr_iter, curr_alb_iter, row_times, avg_times, redis_times);
+
+				double sum = 0;
+				for (int k = 0; k < hit_tileCard(row_times); k++) {
+					sum += hit(row_times, k);
 				}
-				printf("\n");
-				fflush(stdout);
-			}
-			#endif
-
-			EpsilodTiles  *p_tiles = *pp_tiles;
-			EpsilodBorders borders = p_coords->inner.borders;
-
-			// Move matrix to host
-			Ctrl_MoveFrom(comm, p_tiles->mat);
-			Ctrl_WaitTile(comm, p_tiles->mat);
-
-			HitTile(EPSILOD_BASE_TYPE) *globalMat = (HitTile(EPSILOD_BASE_TYPE) *)hit_tileRoot(&p_tiles->mat);
-
-			// Free old tilecopy
-			free_epsilod_tiles(*pp_tiles_copy);
-
-			// Create new layout
-			HitLayout new_lay = hit_layout_freeTopo(plug_layDimWeighted_Blocks, hit_topology(plug_topPlain), p_lay->origShape, 0, weights);
 
-			if (!epsilod_exp_mode()) {
-				printf("[%d] new_lay->shape: ", hit_Rank);
-				dumpShape(new_lay.shape);
-				fflush(stdout);
+				// Compute new weights
+				float normalizedWeights[hit_tileCard(row_times)];
+				if (fit) {
+					// Predicted sizes that equalise the loads
+					double total = grid ? hit_shapeCard(p_lay->origShape) : hit_shapeSigCard(p_lay->origShape, get_partition_info(hit_layNumDims(*p_lay)).dim);
+					model_shares(hit_tileCard(row_times), (double *)model_params.data, total, normalizedWeights);
+				} else {
+					for (int k = 0; k < hit_tileCard(row_times); k++) {
+						if (hit(row_times, k) == 0.0)
+							normalizedWeights[k] = 0.0;
+						else
+							normalizedWeights[k] = (float)(sum / hit(row_times, k));
+					}
+					if (sum == 0.0) normalizedWeights[0] = 1;
+				}
+				HitWeights weights = hitWeights(hit_tileCard(row_times), normalizedWeights);
+
+				#ifdef DEBUG
+				if (hit_layImLeader((lay_comm))) {
+					printf("Process[%d] weights: ", hit_Rank);
+					for (int i = 0; i < hit_tileCard(row_times); i++) {
+						printf("%.5f ", normalizedWeights[i]);
+					}
+					printf("\n");
+					fflush(stdout);
+				}
+				#endif
 
-				printf("[%d] new_lay->orig: ", hit_Rank);
-				dumpShape(new_lay.origShape);
-				fflush(stdout);
+				// Create new layout
+				HitLayout   new_lay;
+				EpsilodGrid new_grid = {0};
+				if (grid)
+					new_lay = epsilod_grid_layout(hit_topology(plug_topArray, epsilod_grid()->dims), p_lay->origShape, weights, &new_grid);
+				else
+					new_lay = hit_layout_freeTopo(plug_layDimWeighted_Blocks, hit_topology(plug_topPlain), p_lay->origShape, get_partition_info(hit_layNumDims(*p_lay)).dim, weights);
+
+				if (async) {
+					// The new tiles are prepared while the kernels of the next iteration run
+					print_once("ALB Redistribution scheduled\n");
+					print_weights(weights);
+					epsilod_weights_update(weights);
+					next.pending = true;
+					next.lay     = new_lay;
+					next.grid    = new_grid;
+					comm_times   = false;
+					isALB        = false;
+				} else {
+					EpsilodTiles  *p_tiles = *pp_tiles;
+					EpsilodBorders borders = p_coords->inner.borders;
+
+					// Move matrix to host. Incremental migrations only move the regions that change owner
+					if (!incremental) {
+						Ctrl_MoveFrom(comm, p_tiles->mat);
+						Ctrl_WaitTile(comm, p_tiles->mat);
+					}
+
+					HitTile(EPSILOD_BASE_TYPE) *globalMat = (HitTile(EPSILOD_BASE_TYPE) *)hit_tileRoot(&p_tiles->mat);
+
+					// Free old tilecopy
+					free_epsilod_tiles(*pp_tiles_copy);
+
+					if (!epsilod_exp_mode()) {
+						printf("[%d] new_lay->shape: ", hit_Rank);
+						dumpShape(new_lay.shape);
+						fflush(stdout);
+
+						printf("[%d] new_lay->orig: ", hit_Rank);
+						dumpShape(new_lay.origShape);
+						fflush(stdout);
+					}
+
+					// Create new tiles
+					int dims        = hit_layNumDims(new_lay);
+					int num_borders = epsilod_num_borders(dims);
+
+					init_comm_args(&comm_args, stencil, new_lay);
+
+					// Compute new tiles
+					EpsilodTiles *p_new_tiles = create_tiles(comm, new_lay, globalMat, borders, comm_args);
+
+					// Initialize array
+					print_once("ALB Redistribution\n");
+					print_weights(weights);
+					epsilod_weights_update(weights);
+
+					// Redistribute
+					if (incremental) {
+						int       comm_procs = lay_comm.topo.card[0];
+						HitShape *shapes     = gather_shapes(lay_comm.pTopology[0]->comm, *p_lay, new_lay);
+						alb_migrate(comm, lay_comm, 0, comm_procs, shapes, (HitTile *)globalMat, borders, &p_tiles->mat, &p_new_tiles->mat, HIT_CELL);
+						node_rows_update(0, comm_procs, shapes);
+						free(shapes);
+					} else if (grid)
+						grid_redistribute(comm, (HitTile *)globalMat, borders, *epsilod_grid(), new_grid, new_lay, &p_tiles->mat, &p_new_tiles->mat, HIT_CELL);
+					else
+						hit_patternDoOnce(hit_patternLayRedistributeGeneric(*p_lay, new_lay, &p_tiles->mat, &p_new_tiles->mat, HIT_CELL, expandShapeBorders, expandShapeBordersAndHalos));
+					if (grid) {
+						epsilod_grid_free(epsilod_grid());
+						*epsilod_grid() = new_grid;
+					}
+
+					// Update layout
+					hit_layFree(*p_lay);
+					*p_lay = new_lay;
+
+					// Free old tiles
+					free_epsilod_tiles(p_tiles);
+
+					// Compute new tiles copy
+					EpsilodTiles *p_new_tiles_copy = create_tiles(comm, new_lay, globalMat, borders, comm_args);
+
+					// Compute new comm patterns
+					CommCompIndex sorted_comm_indexes[num_borders];
+					sort_comm_indexes(*p_new_tiles, sorted_comm_indexes);
+					p_new_tiles->neighSync      = create_comm_pattern(comm, p_new_tiles, comm_args, sorted_comm_indexes, new_lay, HIT_CELL);
+					p_new_tiles_copy->neighSync = create_comm_pattern(comm, p_new_tiles_copy, comm_args, sorted_comm_indexes, new_lay, HIT_CELL);
+
+					*p_threads = get_threads(*p_new_tiles);
+					*p_coords  = get_global_coords(*p_new_tiles, borders);
+
+					*pp_tiles      = p_new_tiles;
+					*pp_tiles_copy = p_new_tiles_copy;
+
+					// Incremental migrations already filled the halos in the device
+					if (!incremental) {
+						// Communicate halos
+						hit_patternDo(p_new_tiles->neighSync);
+
+						// Move matrix to device
+						// NOTE this causes a warning due to mat not being initialized on the host, a host task to mark it as initialized can't be launched from here
+						Ctrl_MoveTo(comm, p_new_tiles->mat);
+						Ctrl_WaitTile(comm, p_new_tiles->mat);
+					}
+
+					// Reset average
+					hit_avgResetData(&avg);
+					comm_times = false;
+				}
+				hit_clockStop(redis_clock);
 			}
-
-			// Create new tiles
-			int dims        = hit_layNumDims(new_lay);
-			int num_borders = epsilod_num_borders(dims);
-
-			init_comm_args(&comm_args, stencil, new_lay);
-
-			// Compute new tiles
-			EpsilodTiles *p_new_tiles = create_tiles(comm, new_lay, globalMat, borders, comm_args);
-
-			// Initialize array
-			print_once("ALB Redistribution\n");
-			print_once("\nPartition weights = {");
-			for (int i = 0; i < weights.num_procs; i++)
-				print_once(" %f,", weights.ratios[i]);
-			print_once("\b }\n");
-			fflush(stdout);
-
-			// Redistribute
-			hit_patternDoOnce(hit_patternLayRedistributeGeneric(*p_lay, new_lay, &p_tiles->mat, &p_new_tiles->mat, HIT_FLOAT, expandShapeBorders, expandShapeBordersAndHalos));
-
-			// Update layout
-			hit_layFree(*p_lay);
-			*p_lay = new_lay;
-
-			// Free old tiles
-			free_epsilod_tiles(p_tiles);
-
-			// Compute new tiles copy
-			EpsilodTiles *p_new_tiles_copy = create_tiles(comm, new_lay, globalMat, borders, comm_args);
-
-			// Compute new comm patterns
-			CommCompIndex sorted_comm_indexes[num_borders];
-			sort_comm_indexes(*p_new_tiles, sorted_comm_indexes);
-			p_new_tiles->neighSync      = create_comm_pattern(comm, p_new_tiles, comm_args, sorted_comm_indexes, new_lay, HIT_CELL);
-			p_new_tiles_copy->neighSync = create_comm_pattern(comm, p_new_tiles_copy, comm_args, sorted_comm_indexes, new_lay, HIT_CELL);
-
-			*p_threads = get_threads(*p_new_tiles);
-			*p_coords  = get_global_coords(*p_new_tiles, borders);
-
-			// Communicate halos
-			hit_patternDo(p_new_tiles->neighSync);
-
-			*pp_tiles      = p_new_tiles;
-			*pp_tiles_copy = p_new_tiles_copy;
-
-			// Move matrix to device
-			// NOTE this causes a warning due to mat not being initialized on the host, a host task to mark it as initialized can't be launched from here
-			Ctrl_MoveTo(comm, p_new_tiles->mat);
-			Ctrl_WaitTile(comm, p_new_tiles->mat);
-
-			// Reset average
-			hit_avgResetData(&avg);
-			comm_times = false;
-			#ifdef _EPS_ALB_EXP_MODE_
-			expALB_print("&1& %d,", hit_Rank);
-			expALB_print(" %f", weights.ratios[0]);
-			for (int i = 1; i < weights.num_procs; i++)
-				expALB_print(", %f", weights.ratios[i]);
-			expALB_print("\n");
-			#endif //_EPS_ALB_EXP_MODE_
-			hit_clockStop(redis_clock);
 		}
+	} else if (node.enabled && !next.pending && !comm_times && (average != HITAVG_NOT_FULL) && curr_iter % node.period == 0) {
+		node_start(*p_lay, average);
 	}
 	curr_iter++;
 	if (is_last) {
+		if (next.p_tiles != NULL) {
+			free_epsilod_tiles(next.p_tiles);
+			free_epsilod_tiles(next.p_tiles_copy);
+			free_next_comm_args();
+			next.p_tiles      = NULL;
+			next.p_tiles_copy = NULL;
+		}
+		if (next.pending) {
+			hit_layFree(next.lay);
+			epsilod_grid_free(&next.grid);
+			next.pending = false;
+		}
 		heur.end(heur.state);
 		hit_layFree(lay_comm);
 		hit_tileFree(row_times);
 		hit_tileFree(avg_times);
 		hit_tileFree(redis_times);
+		hit_tileFree(model_params);
+		if (node.enabled) {
+			if (node.gathering)
+				MPI_Wait(&node.req, MPI_STATUS_IGNORE);
+			MPI_Comm_free(&node.comm);
+			free(node.rows);
+			free(node.samples);
+			node.enabled   = false;
+			node.gathering = false;
+		}
 	}
 	#ifdef DEBUG
 	hit_clockStart(call_clock);
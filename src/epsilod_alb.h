@@ -13,6 +13,11 @@
 #include "epsilod_structs.h"
 #include "epsilod_alb_heuristics.h"
 
+/**
+ * Number of (local size, load) samples kept by each process to fit its throughput model
+ */
+#define EPSILOD_ALB_MODEL_SAMPLES 8
+
 /**
  * @brief Rebalances the load of the computing nodes
  *
@@ -32,11 +37,37 @@
  * @param p_threads Computation thread spaces for kernels. Overwriten when ALB is performed
  * @param stencil Weights for the stencl. Used to recalculate active borders
  * @param HIT_CELL Type for a stencil cell. Needed to compute the new communication patterns
- * @param time Time of the previous iteration inner kernel
+ * @param times Parts of the time of the previous iteration. They are combined into the load to balance
+ * @param remaining_iters Number of iterations left after the current one
  * @param is_last Whether or not is this the last iteration
  * @return Whether an alb was performed this iteration or not
  */
 bool EPSILOD_ALB(PCtrl comm, EpsilodTiles **pp_tiles, EpsilodTiles **pp_tiles_copy, EpsilodGlobalCoords *p_coords, EpsilodCommArgs comm_args,
-				 HitLayout *p_lay, EpsilodThreads *p_threads, HitTile_float stencil, HitType HIT_CELL, double time, bool is_last);
+				 HitLayout *p_lay, EpsilodThreads *p_threads, HitTile_float stencil, HitType HIT_CELL, EpsilodIterTimes times, int remaining_iters, bool is_last);
+
+/**
+ * @brief Load of an iteration with the weights of EPSILOD_ALB_LOAD. @see epsilod_alb_load_weights()
+ * Used by ALB when the heuristic has no \e load function.
+ *
+ * @param times Parts of the time of the iteration
+ * @return Weighted sum of the parts
+ */
+double EPSILOD_ALB_load(EpsilodIterTimes times);
+
+/**
+ * @brief Builds the tiles and communication patterns of a partition scheduled by an asynchronous ALB.
+ * It is called after launching the kernels of an iteration, so that the host work overlaps them. The old
+ * partition keeps iterating, and the next call to EPSILOD_ALB() switches to the new one migrating only the
+ * cells that change owner. Both sets of tiles are allocated in the meantime. Does nothing if there is no
+ * scheduled partition or it is already prepared. @see epsilod_alb_async()
+ *
+ * @param comm Controller object to allocate memory and interact with the device
+ * @param p_tiles Current set of tiles
+ * @param coords Current set of epsilod coordinates
+ * @param comm_args Communication arguments of the current partition. They are not modified until the switch
+ * @param stencil Weights for the stencil. Used to recalculate active borders
+ * @param HIT_CELL Type for a stencil cell. Needed to compute the new communication patterns
+ */
+void EPSILOD_ALB_prepare(PCtrl comm, EpsilodTiles *p_tiles, EpsilodGlobalCoords coords, EpsilodCommArgs comm_args, HitTile_float stencil, HitType HIT_CELL);
 
 #endif // _EPSILOD_ALB_
@@ -36,6 +36,25 @@ typedef struct Heur_DoubleIters_State {
 	int nextALB; /**< Iteration of next ALB */
 } Heur_DoubleIters_State;
 
+/**
+ * Internal state of the CostBenefit heuristic
+ * @see heur_costBenefit
+ */
+typedef struct Heur_CostBenefit_State {
+	double margin;    /**< Noise margin, relative to the average load */
+	double avg_redis; /**< Average redistribution time of the previous redistributions */
+	int    num_redis; /**< Number of measured redistributions */
+} Heur_CostBenefit_State;
+
+/**
+ * Heuristics registered by the application
+ */
+static struct {
+	const char *name;
+	Heuristic   heur;
+} user_heuristics[EPSILOD_MAX_USER_HEURISTICS];
+static int num_user_heuristics = 0;
+
 /**
  * Init function of the NextALB NextALB heuristic
  * @see heur_nextALB
@@ -71,7 +90,7 @@ bool Heur_NextALB_Check(void *state, int curr_iter, int curr_ALB) {
  * @param curr_iter current stencil iteration
  * @param curr_ALB current ALB iteration
  * @param row_times average time per row for each process
- * @param avg_times average inner kernel time for each process
+ * @param avg_times average load (weighted iteration time) for each process
  * @param redis_times redistribution time for each process
  */
 void Heur_NextALB_Redis(void *state, int curr_iter, int curr_ALB, HitTile_double row_times, HitTile_double avg_times, HitTile_double redis_times) {
@@ -137,7 +156,7 @@ bool Heur_ConstIters_Check(void *state, int curr_iter, int curr_ALB) {
  * @param curr_iter current stencil iteration
  * @param curr_ALB current ALB iteration
  * @param row_times average time per row for each process
- * @param avg_times average inner kernel time for each process
+ * @param avg_times average load (weighted iteration time) for each process
  * @param redis_times redistribution time for each process
  */
 void Heur_ConstIters_Redis(void *state, int curr_iter, int curr_ALB, HitTile_double row_times, HitTile_double avg_times, HitTile_double redis_times) {
@@ -190,7 +209,7 @@ bool Heur_ExpIters_Check(void *state, int curr_iter, int curr_ALB) {
  * @param curr_iter current stencil iteration
  * @param curr_ALB current ALB iteration
  * @param row_times average time per row for each process
- * @param avg_times average inner kernel time for each process
+ * @param avg_times average load (weighted iteration time) for each process
  * @param redis_times redistribution time for each process
  */
 void Heur_ExpIters_Redis(void *state, int curr_iter, int curr_ALB, HitTile_double row_times, HitTile_double avg_times, HitTile_double redis_times) {
@@ -246,7 +265,7 @@ bool Heur_DoubleIters_Check(void *state, int curr_iter, int curr_ALB) {
  * @param curr_iter current stencil iteration
  * @param curr_ALB current ALB iteration
  * @param row_times average time per row for each process
- * @param avg_times average inner kernel time for each process
+ * @param avg_times average load (weighted iteration time) for each process
  * @param redis_times redistribution time for each process
  */
 void Heur_DoubleIters_Redis(void *state, int curr_iter, int curr_ALB, HitTile_double row_times, HitTile_double avg_times, HitTile_double redis_times) {
@@ -268,6 +287,100 @@ void Heur_DoubleIters_Redis(void *state, int curr_iter, int curr_ALB, HitTile_do
 	#endif //_EPS_ALB_EXP_MODE_
 }
 
+/**
+ * Init function of the CostBenefit heuristic
+ * @see heur_costBenefit
+ *
+ * @return Heur_CostBenefit_State* internal state for costBenefit heuristic
+ */
+void *Heur_CostBenefit_Init() {
+	Heur_CostBenefit_State *state = (Heur_CostBenefit_State *)malloc(sizeof(Heur_CostBenefit_State));
+	state->margin                 = epsilod_alb_margin();
+	state->avg_redis              = 0;
+	state->num_redis              = 0;
+	return state;
+}
+
+/**
+ * Check function of the CostBenefit heuristic. Times are gathered whenever the averages are full, the
+ * decision is taken in the accept function
+ * @see heur_costBenefit
+ *
+ * @param state internal state of the heuristic
+ * @param curr_iter current stencil iteration
+ * @param curr_ALB current ALB iteration
+ * @return whether times should be gathered this iteration
+ */
+bool Heur_CostBenefit_Check(void *state, int curr_iter, int curr_ALB) {
+	return true;
+}
+
+/**
+ * Accept function of the CostBenefit heuristic.
+ * A perfect balance brings every process to the average load, so the time saved per iteration is the
+ * difference between the slowest process and the average. The redistribution is accepted when this imbalance
+ * exceeds the noise margin, and the time saved over the remaining iterations exceeds the average cost of the
+ * previous redistributions increased by the same margin.
+ * @see heur_costBenefit
+ *
+ * @param state internal state of the heuristic
+ * @param curr_iter current stencil iteration
+ * @param curr_ALB current ALB iteration
+ * @param remaining_iters iterations left after the current one
+ * @param row_times average time per row for each process
+ * @param avg_times average load (weighted iteration time) for each process
+ * @param redis_times redistribution time for each process
+ * @return whether the redistribution is worth it
+ */
+bool Heur_CostBenefit_Accept(void *state, int curr_iter, int curr_ALB, int remaining_iters, HitTile_double row_times, HitTile_double avg_times, HitTile_double redis_times) {
+	Heur_CostBenefit_State *state_inner = (Heur_CostBenefit_State *)state;
+	double                  sum_avg     = 0;
+	double                  worst       = 0;
+	double                  worst_redis = 0;
+	int                     active      = 0;
+
+	for (int k = 0; k < hit_tileCard(avg_times); k++) {
+		if (hit(avg_times, k) <= 0.0) continue;
+		sum_avg += hit(avg_times, k);
+		active++;
+		if (hit(avg_times, k) > worst) worst = hit(avg_times, k);
+	}
+	for (int k = 0; k < hit_tileCard(redis_times); k++)
+		if (hit(redis_times, k) > worst_redis) worst_redis = hit(redis_times, k);
+	if (active == 0)
+		return false;
+
+	// The redistribution times gathered are those of the last redistribution
+	if (curr_ALB > state_inner->num_redis && worst_redis > 0.0) {
+		state_inner->avg_redis = (state_inner->avg_redis * state_inner->num_redis + worst_redis) / (state_inner->num_redis + 1);
+		state_inner->num_redis++;
+	}
+
+	double avg    = sum_avg / active;
+	double gain   = (worst - avg) * remaining_iters;
+	double cost   = state_inner->avg_redis * (1.0 + state_inner->margin);
+	bool   accept = (worst - avg) > state_inner->margin * avg && gain > cost;
+
+	#ifdef _EPS_ALB_EXP_MODE_
+	expALB_print("&2& \"costbenefit\",%d,%d,%d,%lf,%lf,%lf,%lf,%d\n", hit_Rank, curr_iter, curr_ALB, worst, avg, gain, cost, accept);
+	#endif //_EPS_ALB_EXP_MODE_
+	return accept;
+}
+
+/**
+ * Redis function of the CostBenefit heuristic
+ * @see heur_costBenefit
+ *
+ * @param state internal state of the heuristic
+ * @param curr_iter current stencil iteration
+ * @param curr_ALB current ALB iteration
+ * @param row_times average time per row for each process
+ * @param avg_times average load (weighted iteration time) for each process
+ * @param redis_times redistribution time for each process
+ */
+void Heur_CostBenefit_Redis(void *state, int curr_iter, int curr_ALB, HitTile_double row_times, HitTile_double avg_times, HitTile_double redis_times) {
+}
+
 /**
  * Generic ending function for heuristics
  *
@@ -277,14 +390,34 @@ void Heur_End(void *state) {
 	free(state);
 }
 
+void epsilod_register_heuristic(const char *name, Heuristic heur) {
+	if (num_user_heuristics == EPSILOD_MAX_USER_HEURISTICS) {
+		fprintf(stderr, "\nError: Too many ALB heuristics registered. The maximum is %d.\n\n", EPSILOD_MAX_USER_HEURISTICS);
+		MPI_Abort(MPI_COMM_WORLD, MPI_ERR_OTHER);
+		exit(EXIT_FAILURE);
+	}
+	if (heur.init == NULL || heur.check == NULL || heur.redis == NULL || heur.end == NULL) {
+		fprintf(stderr, "\nError: ALB heuristic %s registered without init, check, redis or end functions.\n\n", name);
+		MPI_Abort(MPI_COMM_WORLD, MPI_ERR_OTHER);
+		exit(EXIT_FAILURE);
+	}
+	user_heuristics[num_user_heuristics].name = name;
+	user_heuristics[num_user_heuristics].heur = heur;
+	num_user_heuristics++;
+}
+
 Heuristic epsilod_get_heuristic() {
-	const char *options[] = {"none", "NextALB", "ConstIters", "ExpIters", "DoubleIters", NULL};
-	int         heur_idx  = hit_envOptions("EPSILOD_ALB_HEUR", options);
+	const char *options[6 + EPSILOD_MAX_USER_HEURISTICS + 1] = {"none", "NextALB", "ConstIters", "ExpIters", "DoubleIters", "CostBenefit"};
+	for (int i = 0; i < num_user_heuristics; i++)
+		options[6 + i] = user_heuristics[i].name;
+	options[6 + num_user_heuristics] = NULL;
+	int heur_idx                     = hit_envOptions("EPSILOD_ALB_HEUR", options);
 
-	// Check if partition is w, max dims is passed as it's only used for error checking irrelevant for this
+	// Check if partition is w or g, max dims is passed as it's only used for error checking irrelevant for this
 	PartitionInfo part_info = get_partition_info(EPSILOD_MAX_DIMS);
-	if (part_info.type != EPSILOD_PARTITION_WEIGHTED && heur_idx != 0) {
-		print_once("Warning: ALB heuristic %s was selected but the partition is not weighted. Only weighted (w) partitions may use ALB. Disabling ALB.\n", options[heur_idx]);
+	bool          weighted  = part_info.type == EPSILOD_PARTITION_WEIGHTED || part_info.type == EPSILOD_PARTITION_WEIGHTED_GRID;
+	if (!weighted && heur_idx != 0) {
+		print_once("Warning: ALB heuristic %s was selected but the partition is not weighted. Only weighted (w, g) partitions may use ALB. Disabling ALB.\n", options[heur_idx]);
 		heur_idx = 0;
 	}
 
@@ -294,7 +427,10 @@ Heuristic epsilod_get_heuristic() {
 		case 2: return (Heuristic){.state = NULL, .init = Heur_ConstIters_Init, .check = Heur_ConstIters_Check, .redis = Heur_ConstIters_Redis, .end = Heur_End};
 		case 3: return (Heuristic){.state = NULL, .init = Heur_ExpIters_Init, .check = Heur_ExpIters_Check, .redis = Heur_ExpIters_Redis, .end = Heur_End};
 		case 4: return (Heuristic){.state = NULL, .init = Heur_DoubleIters_Init, .check = Heur_DoubleIters_Check, .redis = Heur_DoubleIters_Redis, .end = Heur_End};
+		case 5: return (Heuristic){.state = NULL, .init = Heur_CostBenefit_Init, .check = Heur_CostBenefit_Check, .redis = Heur_CostBenefit_Redis, .end = Heur_End, .accept = Heur_CostBenefit_Accept};
 		default:
+			if (heur_idx - 6 < num_user_heuristics)
+				return user_heuristics[heur_idx - 6].heur;
 			fprintf(stderr, "[epsilod_get_heuristic] Error: heuristic option out of bounds. heur_idx=%d", heur_idx);
 			exit(EXIT_FAILURE);
 	}
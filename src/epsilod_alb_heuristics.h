@@ -22,8 +22,25 @@ typedef struct Heuristic {
 	void (*redis)(void *state, int curr_iter, int curr_ALb,
 				  HitTile_double all_times, HitTile_double avg_times, HitTile_double redis_times); /**< Redis function, called when a redistribution happens */
 	void (*end)(void *state);                                                                      /**< End function, cleanup */
+	bool (*accept)(void *state, int curr_iter, int curr_ALb, int remaining_iters,
+				   HitTile_double row_times, HitTile_double avg_times, HitTile_double redis_times); /**< Optional. Accept function, called with the gathered times before redistributing. A false return skips the redistribution */
+	double (*load)(void *state, EpsilodIterTimes times); /**< Optional. Load function, combines the parts of the iteration time into the load to balance. NULL uses the weights of EPSILOD_ALB_LOAD */
 } Heuristic;
 
+/**
+ * Maximum number of heuristics registered by the application
+ */
+#define EPSILOD_MAX_USER_HEURISTICS 8
+
+/**
+ * @brief Registers a heuristic defined by the application.
+ * It can then be selected by its name in \e EPSILOD_ALB_HEUR, like the ones provided by EPSILOD.
+ * It must be called before stencilComputation().
+ * @param name Name of the heuristic. It must not match another heuristic, and the string must outlive the computation
+ * @param heur Heuristic. Its \e init, \e check, \e redis and \e end functions are required, \e accept and \e load are optional
+ */
+void epsilod_register_heuristic(const char *name, Heuristic heur);
+
 /**
  * Returns a newly created heuristic based on the environment variable \e EPSILOD_ALB_HEUR
  * Currently available options are:
@@ -31,6 +48,8 @@ typedef struct Heuristic {
  * 	\e ConstIters strategy, in which we rebalance after a constant number of iterations
  * 	\e ExpIters strategy, in which we rebalance after a exponentially increasing number of iterations
  * 	\e DoubleIters strategy, in which we rebalance after an amount of iterations that doubles each time number of iterations
+ * 	\e CostBenefit strategy, in which we rebalance when the time saved over the remaining iterations exceeds the redistribution cost
+ * 	Any heuristic registered with epsilod_register_heuristic()
  * @note These options are case sensitive
  *
  * @return A heuristic object that follows the selected strategy
@@ -0,0 +1,349 @@
+/**
+ * @file epsilod_codec.c
+ * @brief Epsilod: Codecs applied to halo messages between packing and interprocess transfers, and to chunked files.
+ *
+ * @copyright This software is part of the EPSILOD project by Trasgo Group, UVa.
+ * The relevant license, warranty and copyright notice is available in the EPSILOD project repository.
+ */
+
+#include "epsilod_codec.h"
+#include "epsilod_env.h"
+#include "epsilod_log.h"
+
+#ifdef EPSILOD_HAVE_LZ4
+#include <lz4.h>
+#endif // EPSILOD_HAVE_LZ4
+
+#ifdef EPSILOD_HAVE_ZSTD
+#include <zstd.h>
+#define EPSILOD_ZSTD_LEVEL 1
+#define EPSILOD_ZSTD_FILE_LEVEL 3
+#endif // EPSILOD_HAVE_ZSTD
+
+/**
+ * Accumulated sizes and times of encoded halo messages
+ */
+static struct {
+	double raw_bytes;     /**< Size of packed halos before encoding */
+	double encoded_bytes; /**< Size of encoded halos */
+	double encode_time;   /**< Time spent encoding */
+	double decode_time;   /**< Time spent decoding */
+} codec_stats;
+
+/**
+ * @brief Groups the bytes of the scalar components by significance.
+ * Exponent and high mantissa bytes of neighbouring values are similar, which helps byte-oriented compressors.
+ * @param src Data to shuffle.
+ * @param bytes Size of \p src. Multiple of the scalar size.
+ * @param dst Shuffled data.
+ */
+static void byte_shuffle(const unsigned char *src, size_t bytes, unsigned char *dst) {
+	size_t width = sizeof(EPSILOD_SCALAR_TYPE);
+	size_t n     = bytes / width;
+	for (size_t b = 0; b < width; b++)
+		for (size_t k = 0; k < n; k++)
+			dst[b * n + k] = src[k * width + b];
+}
+
+/**
+ * @brief Reverts byte_shuffle().
+ * @param src Shuffled data.
+ * @param bytes Size of \p src. Multiple of the scalar size.
+ * @param dst Original data.
+ */
+static void byte_unshuffle(const unsigned char *src, size_t bytes, unsigned char *dst) {
+	size_t width = sizeof(EPSILOD_SCALAR_TYPE);
+	size_t n     = bytes / width;
+	for (size_t b = 0; b < width; b++)
+		for (size_t k = 0; k < n; k++)
+			dst[k * width + b] = src[b * n + k];
+}
+
+/* A. Byte shuffle */
+static size_t shuffle_bound(size_t bytes) {
+	return bytes;
+}
+
+static size_t shuffle_encode(const void *src, size_t bytes, void *dst, size_t dst_bytes) {
+	byte_shuffle(src, bytes, dst);
+	return bytes;
+}
+
+static void shuffle_decode(const void *src, size_t encoded_bytes, void *dst, size_t bytes) {
+	byte_unshuffle(src, bytes, dst);
+}
+
+#if defined(EPSILOD_HAVE_LZ4) || defined(EPSILOD_HAVE_ZSTD)
+/**
+ * @brief Error in a codec operation. Aborts execution.
+ * @param msg Error description
+ */
+static void codec_error(const char *msg) {
+	fprintf(stderr, "\nError in codec: %s\n\n", msg);
+	MPI_Abort(MPI_COMM_WORLD, MPI_ERR_OTHER);
+	exit(EXIT_FAILURE);
+}
+
+/**
+ * @brief Get a host buffer for shuffled data before compression or after decompression.
+ * The buffer is reused by later calls.
+ * @param bytes Minimum size of the buffer.
+ * @return The buffer.
+ */
+static unsigned char *codec_scratch(size_t bytes) {
+	static unsigned char *scratch       = NULL;
+	static size_t         scratch_bytes = 0;
+	if (bytes > scratch_bytes) {
+		free(scratch);
+		scratch       = malloc(bytes);
+		scratch_bytes = bytes;
+		if (scratch == NULL)
+			codec_error("Not enough memory for the scratch buffer");
+	}
+	return scratch;
+}
+#endif // EPSILOD_HAVE_LZ4 || EPSILOD_HAVE_ZSTD
+
+/* B. Byte shuffle + LZ4 */
+#ifdef EPSILOD_HAVE_LZ4
+static size_t lz4_bound(size_t bytes) {
+	return (size_t)LZ4_compressBound((int)bytes);
+}
+
+static size_t lz4_encode(const void *src, size_t bytes, void *dst, size_t dst_bytes) {
+	unsigned char *shuffled = codec_scratch(bytes);
+	byte_shuffle(src, bytes, shuffled);
+	int encoded = LZ4_compress_default((const char *)shuffled, dst, (int)bytes, (int)dst_bytes);
+	if (encoded <= 0)
+		codec_error("LZ4 compression failed");
+	return (size_t)encoded;
+}
+
+static void lz4_decode(const void *src, size_t encoded_bytes, void *dst, size_t bytes) {
+	unsigned char *shuffled = codec_scratch(bytes);
+	int            decoded  = LZ4_decompress_safe(src, (char *)shuffled, (int)encoded_bytes, (int)bytes);
+	if (decoded != (int)bytes)
+		codec_error("LZ4 decompression failed");
+	byte_unshuffle(shuffled, bytes, dst);
+}
+#endif // EPSILOD_HAVE_LZ4
+
+/* C. Byte shuffle + zstd */
+#ifdef EPSILOD_HAVE_ZSTD
+static size_t zstd_bound(size_t bytes) {
+	return ZSTD_compressBound(bytes);
+}
+
+static size_t zstd_encode(const void *src, size_t bytes, void *dst, size_t dst_bytes) {
+	unsigned char *shuffled = codec_scratch(bytes);
+	byte_shuffle(src, bytes, shuffled);
+	size_t encoded = ZSTD_compress(dst, dst_bytes, shuffled, bytes, EPSILOD_ZSTD_LEVEL);
+	if (ZSTD_isError(encoded))
+		codec_error(ZSTD_getErrorName(encoded));
+	return encoded;
+}
+
+static void zstd_decode(const void *src, size_t encoded_bytes, void *dst, size_t bytes) {
+	unsigned char *shuffled = codec_scratch(bytes);
+	size_t         decoded  = ZSTD_decompress(shuffled, bytes, src, encoded_bytes);
+	if (ZSTD_isError(decoded) || decoded != bytes)
+		codec_error("zstd decompression failed");
+	byte_unshuffle(shuffled, bytes, dst);
+}
+#endif // EPSILOD_HAVE_ZSTD
+
+/* D. Lossy: double precision components transported as single precision */
+#if EPSILOD_IS_DOUBLE(EPSILOD_SCALAR_TYPE)
+static size_t fp32_bound(size_t bytes) {
+	return bytes / 2;
+}
+
+static size_t fp32_encode(const void *src, size_t bytes, void *dst, size_t dst_bytes) {
+	const double *in  = src;
+	float        *out = dst;
+	size_t        n   = bytes / sizeof(double);
+	for (size_t k = 0; k < n; k++)
+		out[k] = (float)in[k];
+	return n * sizeof(float);
+}
+
+static void fp32_decode(const void *src, size_t encoded_bytes, void *dst, size_t bytes) {
+	const float *in  = src;
+	double      *out = dst;
+	size_t       n   = bytes / sizeof(double);
+	for (size_t k = 0; k < n; k++)
+		out[k] = (double)in[k];
+}
+#endif // EPSILOD_IS_DOUBLE(EPSILOD_SCALAR_TYPE)
+
+/**
+ * @brief A codec was selected but it is not available in this build. Aborts execution.
+ * @param name Codec name.
+ * @param option CMake option that enables the codec.
+ */
+static void codec_unavailable(const char *name, const char *option) {
+	fprintf(stderr, "\nError in EPSILOD_HALO_CODEC enviroment string: Codec %s requires building with %s=ON\n\n", name, option);
+	MPI_Abort(MPI_COMM_WORLD, MPI_ERR_OTHER);
+	exit(EXIT_FAILURE);
+}
+
+EpsilodCodec *epsilod_get_halo_codec() {
+	static EpsilodCodec  codec;
+	static EpsilodCodec *p_codec = NULL;
+	static bool          loaded  = false;
+	if (loaded)
+		return p_codec;
+	loaded = true;
+
+	const char *options[] = {"none", "shuffle", "lz4", "zstd", "fp32", NULL};
+	int         codec_idx = hit_envOptions("EPSILOD_HALO_CODEC", options);
+	if (codec_idx == 0)
+		return p_codec;
+
+	if (mpi_dev_aware() || !comms_contiguous_buffers()) {
+		print_once("Warning: halo codec %s requires host staging and contiguous buffers. Halos are not encoded.\n", options[codec_idx]);
+		return p_codec;
+	}
+
+	switch (codec_idx) {
+		case 1:
+			codec = (EpsilodCodec){.name = "shuffle", .lossy = false, .bound = shuffle_bound, .encode = shuffle_encode, .decode = shuffle_decode};
+			break;
+		case 2:
+			#ifdef EPSILOD_HAVE_LZ4
+			codec = (EpsilodCodec){.name = "lz4", .lossy = false, .bound = lz4_bound, .encode = lz4_encode, .decode = lz4_decode};
+			#else
+			codec_unavailable(options[codec_idx], "EPSILOD_WITH_LZ4");
+			#endif // EPSILOD_HAVE_LZ4
+			break;
+		case 3:
+			#ifdef EPSILOD_HAVE_ZSTD
+			codec = (EpsilodCodec){.name = "zstd", .lossy = false, .bound = zstd_bound, .encode = zstd_encode, .decode = zstd_decode};
+			#else
+			codec_unavailable(options[codec_idx], "EPSILOD_WITH_ZSTD");
+			#endif // EPSILOD_HAVE_ZSTD
+			break;
+		case 4:
+			#if EPSILOD_IS_DOUBLE(EPSILOD_SCALAR_TYPE)
+			codec = (EpsilodCodec){.name = "fp32", .lossy = true, .bound = fp32_bound, .encode = fp32_encode, .decode = fp32_decode};
+			break;
+			#else
+			print_once("Warning: halo codec fp32 requires double precision components. Halos are not encoded.\n");
+			return p_codec;
+			#endif // EPSILOD_IS_DOUBLE(EPSILOD_SCALAR_TYPE)
+		default:
+			fprintf(stderr, "[epsilod_get_halo_codec] Error: codec option out of bounds. codec_idx=%d", codec_idx);
+			exit(EXIT_FAILURE);
+	}
+
+	p_codec = &codec;
+	print_once("Epsilod halo codec: %s%s\n", codec.name, codec.lossy ? " (lossy)" : "");
+	return p_codec;
+}
+
+size_t epsilod_codec_encode(EpsilodCodec *codec, const void *src, size_t bytes, void *dst) {
+	double start         = MPI_Wtime();
+	size_t encoded_bytes = codec->encode(src, bytes, dst, codec->bound(bytes));
+	codec_stats.encode_time += MPI_Wtime() - start;
+	codec_stats.raw_bytes += (double)bytes;
+	codec_stats.encoded_bytes += (double)encoded_bytes;
+	return encoded_bytes;
+}
+
+void epsilod_codec_decode(EpsilodCodec *codec, const void *src, size_t encoded_bytes, void *dst, size_t bytes) {
+	double start = MPI_Wtime();
+	codec->decode(src, encoded_bytes, dst, bytes);
+	codec_stats.decode_time += MPI_Wtime() - start;
+}
+
+void epsilod_codec_report() {
+	EpsilodCodec *codec = epsilod_get_halo_codec();
+	if (codec == NULL)
+		return;
+
+	double sizes[2] = {codec_stats.raw_bytes, codec_stats.encoded_bytes};
+	double times[2] = {codec_stats.encode_time, codec_stats.decode_time};
+	double total_sizes[2], max_times[2];
+	MPI_Reduce(sizes, total_sizes, 2, MPI_DOUBLE, MPI_SUM, 0, hit_Comm);
+	MPI_Reduce(times, max_times, 2, MPI_DOUBLE, MPI_MAX, 0, hit_Comm);
+
+	double ratio = (total_sizes[1] > 0) ? total_sizes[0] / total_sizes[1] : 1.0;
+	print_once("Halo codec %s: ratio %.3lf (%.0lf -> %.0lf bytes), max. encode time %lf, max. decode time %lf\n",
+			   codec->name, ratio, total_sizes[0], total_sizes[1], max_times[0], max_times[1]);
+}
+
+/* E. Chunked files: byte shuffle + LZ4 or zstd, with the scratch buffer of the caller */
+size_t epsilod_chunk_compress_bound(EpsilodChunkCodec codec, size_t bytes) {
+	switch (codec) {
+		#ifdef EPSILOD_HAVE_LZ4
+		case EPSILOD_CHUNK_CODEC_LZ4:
+			return lz4_bound(bytes);
+		#endif // EPSILOD_HAVE_LZ4
+		#ifdef EPSILOD_HAVE_ZSTD
+		case EPSILOD_CHUNK_CODEC_ZSTD:
+			return zstd_bound(bytes);
+		#endif // EPSILOD_HAVE_ZSTD
+		default:
+			return bytes;
+	}
+}
+
+/**
+ * @brief A chunked file uses a compressor that is not available in this build. Aborts execution.
+ * @param codec Compressor of the file.
+ */
+static void chunk_codec_unavailable(EpsilodChunkCodec codec) {
+	fprintf(stderr, "\nError: Chunked files compressed with %s require building with %s=ON\n\n", (codec == EPSILOD_CHUNK_CODEC_LZ4) ? "lz4" : "zstd", (codec == EPSILOD_CHUNK_CODEC_LZ4) ? "EPSILOD_WITH_LZ4" : "EPSILOD_WITH_ZSTD");
+	MPI_Abort(MPI_COMM_WORLD, MPI_ERR_OTHER);
+	exit(EXIT_FAILURE);
+}
+
+size_t epsilod_chunk_compress(EpsilodChunkCodec codec, const void *src, size_t bytes, void *dst, size_t dst_bytes, void *scratch) {
+	switch (codec) {
+		#ifdef EPSILOD_HAVE_LZ4
+		case EPSILOD_CHUNK_CODEC_LZ4: {
+			byte_shuffle(src, bytes, scratch);
+			int encoded = LZ4_compress_default(scratch, dst, (int)bytes, (int)dst_bytes);
+			if (encoded <= 0)
+				codec_error("LZ4 compression failed");
+			return (size_t)encoded;
+		}
+		#endif // EPSILOD_HAVE_LZ4
+		#ifdef EPSILOD_HAVE_ZSTD
+		case EPSILOD_CHUNK_CODEC_ZSTD: {
+			byte_shuffle(src, bytes, scratch);
+			size_t encoded = ZSTD_compress(dst, dst_bytes, scratch, bytes, EPSILOD_ZSTD_FILE_LEVEL);
+			if (ZSTD_isError(encoded))
+				codec_error(ZSTD_getErrorName(encoded));
+			return encoded;
+		}
+		#endif // EPSILOD_HAVE_ZSTD
+		default:
+			chunk_codec_unavailable(codec);
+			return 0;
+	}
+}
+
+void epsilod_chunk_decompress(EpsilodChunkCodec codec, const void *src, size_t encoded_bytes, void *dst, size_t bytes, void *scratch) {
+	switch (codec) {
+		#ifdef EPSILOD_HAVE_LZ4
+		case EPSILOD_CHUNK_CODEC_LZ4: {
+			int decoded = LZ4_decompress_safe(src, scratch, (int)encoded_bytes, (int)bytes);
+			if (decoded != (int)bytes)
+				codec_error("LZ4 decompression failed");
+			break;
+		}
+		#endif // EPSILOD_HAVE_LZ4
+		#ifdef EPSILOD_HAVE_ZSTD
+		case EPSILOD_CHUNK_CODEC_ZSTD: {
+			size_t decoded = ZSTD_decompress(scratch, bytes, src, encoded_bytes);
+			if (ZSTD_isError(decoded) || decoded != bytes)
+				codec_error("zstd decompression failed");
+			break;
+		}
+		#endif // EPSILOD_HAVE_ZSTD
+		default:
+			chunk_codec_unavailable(codec);
+	}
+	byte_unshuffle(scratch, bytes, dst);
+}
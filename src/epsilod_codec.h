@@ -0,0 +1,98 @@
+/**
+ * @file epsilod_codec.h
+ * @brief Epsilod: Codecs applied to halo messages between packing and interprocess transfers, and to chunked files.
+ *
+ * @copyright This software is part of the EPSILOD project by Trasgo Group, UVa.
+ * The relevant license, warranty and copyright notice is available in the EPSILOD project repository.
+ */
+
+#ifndef _EPSILOD_CODEC_H_
+#define _EPSILOD_CODEC_H_
+
+#include "epsilod_structs.h"
+
+/**
+ * Generic halo codec type
+ */
+typedef struct EpsilodCodec {
+	const char *name;                                                                  /**< Name used in EPSILOD_HALO_CODEC */
+	bool        lossy;                                                                 /**< Whether decoded data may differ from the original */
+	size_t (*bound)(size_t bytes);                                                     /**< Bound function, maximum encoded size of a message */
+	size_t (*encode)(const void *src, size_t bytes, void *dst, size_t dst_bytes);      /**< Encode function, returns the encoded size */
+	void (*decode)(const void *src, size_t encoded_bytes, void *dst, size_t bytes); /**< Decode function, \p bytes is the decoded size */
+} EpsilodCodec;
+
+/**
+ * Returns the halo codec selected by the environment variable \e EPSILOD_HALO_CODEC
+ * Currently available options are:
+ * 	\e none, halos are sent as they are packed
+ * 	\e shuffle, lossless byte shuffle of the scalar components. Only useful before a compressor
+ * 	\e lz4, lossless byte shuffle followed by LZ4 compression. Requires building with EPSILOD_WITH_LZ4
+ * 	\e zstd, lossless byte shuffle followed by zstd compression. Requires building with EPSILOD_WITH_ZSTD
+ * 	\e fp32, lossy transport of double precision components as single precision
+ * @note These options are case sensitive
+ *
+ * @return The selected codec, or NULL if halos are not encoded
+ */
+EpsilodCodec *epsilod_get_halo_codec();
+
+/**
+ * @brief Encodes a halo message and accounts for its size and time.
+ * @param codec Halo codec.
+ * @param src Packed halo data.
+ * @param bytes Size of \p src.
+ * @param dst Buffer of at least codec->bound(bytes) bytes.
+ * @return The encoded size.
+ */
+size_t epsilod_codec_encode(EpsilodCodec *codec, const void *src, size_t bytes, void *dst);
+
+/**
+ * @brief Decodes a halo message and accounts for its time.
+ * @param codec Halo codec.
+ * @param src Encoded halo data.
+ * @param encoded_bytes Size of \p src.
+ * @param dst Buffer for the packed halo data.
+ * @param bytes Size of \p dst.
+ */
+void epsilod_codec_decode(EpsilodCodec *codec, const void *src, size_t encoded_bytes, void *dst, size_t bytes);
+
+/**
+ * @brief Print the compression ratio and the encode/decode times of the halo codec.
+ * Collective operation in hit_Comm. Nothing is printed if halos are not encoded.
+ */
+void epsilod_codec_report();
+
+/**
+ * @brief Maximum compressed size of a block of a chunked file.
+ * @param codec Compressor, not EPSILOD_CHUNK_CODEC_NONE.
+ * @param bytes Size of the block.
+ * @return The size of the buffer needed by epsilod_chunk_compress().
+ */
+size_t epsilod_chunk_compress_bound(EpsilodChunkCodec codec, size_t bytes);
+
+/**
+ * @brief Byte shuffles and compresses a block of a chunked file.
+ * Unlike the halo codecs it does not use shared buffers, so blocks can be compressed by concurrent threads.
+ * @param codec Compressor, not EPSILOD_CHUNK_CODEC_NONE.
+ * @param src Cells of the block.
+ * @param bytes Size of \p src. Multiple of the scalar size.
+ * @param dst Compressed block.
+ * @param dst_bytes Size of \p dst, at least epsilod_chunk_compress_bound(codec, bytes).
+ * @param scratch Buffer of \p bytes bytes for the shuffled cells.
+ * @return The compressed size.
+ */
+size_t epsilod_chunk_compress(EpsilodChunkCodec codec, const void *src, size_t bytes, void *dst, size_t dst_bytes, void *scratch);
+
+/**
+ * @brief Decompresses and unshuffles a block of a chunked file. Thread safe, like epsilod_chunk_compress().
+ * Aborts if the block is corrupted or the compressor is not available in this build.
+ * @param codec Compressor of the file.
+ * @param src Compressed block.
+ * @param encoded_bytes Size of \p src.
+ * @param dst Cells of the block.
+ * @param bytes Size of \p dst.
+ * @param scratch Buffer of \p bytes bytes for the shuffled cells.
+ */
+void epsilod_chunk_decompress(EpsilodChunkCodec codec, const void *src, size_t encoded_bytes, void *dst, size_t bytes, void *scratch);
+
+#endif // _EPSILOD_CODEC_H_
@@ -0,0 +1,175 @@
+/**
+ * @file epsilod_components.c
+ * @brief Epsilod: Components of compound cells communicated in each halo
+ *
+ * @copyright This software is part of the EPSILOD project by Trasgo Group, UVa.
+ * The relevant license, warranty and copyright notice is available in the EPSILOD project repository.
+ */
+
+#include <string.h>
+
+#include "epsilod_components.h"
+#include "epsilod_log.h"
+
+/**
+ * Neighbour offsets of the components declared by the user
+ */
+static struct {
+	bool set;                                                /**< Whether offsets have been declared */
+	int  dims;                                               /**< Number of dimensions of the offsets */
+	int  offsets[EPSILOD_MAX_COMPONENTS * EPSILOD_MAX_DIMS]; /**< Offsets, offsets[c * dims + d] */
+} components;
+
+/**
+ * @brief Prints an error about component offsets and aborts.
+ * @param message Error message.
+ */
+static void components_error(const char *message) {
+	fprintf(stderr, "\nError: %s.\n\n", message);
+	MPI_Abort(MPI_COMM_WORLD, MPI_ERR_OTHER);
+	exit(EXIT_FAILURE);
+}
+
+void epsilod_set_component_offsets(int num_components, int dims, const int *offsets) {
+	#if CTRL_COUNTPARAM(EPSILOD_BASE_TYPE_COMPOUND) == 2
+	if (num_components != EPSILOD_SCALAR_COUNT)
+		components_error("The number of component offsets does not match the components of the cell type");
+	if (num_components > EPSILOD_MAX_COMPONENTS)
+		components_error("Too many components for component offsets. Increase EPSILOD_MAX_COMPONENTS");
+	if (dims < 1 || dims > EPSILOD_MAX_DIMS)
+		components_error("Invalid number of dimensions for component offsets");
+
+	memcpy(components.offsets, offsets, sizeof(int) * num_components * dims);
+	components.dims = dims;
+	components.set  = true;
+	#else  // CTRL_COUNTPARAM(EPSILOD_BASE_TYPE_COMPOUND) < 2
+	print_once("Warning: Component offsets are ignored for non compound cell types.\n");
+	#endif // CTRL_COUNTPARAM(EPSILOD_BASE_TYPE_COMPOUND)
+}
+
+bool epsilod_component_masks_active() {
+	return components.set;
+}
+
+/**
+ * @brief Selects the components read from the halo of a border.
+ * A component is read from a halo if its offset has the direction of the border in every dimension where the border is displaced.
+ * @param dims The number of dimensions of the domain.
+ * @param border Border index.
+ * @return Component mask. Empty for the inner zone.
+ */
+static EpsilodComponentMask border_mask(int dims, int border) {
+	int shift[EPSILOD_MAX_DIMS];
+	int digits = border;
+	for (int d = dims - 1; d >= 0; d--) {
+		shift[d] = digits % 3 - 1;
+		digits /= 3;
+	}
+
+	EpsilodComponentMask mask = {0};
+	bool                 any  = false;
+	for (int d = 0; d < dims; d++)
+		any = any || shift[d] != 0;
+	if (!any)
+		return mask;
+
+	for (int c = 0; c < EPSILOD_SCALAR_COUNT; c++) {
+		bool read = true;
+		for (int d = 0; d < dims && read; d++) {
+			int offset = components.offsets[c * dims + d];
+			if (shift[d] != 0)
+				read = (offset > 0) - (offset < 0) == shift[d];
+		}
+		if (read)
+			mask.index[mask.count++] = (unsigned char)c;
+	}
+	return mask;
+}
+
+/**
+ * @brief Creates the MPI type of a cell restricted to the components of a mask.
+ * The extent of the type is the size of a whole cell, so it can be used as the cell type of Hitmap patterns.
+ * @param mask Component mask.
+ * @return Committed MPI type.
+ */
+static HitType masked_cell_type(EpsilodComponentMask mask) {
+	int displacements[EPSILOD_MAX_COMPONENTS];
+	for (int c = 0; c < mask.count; c++)
+		displacements[c] = mask.index[c];
+
+	MPI_Datatype components_type, type;
+	int          ok = MPI_Type_create_indexed_block(mask.count, 1, displacements, hit_comTranslateType(EPSILOD_SCALAR_TYPE), &components_type);
+	hit_mpiTestError(ok, "Failed creating the component type");
+	ok = MPI_Type_create_resized(components_type, 0, sizeof(EPSILOD_BASE_TYPE), &type);
+	hit_mpiTestError(ok, "Failed resizing the component type");
+	ok = MPI_Type_commit(&type);
+	hit_mpiTestError(ok, "Failed committing the component type");
+	MPI_Type_free(&components_type);
+	return type;
+}
+
+void init_border_types(EpsilodCommArgs *p_comm_args, int dims) {
+	int num_borders = epsilod_num_borders(dims);
+
+	p_comm_args->border_masks = NULL;
+	p_comm_args->border_types = malloc(sizeof(HitType) * num_borders);
+	for (int i = 0; i < num_borders; i++) {
+		p_comm_args->border_types[i] = p_comm_args->cell_type;
+	}
+	if (!epsilod_component_masks_active())
+		return;
+
+	if (components.dims != dims)
+		components_error("The dimensions of the component offsets do not match the domain");
+
+	p_comm_args->border_masks = malloc(sizeof(EpsilodComponentMask) * num_borders);
+	for (int i = 0; i < num_borders; i++) {
+		p_comm_args->border_masks[i] = border_mask(dims, i);
+		p_comm_args->border_types[i] = masked_cell_type(p_comm_args->border_masks[i]);
+	}
+}
+
+void free_border_types(EpsilodCommArgs *p_comm_args, int dims) {
+	if (p_comm_args->border_masks != NULL) {
+		for (int i = 0; i < epsilod_num_borders(dims); i++) {
+			MPI_Type_free(&p_comm_args->border_types[i]);
+		}
+	}
+	free(p_comm_args->border_masks);
+	free(p_comm_args->border_types);
+	p_comm_args->border_masks = NULL;
+	p_comm_args->border_types = NULL;
+}
+
+EpsilodComponentMask epsilod_mask_union(EpsilodComponentMask a, EpsilodComponentMask b) {
+	EpsilodComponentMask mask = {0};
+	int                  i = 0, j = 0;
+	while (i < a.count || j < b.count) {
+		if (j == b.count || (i < a.count && a.index[i] < b.index[j]))
+			mask.index[mask.count++] = a.index[i++];
+		else if (i == a.count || b.index[j] < a.index[i])
+			mask.index[mask.count++] = b.index[j++];
+		else {
+			mask.index[mask.count++] = a.index[i++];
+			j++;
+		}
+	}
+	return mask;
+}
+
+size_t epsilod_components_gather(const void *cells, size_t num_cells, EpsilodComponentMask mask, void *packed) {
+	const EPSILOD_SCALAR_TYPE *src = cells;
+	EPSILOD_SCALAR_TYPE       *dst = packed;
+	for (size_t k = 0; k < num_cells; k++)
+		for (int c = 0; c < mask.count; c++)
+			*dst++ = src[k * EPSILOD_SCALAR_COUNT + mask.index[c]];
+	return num_cells * mask.count * sizeof(EPSILOD_SCALAR_TYPE);
+}
+
+void epsilod_components_scatter(const void *packed, size_t num_cells, EpsilodComponentMask mask, void *cells) {
+	const EPSILOD_SCALAR_TYPE *src = packed;
+	EPSILOD_SCALAR_TYPE       *dst = cells;
+	for (size_t k = 0; k < num_cells; k++)
+		for (int c = 0; c < mask.count; c++)
+			dst[k * EPSILOD_SCALAR_COUNT + mask.index[c]] = *src++;
+}
@@ -0,0 +1,76 @@
+/**
+ * @file epsilod_components.h
+ * @brief Epsilod: Components of compound cells communicated in each halo
+ *
+ * @copyright This software is part of the EPSILOD project by Trasgo Group, UVa.
+ * The relevant license, warranty and copyright notice is available in the EPSILOD project repository.
+ */
+
+#ifndef _EPSILOD_COMPONENTS_H_
+#define _EPSILOD_COMPONENTS_H_
+
+#include "epsilod_structs.h"
+
+/**
+ * @brief Declares the neighbour from which the kernel reads each component of a compound cell.
+ * A component is only communicated in the halos located in the direction of its offset.
+ * E.g. in a D3Q19 lattice Boltzmann streaming step each face halo carries 5 of the 19 distributions,
+ * and the zero offset (rest) distribution is never communicated.
+ * It must be called before stencilComputation(). It is ignored if the cell type is not compound.
+ * @param num_components Number of components of the cell. It must match the count in EPSILOD_TYPE_COMPOUND_<type>.
+ * @param dims Number of dimensions of the domain.
+ * @param offsets Offsets of each component, in the order of the array dimensions.
+ * offsets[c * dims + d] is the displacement in dimension d of the neighbour read for component c.
+ */
+void epsilod_set_component_offsets(int num_components, int dims, const int *offsets);
+
+/**
+ * @brief Whether halos carry only the components declared with epsilod_set_component_offsets().
+ * @return true if component offsets have been declared for a compound cell type, false otherwise.
+ */
+bool epsilod_component_masks_active();
+
+/**
+ * @brief Builds the component masks and MPI types of the borders.
+ * Borders whose cells are communicated whole use comm_args.cell_type.
+ * Masks only depend on the border direction, so they remain valid when the layout changes.
+ * @param[inout] p_comm_args Communications related data to update. The cell type must be already set.
+ * @param dims The number of dimensions of the domain.
+ */
+void init_border_types(EpsilodCommArgs *p_comm_args, int dims);
+
+/**
+ * @brief Frees the component masks and MPI types of the borders.
+ * @param[inout] p_comm_args Communications related data to update.
+ * @param dims The number of dimensions of the domain.
+ */
+void free_border_types(EpsilodCommArgs *p_comm_args, int dims);
+
+/**
+ * @brief Union of two component masks.
+ * @param a Component mask.
+ * @param b Component mask.
+ * @return Mask with the components of \p a and \p b, in increasing order.
+ */
+EpsilodComponentMask epsilod_mask_union(EpsilodComponentMask a, EpsilodComponentMask b);
+
+/**
+ * @brief Copies the masked components of consecutive cells to a packed buffer.
+ * @param cells Source cells.
+ * @param num_cells Number of cells.
+ * @param mask Components to copy.
+ * @param packed Destination buffer of at least num_cells * mask.count scalars.
+ * @return Size of the packed data in bytes.
+ */
+size_t epsilod_components_gather(const void *cells, size_t num_cells, EpsilodComponentMask mask, void *packed);
+
+/**
+ * @brief Reverts epsilod_components_gather(). Components not in the mask are left untouched.
+ * @param packed Source buffer.
+ * @param num_cells Number of cells.
+ * @param mask Components to copy.
+ * @param cells Destination cells.
+ */
+void epsilod_components_scatter(const void *packed, size_t num_cells, EpsilodComponentMask mask, void *cells);
+
+#endif // _EPSILOD_COMPONENTS_H_
@@ -10,21 +10,64 @@
 #include "epsilod_log.h"
 
 #include <ctype.h>
+#include <limits.h>
+#include <string.h>
 
-const char *io_options[] = {"none", "array", "tile", NULL};
+const char *io_options[] = {"none", "array", "tile", "mpiio", "chunked", NULL};
+
+/**
+ * Communication settings in use. Settings read as \e auto are overwritten by epsilod_set_comm_config()
+ */
+static EpsilodCommConfig comm_config;
+
+/**
+ * Communication settings read as \e auto. @see EpsilodCommAuto
+ */
+static int comm_auto = 0;
+
+/**
+ * Partition selected for EPSILOD_PARTITION=auto. Its type is EPSILOD_PARTITION_AUTO until it is selected
+ */
+static PartitionInfo auto_partition = {.type = EPSILOD_PARTITION_AUTO, .dims = 0, .dim = -1};
+
+/**
+ * @brief Whether an environment variable is set to \e auto.
+ * @param name Name of the environment variable.
+ * @return true if the variable value is \e auto, false otherwise.
+ */
+static bool env_is_auto(const char *name) {
+	char *str = getenv(name);
+	return str != NULL && strcmp(str, "auto") == 0;
+}
 
 void epsilod_env_load() {
 	epsilod_exp_mode();
 	epsilod_log_tiles();
 	epsilod_log_threads();
 	epsilod_warmup();
+	epsilod_calibrate();
 	epsilod_align();
 	mpi_dev_aware();
 	epsilod_comm_method();
 	comms_contiguous_buffers();
+	epsilod_progress_thread();
+	epsilod_progress_core();
+	epsilod_halo_chunk_kb();
+	epsilod_skip_unchanged_halos();
+	epsilod_alb_incremental();
+	epsilod_alb_async();
+	epsilod_alb_fit_model();
+	epsilod_alb_margin();
+	epsilod_alb_load_weights();
+	epsilod_alb_node_period();
 	epsilod_read_input();
 	epsilod_write_input();
 	epsilod_write_output();
+	epsilod_chunk_kb();
+	epsilod_chunk_checksums();
+	epsilod_chunk_codec();
+	epsilod_async_output();
+	epsilod_snapshots();
 }
 
 bool epsilod_exp_mode() {
@@ -63,14 +106,30 @@ bool epsilod_warmup() {
 	return val;
 }
 
+bool epsilod_calibrate() {
+	static int val = -1;
+	if (val != -1)
+		return val;
+
+	val = hit_envNoYes("EPSILOD_CALIBRATE");
+	return val;
+}
+
+char *epsilod_weights_cache() {
+	return getenv("EPSILOD_WEIGHTS_CACHE");
+}
+
 EpsilodMemAlignMode epsilod_align() {
 	static const char *options[] = {"no", "yes", "threads", NULL};
 	static int         val       = -1;
 	if (val != -1)
-		return val;
+		return comm_config.align;
 
-	val = hit_envOptions("EPSILOD_ALIGN", options);
-	return val;
+	if (env_is_auto("EPSILOD_ALIGN"))
+		comm_auto |= EPSILOD_AUTO_ALIGN;
+	val               = (comm_auto & EPSILOD_AUTO_ALIGN) ? EPSILOD_MEM_ALIGN_NONE : hit_envOptions("EPSILOD_ALIGN", options);
+	comm_config.align = val;
+	return comm_config.align;
 }
 
 int get_partition_dim(int dims, const char *partition_str, int start) {
@@ -91,7 +150,11 @@ PartitionInfo get_partition_info(int dims) {
 		.dims = dims,
 		.dim  = -1};
 	char *partition_str = getenv("EPSILOD_PARTITION");
-	if (partition_str != NULL) {
+	if (env_is_auto("EPSILOD_PARTITION")) {
+		if (auto_partition.type != EPSILOD_PARTITION_AUTO)
+			return auto_partition;
+		info.type = EPSILOD_PARTITION_AUTO;
+	} else if (partition_str != NULL) {
 		if (strlen(partition_str) > 2) {
 			fprintf(stderr, "\nError in EPSILOD_PARTITION enviroment string: More than two characters. String: %s\n\n", partition_str);
 			MPI_Abort(MPI_COMM_WORLD, MPI_ERR_OTHER);
@@ -112,6 +175,14 @@ PartitionInfo get_partition_info(int dims) {
 				info.dims = 1;
 				info.dim  = get_partition_dim(dims, partition_str, 0);
 				break;
+			/* Weighted partition on a multidimensional grid topology */
+			case 'g':
+				info.type = EPSILOD_PARTITION_WEIGHTED_GRID;
+				// Number of dimensiones in the partition, default all
+				if (partition_str[1] != '\0') {
+					info.dims = get_partition_dim(dims, partition_str, 1);
+				}
+				break;
 			/* Regular partition in a single dimension */
 			case 's':
 				info.type = EPSILOD_PARTITION_SINGLE_DIM;
@@ -120,6 +191,11 @@ PartitionInfo get_partition_info(int dims) {
 				break;
 			/* Regular partition in all dimension except one */
 			case 'n':
+				if (dims < 2) {
+					fprintf(stderr, "\nError in EPSILOD_PARTITION enviroment string: Partition n requires at least two dimensions. String: %s\n\n", partition_str);
+					MPI_Abort(MPI_COMM_WORLD, MPI_ERR_OTHER);
+					exit(EXIT_FAILURE);
+				}
 				info.type = EPSILOD_PARTITION_NOT_DIM;
 				info.dims = dims - 1;
 				info.dim  = get_partition_dim(dims, partition_str, 0);
@@ -133,25 +209,38 @@ PartitionInfo get_partition_info(int dims) {
 	return info;
 }
 
+void epsilod_set_auto_partition(PartitionInfo info) {
+	auto_partition = info;
+}
+
 bool mpi_dev_aware() {
 	// Read env: use CUDA/HIP MPI aware
 	static int mpi_dev_aware = -1;
-	if (mpi_dev_aware != -1) return mpi_dev_aware;
+	if (mpi_dev_aware != -1) return comm_config.dev_aware;
 
-	mpi_dev_aware = hit_envNoYes("EPSILOD_MPI_DEV_AWARE");
-	print_once("Epsilod Using Device-Aware MPI: %c\n", (mpi_dev_aware) ? 'y' : 'n');
-	if (mpi_dev_aware)
+	if (env_is_auto("EPSILOD_MPI_DEV_AWARE")) {
+		comm_auto |= EPSILOD_AUTO_DEV_AWARE;
+		print_once("Epsilod Using Device-Aware MPI: auto\n");
+		mpi_dev_aware = false;
+	} else {
+		mpi_dev_aware = hit_envNoYes("EPSILOD_MPI_DEV_AWARE");
+		print_once("Epsilod Using Device-Aware MPI: %c\n", (mpi_dev_aware) ? 'y' : 'n');
+	}
+	if (mpi_dev_aware || (comm_auto & EPSILOD_AUTO_DEV_AWARE))
 		print_once(BOLD_TEXT "NOTE:" REGULAR_TEXT "Device-Aware MPI only works if it is suported and activated in the MPI layer\n");
-	return mpi_dev_aware;
+	comm_config.dev_aware = mpi_dev_aware;
+	return comm_config.dev_aware;
 }
 
 EpsilodCommMethod epsilod_comm_method() {
 	static int val = -1;
 	if (val != -1)
-		return val;
+		return comm_config.method;
 
-	const char *options[] = {"host_waitany", "host_waitany_recvfirst", "host_waitall"};
-	val                   = hit_envOptions("EPSILOD_COMM_METHOD", options);
+	const char *options[] = {"host_waitany", "host_waitany_recvfirst", "host_waitall", "host_early", NULL};
+	if (env_is_auto("EPSILOD_COMM_METHOD"))
+		comm_auto |= EPSILOD_AUTO_COMM_METHOD;
+	val = (comm_auto & EPSILOD_AUTO_COMM_METHOD) ? 0 : hit_envOptions("EPSILOD_COMM_METHOD", options);
 	switch (val) {
 		case 0:
 			val = HOST_WAITANY;
@@ -162,16 +251,201 @@ EpsilodCommMethod epsilod_comm_method() {
 		case 2:
 			val = HOST_WAITALL;
 			break;
+		case 3:
+			val = HOST_EARLY_RECV;
+			break;
 	}
-	return val;
+	comm_config.method = val;
+	return comm_config.method;
 }
 
 bool comms_contiguous_buffers() {
+	static int val = -1;
+	if (val != -1)
+		return comm_config.contiguous;
+
+	if (env_is_auto("EPSILOD_COMMS_CONTIGUOUS_BUFFERS"))
+		comm_auto |= EPSILOD_AUTO_CONTIGUOUS;
+	val                    = (comm_auto & EPSILOD_AUTO_CONTIGUOUS) ? true : hit_envYesNo("EPSILOD_COMMS_CONTIGUOUS_BUFFERS");
+	comm_config.contiguous = val;
+	return comm_config.contiguous;
+}
+
+int epsilod_comm_auto() {
+	epsilod_align();
+	mpi_dev_aware();
+	epsilod_comm_method();
+	comms_contiguous_buffers();
+	return comm_auto;
+}
+
+EpsilodCommConfig epsilod_comm_config() {
+	epsilod_comm_auto();
+	return comm_config;
+}
+
+void epsilod_set_comm_config(EpsilodCommConfig config) {
+	int fields = epsilod_comm_auto();
+	if (fields & EPSILOD_AUTO_COMM_METHOD)
+		comm_config.method = config.method;
+	if (fields & EPSILOD_AUTO_CONTIGUOUS)
+		comm_config.contiguous = config.contiguous;
+	if (fields & EPSILOD_AUTO_ALIGN)
+		comm_config.align = config.align;
+	if (fields & EPSILOD_AUTO_DEV_AWARE)
+		comm_config.dev_aware = config.dev_aware;
+}
+
+bool epsilod_progress_thread() {
 	static int val = -1;
 	if (val != -1)
 		return val;
 
-	val = hit_envYesNo("EPSILOD_COMMS_CONTIGUOUS_BUFFERS");
+	val = hit_envNoYes("EPSILOD_PROGRESS_THREAD");
+	return val;
+}
+
+int epsilod_progress_core() {
+	static int val = -2;
+	if (val != -2)
+		return val;
+
+	val            = -1;
+	char *core_str = getenv("EPSILOD_PROGRESS_CORE");
+	if (core_str != NULL) {
+		char *err;
+		val = (int)strtol(core_str, &err, 10);
+		if (err == core_str || *err != '\0' || val < 0) {
+			fprintf(stderr, "\nError in EPSILOD_PROGRESS_CORE enviroment string: A non-negative core number is expected. String: %s\n\n", core_str);
+			MPI_Abort(MPI_COMM_WORLD, MPI_ERR_OTHER);
+			exit(EXIT_FAILURE);
+		}
+	}
+	return val;
+}
+
+int epsilod_halo_chunk_kb() {
+	static int val = -1;
+	if (val != -1)
+		return val;
+
+	val             = 0;
+	char *chunk_str = getenv("EPSILOD_HALO_CHUNK_KB");
+	if (chunk_str != NULL) {
+		char *err;
+		val = (int)strtol(chunk_str, &err, 10);
+		if (err == chunk_str || *err != '\0' || val < 0) {
+			fprintf(stderr, "\nError in EPSILOD_HALO_CHUNK_KB enviroment string: A non-negative size in KiB is expected. String: %s\n\n", chunk_str);
+			MPI_Abort(MPI_COMM_WORLD, MPI_ERR_OTHER);
+			exit(EXIT_FAILURE);
+		}
+	}
+	return val;
+}
+
+bool epsilod_skip_unchanged_halos() {
+	static int val = -1;
+	if (val != -1)
+		return val;
+
+	val = hit_envNoYes("EPSILOD_SKIP_UNCHANGED_HALOS");
+	return val;
+}
+
+bool epsilod_node_mapping() {
+	static int val = -1;
+	if (val != -1)
+		return val;
+
+	val = hit_envNoYes("EPSILOD_NODE_MAPPING");
+	return val;
+}
+
+bool epsilod_alb_incremental() {
+	static int val = -1;
+	if (val != -1)
+		return val;
+
+	const char *options[] = {"full", "incremental", NULL};
+	val                   = hit_envOptions("EPSILOD_ALB_MIGRATION", options);
+	return val;
+}
+
+bool epsilod_alb_async() {
+	static int val = -1;
+	if (val != -1)
+		return val;
+
+	val = hit_envNoYes("EPSILOD_ALB_ASYNC");
+	return val;
+}
+
+bool epsilod_alb_fit_model() {
+	static int val = -1;
+	if (val != -1)
+		return val;
+
+	const char *options[] = {"linear", "fit", NULL};
+	val                   = hit_envOptions("EPSILOD_ALB_MODEL", options);
+	return val;
+}
+
+double epsilod_alb_margin() {
+	static double val = -1;
+	if (val != -1)
+		return val;
+
+	val              = 0.1;
+	char *margin_str = getenv("EPSILOD_ALB_MARGIN");
+	if (margin_str != NULL) {
+		char *err;
+		val = strtod(margin_str, &err);
+		if (err == margin_str || *err != '\0' || val < 0) {
+			fprintf(stderr, "\nError in EPSILOD_ALB_MARGIN enviroment string: A non-negative ratio is expected. String: %s\n\n", margin_str);
+			MPI_Abort(MPI_COMM_WORLD, MPI_ERR_OTHER);
+			exit(EXIT_FAILURE);
+		}
+	}
+	return val;
+}
+
+EpsilodIterTimes epsilod_alb_load_weights() {
+	static bool             loaded = false;
+	static EpsilodIterTimes val;
+	if (loaded)
+		return val;
+
+	loaded         = true;
+	val            = (EpsilodIterTimes){1, 1, 1, 0};
+	char *load_str = getenv("EPSILOD_ALB_LOAD");
+	if (load_str != NULL) {
+		char end;
+		int  num = sscanf(load_str, "%lf,%lf,%lf,%lf%c", &val.compute, &val.pack, &val.transfer, &val.wait, &end);
+		if (num != 4 || val.compute < 0 || val.pack < 0 || val.transfer < 0 || val.wait < 0) {
+			fprintf(stderr, "\nError in EPSILOD_ALB_LOAD enviroment string: Four non-negative weights separated by commas are expected. String: %s\n\n", load_str);
+			MPI_Abort(MPI_COMM_WORLD, MPI_ERR_OTHER);
+			exit(EXIT_FAILURE);
+		}
+	}
+	return val;
+}
+
+int epsilod_alb_node_period() {
+	static int val = -1;
+	if (val != -1)
+		return val;
+
+	val              = 0;
+	char *period_str = getenv("EPSILOD_ALB_NODE_PERIOD");
+	if (period_str != NULL) {
+		char *err;
+		val = (int)strtol(period_str, &err, 10);
+		if (err == period_str || *err != '\0' || val < 0) {
+			fprintf(stderr, "\nError in EPSILOD_ALB_NODE_PERIOD enviroment string: A non-negative number of iterations is expected. String: %s\n\n", period_str);
+			MPI_Abort(MPI_COMM_WORLD, MPI_ERR_OTHER);
+			exit(EXIT_FAILURE);
+		}
+	}
 	return val;
 }
 
@@ -201,3 +475,154 @@ IOTileMode epsilod_write_output() {
 	val = hit_envOptions("EPSILOD_WRITE_OUTPUT", io_options);
 	return val;
 }
+
+char *epsilod_input_file() {
+	char *name = getenv("EPSILOD_INPUT_FILE");
+	return (name != NULL) ? name : "Matrix.in";
+}
+
+char *epsilod_input_copy_file() {
+	char *name = getenv("EPSILOD_INPUT_COPY_FILE");
+	return (name != NULL) ? name : "Matrix.copy";
+}
+
+char *epsilod_output_file() {
+	char *name = getenv("EPSILOD_OUTPUT_FILE");
+	return (name != NULL) ? name : "Matrix.out";
+}
+
+char *epsilod_mpiio_hints() {
+	return getenv("EPSILOD_MPIIO_HINTS");
+}
+
+int epsilod_chunk_kb() {
+	static int val = -1;
+	if (val != -1)
+		return val;
+
+	val          = 1024;
+	char *kb_str = getenv("EPSILOD_CHUNK_KB");
+	if (kb_str != NULL) {
+		char *err;
+		val = (int)strtol(kb_str, &err, 10);
+		if (err == kb_str || *err != '\0' || val <= 0) {
+			fprintf(stderr, "\nError in EPSILOD_CHUNK_KB enviroment string: A positive size in KiB is expected. String: %s\n\n", kb_str);
+			MPI_Abort(MPI_COMM_WORLD, MPI_ERR_OTHER);
+			exit(EXIT_FAILURE);
+		}
+	}
+	return val;
+}
+
+bool epsilod_chunk_checksums() {
+	static int val = -1;
+	if (val != -1)
+		return val;
+
+	val = hit_envNoYes("EPSILOD_CHUNK_CHECKSUMS");
+	return val;
+}
+
+EpsilodChunkCodec epsilod_chunk_codec() {
+	static int val = -1;
+	if (val != -1)
+		return val;
+
+	const char *options[] = {"none", "lz4", "zstd", NULL};
+	val                   = hit_envOptions("EPSILOD_CHUNK_CODEC", options);
+	#ifndef EPSILOD_HAVE_LZ4
+	if (val == EPSILOD_CHUNK_CODEC_LZ4) {
+		fprintf(stderr, "\nError in EPSILOD_CHUNK_CODEC enviroment string: Codec lz4 requires building with EPSILOD_WITH_LZ4=ON\n\n");
+		MPI_Abort(MPI_COMM_WORLD, MPI_ERR_OTHER);
+		exit(EXIT_FAILURE);
+	}
+	#endif // EPSILOD_HAVE_LZ4
+	#ifndef EPSILOD_HAVE_ZSTD
+	if (val == EPSILOD_CHUNK_CODEC_ZSTD) {
+		fprintf(stderr, "\nError in EPSILOD_CHUNK_CODEC enviroment string: Codec zstd requires building with EPSILOD_WITH_ZSTD=ON\n\n");
+		MPI_Abort(MPI_COMM_WORLD, MPI_ERR_OTHER);
+		exit(EXIT_FAILURE);
+	}
+	#endif // EPSILOD_HAVE_ZSTD
+	return val;
+}
+
+bool epsilod_async_output() {
+	static int val = -1;
+	if (val != -1)
+		return val;
+
+	val = hit_envNoYes("EPSILOD_ASYNC_OUTPUT");
+	return val;
+}
+
+int epsilod_snapshot_every() {
+	static int val = -1;
+	if (val != -1)
+		return val;
+
+	val             = 0;
+	char *every_str = getenv("EPSILOD_SNAPSHOT_EVERY");
+	if (every_str != NULL) {
+		char *err;
+		val = (int)strtol(every_str, &err, 10);
+		if (err == every_str || *err != '\0' || val < 0) {
+			fprintf(stderr, "\nError in EPSILOD_SNAPSHOT_EVERY enviroment string: A non-negative number of iterations is expected. String: %s\n\n", every_str);
+			MPI_Abort(MPI_COMM_WORLD, MPI_ERR_OTHER);
+			exit(EXIT_FAILURE);
+		}
+	}
+	return val;
+}
+
+/**
+ * @brief Get the iterations listed in EPSILOD_SNAPSHOT_AT.
+ * @param[out] iterations The iterations, NULL if there are none.
+ * @return The number of iterations.
+ */
+static int snapshot_list(const int **iterations) {
+	static int  count = -1;
+	static int *list  = NULL;
+	if (count == -1) {
+		count          = 0;
+		char *list_str = getenv("EPSILOD_SNAPSHOT_AT");
+		for (char *pos = list_str; pos != NULL && *pos != '\0'; count++) {
+			char *err;
+			long  iteration = strtol(pos, &err, 10);
+			if (err == pos || (*err != ',' && *err != '\0') || iteration <= 0 || iteration > INT_MAX) {
+				fprintf(stderr, "\nError in EPSILOD_SNAPSHOT_AT enviroment string: Positive iterations separated by commas are expected. String: %s\n\n", list_str);
+				MPI_Abort(MPI_COMM_WORLD, MPI_ERR_OTHER);
+				exit(EXIT_FAILURE);
+			}
+			list        = realloc(list, sizeof(int) * (count + 1));
+			list[count] = (int)iteration;
+			pos         = (*err == ',') ? err + 1 : err;
+		}
+	}
+	*iterations = list;
+	return count;
+}
+
+bool epsilod_snapshots() {
+	const int *iterations;
+	return epsilod_snapshot_every() > 0 || snapshot_list(&iterations) > 0;
+}
+
+bool epsilod_snapshot_scheduled(int iteration) {
+	int every = epsilod_snapshot_every();
+	if (every > 0 && iteration % every == 0)
+		return true;
+
+	const int *iterations;
+	int        count = snapshot_list(&iterations);
+	for (int i = 0; i < count; i++) {
+		if (iterations[i] == iteration)
+			return true;
+	}
+	return false;
+}
+
+char *epsilod_snapshot_file() {
+	char *name = getenv("EPSILOD_SNAPSHOT_FILE");
+	return (name != NULL) ? name : "Snapshot";
+}
@@ -47,11 +47,29 @@ bool epsilod_log_threads();
  */
 bool epsilod_warmup();
 
+/**
+ * @brief Whether weighted partitions are calibrated at startup.
+ * Set with the EPSILOD_CALIBRATE enviroment variable. A few iterations are timed on the initial partition,
+ * before the file and communication settings, and the partition is rebuilt with weights proportional to the
+ * measured throughput of each process.
+ * Skipped when the weights cache already has weights for the run. @see epsilod_weights()
+ * @return true if the partition is calibrated, false otherwise.
+ */
+bool epsilod_calibrate();
+
+/**
+ * @brief Path of the file that keeps the weights learned by calibration or ALB.
+ * Set with the EPSILOD_WEIGHTS_CACHE enviroment variable.
+ * @return The path, or NULL if weights are not cached.
+ */
+char *epsilod_weights_cache();
+
 /**
  * @brief Get EPSILOD's memory alignment mode.
  * The mode is obtained from the EPSILOD_ALIGN environment variable.
- * The posible values are: "no", "yes" and "threads". The default value is "no".
+ * The posible values are: "no", "yes", "threads" and "auto". The default value is "no".
  * See EpsilodMemAlignMode for the corresponding memory alignment modes.
+ * With "auto", the mode is selected during the warm-up. @see epsilod_comm_auto()
  * @return A EpsilodMemAlignMode enum value.
  */
 EpsilodMemAlignMode epsilod_align();
@@ -63,8 +81,16 @@ EpsilodMemAlignMode epsilod_align();
  */
 PartitionInfo get_partition_info(int dims);
 
+/**
+ * @brief Sets the partition used when EPSILOD_PARTITION is "auto".
+ * Until it is called, get_partition_info() returns the EPSILOD_PARTITION_AUTO type.
+ * @param info Selected partition. @see select_auto_partition()
+ */
+void epsilod_set_auto_partition(PartitionInfo info);
+
 /**
  * @brief Whether EPSILOD should use device-aware MPI for communications.
+ * Set with the EPSILOD_MPI_DEV_AWARE environment variable: "y", "n" or "auto".
  * @return true if device-aware MPI should be used, false otherwise.
  */
 bool mpi_dev_aware();
@@ -72,17 +98,134 @@ bool mpi_dev_aware();
 /**
  * @brief Get the communication method to be used.
  * This method can be specified by the EPSILOD_COMM_METHOD enviroment variable.
- * Defaults to \e HOST_WAITANY
+ * Defaults to \e HOST_WAITANY. With "auto", the method is selected during the warm-up.
  * @return communication method
  */
 EpsilodCommMethod epsilod_comm_method();
 
 /**
  * @brief Whether EPSILOD should use separate contiguous buffers for communications.
+ * Set with the EPSILOD_COMMS_CONTIGUOUS_BUFFERS environment variable: "y", "n" or "auto".
  * @return true if separate buffers should be used, false otherwise.
  */
 bool comms_contiguous_buffers();
 
+/**
+ * @brief Get the communication settings to be selected at runtime.
+ * A setting is selected at runtime when its environment variable is "auto".
+ * Until epsilod_set_comm_config() is called, these settings take their default values.
+ * @return Bitwise OR of EpsilodCommAuto flags, 0 if every setting is fixed.
+ */
+int epsilod_comm_auto();
+
+/**
+ * @brief Get the communication settings in use.
+ * @return Values returned by epsilod_comm_method(), comms_contiguous_buffers(), epsilod_align() and mpi_dev_aware().
+ */
+EpsilodCommConfig epsilod_comm_config();
+
+/**
+ * @brief Changes the communication settings selected at runtime.
+ * Only the settings flagged by epsilod_comm_auto() are changed. Tiles and communication patterns
+ * depend on these settings: they must be freed before, and created again after changing them.
+ * @param config New communication settings.
+ */
+void epsilod_set_comm_config(EpsilodCommConfig config);
+
+/**
+ * @brief Whether EPSILOD should drive MPI progress from a helper thread while kernels run.
+ * Only used by the \e HOST_EARLY_RECV communication method.
+ * @return true if a progress thread should be started, false otherwise.
+ */
+bool epsilod_progress_thread();
+
+/**
+ * @brief Get the core where the MPI progress thread is pinned.
+ * This core can be specified by the EPSILOD_PROGRESS_CORE enviroment variable.
+ * @return The core number, or -1 to choose the last core of the process affinity mask.
+ */
+int epsilod_progress_core();
+
+/**
+ * @brief Get the size of the chunks in which large halos are split for pipelined host staging.
+ * This size can be specified by the EPSILOD_HALO_CHUNK_KB enviroment variable.
+ * The device-to-host copy, the MPI transfer and the host-to-device copy of consecutive chunks overlap.
+ * @return The chunk size in KiB, or 0 if halos are not split.
+ */
+int epsilod_halo_chunk_kb();
+
+/**
+ * @brief Whether halos equal to the previous ones sent from the same tiles are replaced by empty messages.
+ * The receiver keeps the contents of its buffer, that received the same halo in the previous exchange.
+ * Set with the EPSILOD_SKIP_UNCHANGED_HALOS enviroment variable.
+ * @return true if unchanged halos are skipped, false otherwise.
+ */
+bool epsilod_skip_unchanged_halos();
+
+/**
+ * @brief Whether the blocks of regular grid partitions are mapped to processes by node and socket.
+ * Set with the EPSILOD_NODE_MAPPING enviroment variable. @see epsilod_map_topology()
+ * @return true if the node aware mapping is used, false otherwise.
+ */
+bool epsilod_node_mapping();
+
+/**
+ * @brief Whether ALB migrates only the regions that change owner, instead of redistributing the whole domain.
+ * Set with the EPSILOD_ALB_MIGRATION enviroment variable: "full" (default) or "incremental".
+ * Incremental migrations copy the retained cells in the device and only move through the host the
+ * cells exchanged with the processes whose tiles overlap the old or new local tile.
+ * @return true if migrations are incremental, false otherwise.
+ */
+bool epsilod_alb_incremental();
+
+/**
+ * @brief Whether ALB prepares the new partition while the current one keeps iterating.
+ * Set with the EPSILOD_ALB_ASYNC enviroment variable. The new tiles and communication patterns are built
+ * while the kernels of the next iteration run, and the partition is switched at the end of that iteration
+ * with an incremental migration. @see epsilod_alb_incremental()
+ * @return true if redistributions are asynchronous, false otherwise.
+ */
+bool epsilod_alb_async();
+
+/**
+ * @brief Whether ALB computes the weights with a throughput model fitted for each process.
+ * Set with the EPSILOD_ALB_MODEL enviroment variable: "linear" (default) or "fit".
+ * The linear model takes the load as proportional to the local size. The fitted model adds a fixed
+ * time, estimated from the (local size, load) samples of the previous partitions, and the weights
+ * are the sizes that equalise the predicted times.
+ * @return true if the fitted model is used, false otherwise.
+ */
+bool epsilod_alb_fit_model();
+
+/**
+ * @brief Get the noise margin of the CostBenefit ALB heuristic.
+ * This ratio can be specified by the EPSILOD_ALB_MARGIN enviroment variable.
+ * Imbalances below this ratio of the average load are taken as noise, and the redistribution
+ * cost is increased by this ratio before comparing it with the expected gain.
+ * @return The margin, 0.1 by default.
+ */
+double epsilod_alb_margin();
+
+/**
+ * @brief Get the weights of the parts of the iteration time in the load balanced by ALB.
+ * Set with the EPSILOD_ALB_LOAD enviroment variable as "<compute>,<pack>,<transfer>,<wait>".
+ * The default, "1,1,1,0", leaves out the MPI waits: they mostly measure how long a process waits for
+ * slower neighbours, so they are larger in the faster processes. "1,0,0,0" balances the kernel time only.
+ * Heuristics with a \e load function combine the parts themselves.
+ * @return The weights of each part, in the fields of the iteration times.
+ */
+EpsilodIterTimes epsilod_alb_load_weights();
+
+/**
+ * @brief Get the period, in iterations, of the intra-node ALB rounds.
+ * This period can be specified by the EPSILOD_ALB_NODE_PERIOD enviroment variable.
+ * Intra-node rounds gather the times of the processes of a node only, and move rows between them keeping
+ * the range of the node, so the other nodes do not take part. The heuristic still drives the global rounds,
+ * which rebalance the nodes. They require w partitions with the processes of each node in consecutive ranks.
+ * @return The period, 0 (default) if there are no intra-node rounds.
+ */
+int epsilod_alb_node_period();
+
 /**
  * @brief Whether EPSILOD should read input from a file.
  * @see IOTileMode
@@ -104,4 +247,99 @@ IOTileMode epsilod_write_input();
  */
 IOTileMode epsilod_write_output();
 
+/**
+ * @brief Get the name of the file read when EPSILOD_READ_INPUT is set.
+ * It can be specified by the EPSILOD_INPUT_FILE enviroment variable.
+ * @return The file name, "Matrix.in" by default.
+ */
+char *epsilod_input_file();
+
+/**
+ * @brief Get the name of the file written when EPSILOD_WRITE_INPUT is set.
+ * It can be specified by the EPSILOD_INPUT_COPY_FILE enviroment variable.
+ * @return The file name, "Matrix.copy" by default.
+ */
+char *epsilod_input_copy_file();
+
+/**
+ * @brief Get the name of the file written when EPSILOD_WRITE_OUTPUT is set.
+ * It can be specified by the EPSILOD_OUTPUT_FILE enviroment variable.
+ * @return The file name, "Matrix.out" by default.
+ */
+char *epsilod_output_file();
+
+/**
+ * @brief Get the hints of the MPI-IO files, as a list of "<key>=<value>" separated by commas.
+ * They can be specified by the EPSILOD_MPIIO_HINTS enviroment variable, e.g. to tune collective buffering
+ * with "romio_cb_write=enable,cb_buffer_size=16777216,cb_nodes=4".
+ * @return The hints, NULL if there are none.
+ */
+char *epsilod_mpiio_hints();
+
+/**
+ * @brief Get the approximate size of the chunks written in the chunked file mode.
+ * Chunks have the same number of cells in every dimension, up to the size of the domain.
+ * It can be specified by the EPSILOD_CHUNK_KB enviroment variable.
+ * @return The size in KiB, 1024 by default.
+ */
+int epsilod_chunk_kb();
+
+/**
+ * @brief Whether the files written in the chunked file mode store a checksum per chunk.
+ * The checksums of the chunks read are verified whenever the file has them.
+ * It can be activated by the EPSILOD_CHUNK_CHECKSUMS enviroment variable.
+ * @return true if checksums are written, false otherwise.
+ */
+bool epsilod_chunk_checksums();
+
+/**
+ * @brief Get the compressor of the files written in the chunked file mode.
+ * Currently available options are:
+ * 	\e none, chunks are stored as they are
+ * 	\e lz4, byte shuffle followed by LZ4 compression. Requires building with EPSILOD_WITH_LZ4
+ * 	\e zstd, byte shuffle followed by zstd compression. Requires building with EPSILOD_WITH_ZSTD
+ * It can be specified by the EPSILOD_CHUNK_CODEC enviroment variable.
+ * Compressed files are read with the codec stored in their header.
+ * @return The compressor, EPSILOD_CHUNK_CODEC_NONE by default.
+ */
+EpsilodChunkCodec epsilod_chunk_codec();
+
+/**
+ * @brief Whether the final output is written by a background thread. @see epsilod_output_start()
+ * It can be activated by the EPSILOD_ASYNC_OUTPUT enviroment variable.
+ * It only applies to the default output function in the mpiio or chunked mode.
+ * @return true if the output is asynchronous, false otherwise.
+ */
+bool epsilod_async_output();
+
+/**
+ * @brief Get the period of the snapshots of the domain, in iterations.
+ * It can be specified by the EPSILOD_SNAPSHOT_EVERY enviroment variable.
+ * @return The period, 0 by default: no periodic snapshots.
+ */
+int epsilod_snapshot_every();
+
+/**
+ * @brief Whether snapshots of the domain are taken during the computation.
+ * They are scheduled with the EPSILOD_SNAPSHOT_EVERY and EPSILOD_SNAPSHOT_AT enviroment variables.
+ * @return true if some snapshot is scheduled, false otherwise.
+ */
+bool epsilod_snapshots();
+
+/**
+ * @brief Whether a snapshot is taken after an iteration.
+ * Snapshots are taken every EPSILOD_SNAPSHOT_EVERY iterations, and after the iterations listed, separated by
+ * commas, in the EPSILOD_SNAPSHOT_AT enviroment variable.
+ * @param iteration Number of iterations computed, starting at 1.
+ * @return true if a snapshot is scheduled, false otherwise.
+ */
+bool epsilod_snapshot_scheduled(int iteration);
+
+/**
+ * @brief Get the prefix of the snapshot files, which are numbered with the iteration.
+ * It can be specified by the EPSILOD_SNAPSHOT_FILE enviroment variable.
+ * @return The prefix, "Snapshot" by default.
+ */
+char *epsilod_snapshot_file();
+
 #endif
@@ -0,0 +1,171 @@
+/**
+ * @file epsilod_grid.c
+ * @brief Epsilod: Weighted partitions on a multidimensional grid of processes
+ *
+ * @copyright This software is part of the EPSILOD project by Trasgo Group, UVa.
+ * The relevant license, warranty and copyright notice is available in the EPSILOD project repository.
+ */
+
+#include "epsilod_grid.h"
+#include "epsilod_mask.h"
+#include "epsilod_log.h"
+
+/**
+ * Grid of the current layout
+ */
+static EpsilodGrid current_grid;
+
+/**
+ * Active cells in each index of the partitioned dimensions, NULL without activity mask.
+ * The distributed shape does not change, so they are counted once.
+ */
+static double *active_counts[EPSILOD_MAX_DIMS];
+
+EpsilodGrid *epsilod_grid() {
+	return &current_grid;
+}
+
+int epsilod_grid_num_procs(EpsilodGrid grid) {
+	int num_procs = 1;
+	for (int d = 0; d < grid.dims; d++)
+		num_procs *= grid.card[d];
+	return num_procs;
+}
+
+HitRanks epsilod_grid_ranks(EpsilodGrid grid, int proc) {
+	HitRanks ranks = HIT_RANKS_NULL;
+	for (int d = 0; d < hit_shapeDims(grid.shape); d++)
+		ranks.rank[d] = 0;
+	for (int d = grid.dims - 1; d >= 0; d--) {
+		ranks.rank[d] = proc % grid.card[d];
+		proc /= grid.card[d];
+	}
+	return ranks;
+}
+
+HitShape epsilod_grid_shape(EpsilodGrid grid, HitRanks ranks) {
+	HitShape shp = grid.shape;
+	for (int d = 0; d < grid.dims; d++) {
+		int slab             = ranks.rank[d];
+		hit_shapeSig(shp, d) = hit_sig(grid.bounds[d][slab], grid.bounds[d][slab + 1] - 1, 1);
+	}
+	return shp;
+}
+
+/**
+ * @brief First index where the accumulated work reaches a target.
+ * @param prefix Work accumulated before each index. Size \p size + 1.
+ * @param size Number of indexes.
+ * @param target Target work.
+ * @return The index whose accumulated work is closest to \p target.
+ */
+static HitInd work_cut(const double *prefix, HitInd size, double target) {
+	HitInd low = 0, high = size;
+	while (low < high) {
+		HitInd mid = (low + high) / 2;
+		if (prefix[mid] < target)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	if (low > 0 && target - prefix[low - 1] < prefix[low] - target)
+		low--;
+	return low;
+}
+
+/**
+ * @brief Splits a dimension in slabs with work proportional to their weights.
+ * @param begin First index of the dimension.
+ * @param size Number of indexes of the dimension.
+ * @param card Number of slabs.
+ * @param slab_weights Weight of each slab.
+ * @param index_work Work of each index of the dimension, or NULL if every index has the same work.
+ * @param[out] bounds First index of each slab, followed by one past the end of the last one. Size \p card + 1.
+ */
+static void weighted_bounds(HitInd begin, HitInd size, int card, const double *slab_weights, const double *index_work, HitInd *bounds) {
+	double total = 0;
+	for (int k = 0; k < card; k++)
+		total += slab_weights[k];
+
+	// Work accumulated before each index
+	double *prefix = NULL;
+	if (index_work != NULL) {
+		prefix    = malloc(sizeof(double) * (size + 1));
+		prefix[0] = 0;
+		for (HitInd i = 0; i < size; i++)
+			prefix[i + 1] = prefix[i] + index_work[i];
+	}
+
+	double acum = 0;
+	HitInd cut  = 0;
+	for (int k = 0; k < card; k++) {
+		HitInd next;
+		if (total <= 0)
+			next = size * k / card;
+		else if (prefix != NULL)
+			next = work_cut(prefix, size, prefix[size] * acum / total);
+		else
+			next = (HitInd)(size * acum / total + 0.5);
+		// Masked slabs keep at least one index
+		if (prefix != NULL && k > 0 && next <= cut) next = cut + 1;
+		if (prefix != NULL && next > size - (card - k)) next = size - (card - k);
+		cut       = next;
+		bounds[k] = begin + cut;
+		acum += slab_weights[k];
+	}
+	bounds[card] = begin + size;
+	free(prefix);
+
+	for (int k = 0; k < card; k++) {
+		if (bounds[k + 1] <= bounds[k]) {
+			fprintf(stderr, "\nError: Not enough data after weighted grid partition, empty block of processes: %d\n\n", k);
+			MPI_Abort(MPI_COMM_WORLD, MPI_ERR_TOPOLOGY);
+			exit(EXIT_FAILURE);
+		}
+	}
+}
+
+HitLayout epsilod_grid_layout(HitTopology topo, HitShape shp_inner, HitWeights weights, EpsilodGrid *p_grid) {
+	EpsilodGrid grid = {0};
+	grid.dims        = hit_topDims(topo);
+	grid.shape       = shp_inner;
+	for (int d = 0; d < grid.dims; d++)
+		grid.card[d] = hit_topDimCard(topo, d);
+
+	// Slab weights: sum of the weights of the processes with the same coordinate in a dimension
+	int num_procs = epsilod_grid_num_procs(grid);
+	for (int d = 0; d < grid.dims; d++) {
+		double slab_weights[grid.card[d]];
+		for (int k = 0; k < grid.card[d]; k++)
+			slab_weights[k] = 0;
+		for (int p = 0; p < num_procs; p++) {
+			double weight = (p < weights.num_procs) ? weights.ratios[p] : 1.0;
+			slab_weights[epsilod_grid_ranks(grid, p).rank[d]] += weight;
+		}
+
+		// Masked domains balance the active cells
+		if (epsilod_mask_set() && active_counts[d] == NULL) {
+			active_counts[d] = malloc(sizeof(double) * hit_shapeSigCard(shp_inner, d));
+			epsilod_mask_count(shp_inner, d, active_counts[d]);
+		}
+
+		grid.bounds[d] = malloc(sizeof(HitInd) * (grid.card[d] + 1));
+		weighted_bounds(hit_shapeSig(shp_inner, d).begin, hit_shapeSigCard(shp_inner, d), grid.card[d], slab_weights, active_counts[d], grid.bounds[d]);
+	}
+
+	// Regular blocks provide the topology, the active processes and the neighbours
+	HitLayout lay = hit_layout_freeTopo(plug_layBlocks, topo, shp_inner);
+	if (hit_layImActive(lay))
+		lay.shape = epsilod_grid_shape(grid, lay.topo.self);
+
+	*p_grid = grid;
+	return lay;
+}
+
+void epsilod_grid_free(EpsilodGrid *p_grid) {
+	for (int d = 0; d < p_grid->dims; d++) {
+		free(p_grid->bounds[d]);
+		p_grid->bounds[d] = NULL;
+	}
+	p_grid->dims = 0;
+}
@@ -0,0 +1,74 @@
+/**
+ * @file epsilod_grid.h
+ * @brief Epsilod: Weighted partitions on a multidimensional grid of processes
+ *
+ * @copyright This software is part of the EPSILOD project by Trasgo Group, UVa.
+ * The relevant license, warranty and copyright notice is available in the EPSILOD project repository.
+ */
+
+#ifndef _EPSILOD_GRID_H_
+#define _EPSILOD_GRID_H_
+
+#include "epsilod_structs.h"
+
+/**
+ * Weighted block boundaries of a grid partition.
+ * Each partitioned dimension is split in slabs, one per process coordinate in that dimension.
+ * The size of a slab is proportional to the sum of the weights of the processes in it.
+ * Blocks of neighbouring processes stay aligned, so neighbours are the same as in regular grids.
+ */
+typedef struct EpsilodGrid {
+	int      dims;                     /**< Number of partitioned dimensions */
+	int      card[EPSILOD_MAX_DIMS];   /**< Number of processes in each partitioned dimension */
+	HitInd  *bounds[EPSILOD_MAX_DIMS]; /**< First index of each slab, followed by one past the end of the last one. Size card[d]+1 */
+	HitShape shape;                    /**< Shape distributed by the grid */
+} EpsilodGrid;
+
+/**
+ * @brief Grid of the current weighted grid partition.
+ * @return Pointer to the grid. Its dims field is 0 if the partition is not a weighted grid.
+ */
+EpsilodGrid *epsilod_grid();
+
+/**
+ * @brief Creates a layout with weighted blocks on a grid topology.
+ * The topology, active processes and neighbours are those of a regular block layout.
+ * The local shape is replaced by the weighted block of the process.
+ * @param topo Grid topology. Freed with the layout.
+ * @param shp_inner Shape to distribute.
+ * @param weights Weights of the processes, in the order of their ranks in the topology.
+ * @param[out] p_grid Boundaries of the blocks. Free with epsilod_grid_free().
+ * @return The layout.
+ */
+HitLayout epsilod_grid_layout(HitTopology topo, HitShape shp_inner, HitWeights weights, EpsilodGrid *p_grid);
+
+/**
+ * @brief Frees the boundaries of a grid.
+ * @param p_grid Grid to free.
+ */
+void epsilod_grid_free(EpsilodGrid *p_grid);
+
+/**
+ * @brief Number of processes in a grid.
+ * @param grid The grid.
+ * @return Product of the processes in each partitioned dimension.
+ */
+int epsilod_grid_num_procs(EpsilodGrid grid);
+
+/**
+ * @brief Coordinates of a process in a grid.
+ * @param grid The grid.
+ * @param proc Rank of the process in the topology.
+ * @return Grid coordinates, last dimension first to vary.
+ */
+HitRanks epsilod_grid_ranks(EpsilodGrid grid, int proc);
+
+/**
+ * @brief Block of a process in a grid.
+ * @param grid The grid.
+ * @param ranks Grid coordinates of the process.
+ * @return Shape of the block. Dimensions that are not partitioned are whole.
+ */
+HitShape epsilod_grid_shape(EpsilodGrid grid, HitRanks ranks);
+
+#endif // _EPSILOD_GRID_H_
@@ -6,26 +6,1073 @@
  * The relevant license, warranty and copyright notice is available in the EPSILOD project repository.
  */
 
+// Needed for strdup and strtok_r
+#define _GNU_SOURCE
+
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include "epsilod_io.h"
+#include "epsilod_codec.h"
 #include "epsilod_env.h"
+#include "epsilod_log.h"
+
+/**
+ * Hitmap data type of the array and tile file modes
+ */
+#if EPSILOD_IS_DOUBLE(EPSILOD_SCALAR_TYPE)
+#define EPSILOD_HIT_FILE_TYPE HIT_FILE_DOUBLE
+#else
+#define EPSILOD_HIT_FILE_TYPE HIT_FILE_FLOAT
+#endif
+
+/**
+ * Active processes, which open the MPI-IO files. MPI_COMM_NULL if MPI-IO is not used or the process is not active.
+ * It is thread local, as the background writer takes over the one of the run whose output it writes
+ */
+static _Thread_local MPI_Comm io_comm = MPI_COMM_NULL;
+
+/**
+ * Duplicate of io_comm used by the background writer for the snapshots of the run
+ */
+static MPI_Comm snapshot_comm = MPI_COMM_NULL;
+
+/**
+ * Background writer of the final output and the snapshots
+ */
+static struct {
+	pthread_t                  thread;                  /**< Writer thread */
+	pthread_mutex_t            lock;                    /**< Protects done */
+	bool                       running;                 /**< Whether the thread has been started and not joined */
+	bool                       done;                    /**< Whether the output has been written */
+	outputDataFunction         f_output;                /**< Output function. NULL for snapshots */
+	Epsilod_ext               *ext_params;              /**< Extra parameters of the output function */
+	IOTileMode                 mode;                    /**< File mode of the snapshots */
+	char                       file_name[FILENAME_MAX]; /**< File of the snapshot */
+	HitTile                    root;                    /**< Copy of the global tile, ancestor of an owned buffer */
+	HitTile(EPSILOD_BASE_TYPE) buffer;                  /**< Tile to write */
+	bool                       owned;                   /**< Whether the buffer is a copy to be freed */
+	MPI_Comm                   comm;                    /**< MPI-IO communicator of the writer */
+	bool                       free_comm;               /**< Whether the writer frees the communicator */
+} writer = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+/**
+ * @brief Whether a file mode is used by any of the input / output operations.
+ * @param mode File mode
+ * @return true if it is used, false otherwise
+ */
+static bool io_mode_used(IOTileMode mode) {
+	return epsilod_read_input() == mode || epsilod_write_input() == mode || epsilod_write_output() == mode || (epsilod_snapshots() && epsilod_snapshot_mode() == mode);
+}
+
+void epsilod_io_init(bool active) {
+	if (!io_mode_used(EPSILOD_FILE_MPIIO) && !io_mode_used(EPSILOD_FILE_CHUNKED))
+		return;
+	int ok = MPI_Comm_split(hit_Comm, active ? 0 : MPI_UNDEFINED, hit_Rank, &io_comm);
+	hit_mpiTestError(ok, "Failed creating the MPI-IO communicator");
+}
+
+void epsilod_io_finalize() {
+	if (io_comm != MPI_COMM_NULL)
+		MPI_Comm_free(&io_comm);
+	if (snapshot_comm != MPI_COMM_NULL)
+		MPI_Comm_free(&snapshot_comm);
+}
+
+IOTileMode epsilod_snapshot_mode() {
+	IOTileMode mode = epsilod_write_output();
+	return (mode != EPSILOD_FILE_NONE) ? mode : EPSILOD_FILE_CHUNKED;
+}
+
+/**
+ * @brief Builds the MPI-IO hints given in EPSILOD_MPIIO_HINTS.
+ * @return The hints. To be freed by the caller
+ */
+static MPI_Info mpiio_hints() {
+	MPI_Info info;
+	MPI_Info_create(&info);
+	char *hints = epsilod_mpiio_hints();
+	if (hints == NULL)
+		return info;
+
+	char *list = strdup(hints);
+	char *save;
+	for (char *hint = strtok_r(list, ",", &save); hint != NULL; hint = strtok_r(NULL, ",", &save)) {
+		char *value = strchr(hint, '=');
+		if (value == NULL || value == hint) {
+			fprintf(stderr, "\nError in EPSILOD_MPIIO_HINTS enviroment string: <key>=<value> pairs separated by commas are expected. String: %s\n\n", hints);
+			MPI_Abort(MPI_COMM_WORLD, MPI_ERR_OTHER);
+			exit(EXIT_FAILURE);
+		}
+		*value = '\0';
+		MPI_Info_set(info, hint, value + 1);
+	}
+	free(list);
+	return info;
+}
+
+/**
+ * @brief Reads or writes a tile in a raw binary file with the whole array, with collective MPI-IO.
+ * The file holds the cells of the global tile in row-major order, in the native representation and without header.
+ * The view of each process is the subarray of its tile, and the memory of the tile is described with its strides,
+ * so the cells are not copied. Overlapping tiles hold the same values, as the halos.
+ * @param tile Local tile, in the host
+ * @param file_name Name of the file
+ * @param write Whether the tile is written, or read otherwise
+ */
+static void mpiio_tile(HitTile(EPSILOD_BASE_TYPE) tile, const char *file_name, bool write) {
+	HitTile   *root      = (HitTile *)hit_tileRoot(&tile);
+	int        dims      = hit_tileDims(tile);
+	int        sizes[EPSILOD_MAX_DIMS];
+	int        subsizes[EPSILOD_MAX_DIMS];
+	int        starts[EPSILOD_MAX_DIMS];
+	MPI_Offset file_size = sizeof(EPSILOD_BASE_TYPE);
+	for (int d = 0; d < dims; d++) {
+		sizes[d]    = hit_tileDimCard(*root, d);
+		subsizes[d] = hit_tileDimCard(tile, d);
+		starts[d]   = hit_tileDimBegin(tile, d) - hit_tileDimBegin(*root, d);
+		file_size *= sizes[d];
+	}
+
+	// Position of the tile in the file, and its cells in memory
+	MPI_Datatype cell, view, memory;
+	MPI_Type_contiguous(sizeof(EPSILOD_BASE_TYPE), MPI_BYTE, &cell);
+	MPI_Type_create_subarray(dims, sizes, subsizes, starts, MPI_ORDER_C, cell, &view);
+	MPI_Type_commit(&view);
+	MPI_Type_dup(cell, &memory);
+	for (int d = dims - 1; d >= 0; d--) {
+		MPI_Datatype inner  = memory;
+		MPI_Aint     stride = (MPI_Aint)tile.origAcumCard[d + 1] * tile.qstride[d] * sizeof(EPSILOD_BASE_TYPE);
+		MPI_Type_create_hvector(subsizes[d], 1, stride, inner, &memory);
+		MPI_Type_free(&inner);
+	}
+	MPI_Type_commit(&memory);
+
+	MPI_Info info = mpiio_hints();
+	MPI_File file;
+	int      ok = MPI_File_open(io_comm, file_name, write ? (MPI_MODE_CREATE | MPI_MODE_WRONLY) : MPI_MODE_RDONLY, info, &file);
+	if (ok != MPI_SUCCESS) {
+		fprintf(stderr, "\nError: File %s cannot be opened with MPI-IO.\n\n", file_name);
+		MPI_Abort(MPI_COMM_WORLD, MPI_ERR_OTHER);
+		exit(EXIT_FAILURE);
+	}
+	if (write) {
+		ok = MPI_File_set_size(file, file_size);
+		hit_mpiTestError(ok, "Failed setting the MPI-IO file size");
+	}
+	ok = MPI_File_set_view(file, 0, cell, view, "native", info);
+	hit_mpiTestError(ok, "Failed setting the MPI-IO file view");
+	if (write)
+		ok = MPI_File_write_all(file, tile.data, 1, memory, MPI_STATUS_IGNORE);
+	else
+		ok = MPI_File_read_all(file, tile.data, 1, memory, MPI_STATUS_IGNORE);
+	hit_mpiTestError(ok, write ? "Failed writing with MPI-IO" : "Failed reading with MPI-IO");
+	MPI_File_close(&file);
+
+	MPI_Info_free(&info);
+	MPI_Type_free(&memory);
+	MPI_Type_free(&view);
+	MPI_Type_free(&cell);
+}
+
+/**
+ * @brief Number of chunks of a chunked file in a dimension.
+ * @param header Header of the file
+ * @param d Dimension
+ * @return The number of chunks
+ */
+static uint64_t chunked_grid(const EpsilodChunkedHeader *header, int d) {
+	return (header->sizes[d] + header->chunk[d] - 1) / header->chunk[d];
+}
+
+/**
+ * @brief Number of chunks of a chunked file.
+ * @param header Header of the file
+ * @return The number of chunks
+ */
+static uint64_t chunked_count(const EpsilodChunkedHeader *header) {
+	uint64_t count = 1;
+	for (int d = 0; d < header->dims; d++)
+		count *= chunked_grid(header, d);
+	return count;
+}
+
+/**
+ * @brief Cells of a chunk in a dimension, truncated to the domain.
+ * @param header Header of the file
+ * @param d Dimension
+ * @param c Index of the chunk in the dimension
+ * @return The extent of the chunk
+ */
+static uint64_t chunk_extent(const EpsilodChunkedHeader *header, int d, uint64_t c) {
+	uint64_t begin = c * header->chunk[d];
+	uint64_t end   = begin + header->chunk[d];
+	return ((end < header->sizes[d]) ? end : header->sizes[d]) - begin;
+}
+
+/**
+ * @brief Offset in cells of a chunk from the first one.
+ * The chunks before it in row-major order are the ones with a lower index in the first dimension where they
+ * differ. Those with a lower index in a dimension are full in it, as only the last ones are truncated.
+ * @param header Header of the file
+ * @param c Indexes of the chunk
+ * @return The offset in cells
+ */
+static uint64_t chunk_offset(const EpsilodChunkedHeader *header, const uint64_t *c) {
+	uint64_t offset = 0;
+	for (int d = 0; d < header->dims; d++) {
+		uint64_t before = c[d] * header->chunk[d];
+		for (int e = 0; e < d; e++)
+			before *= chunk_extent(header, e, c[e]);
+		for (int e = d + 1; e < header->dims; e++)
+			before *= header->sizes[e];
+		offset += before;
+	}
+	return offset;
+}
+
+/**
+ * @brief Position of a chunk in a chunked file.
+ * @param header Header of the file
+ * @param index Row-major index of the chunk
+ * @param[out] offset Offset in bytes of the chunk in the file
+ * @return The size in bytes of the chunk
+ */
+static size_t chunk_range(const EpsilodChunkedHeader *header, uint64_t index, size_t *offset) {
+	uint64_t c[EPSILOD_MAX_DIMS];
+	size_t   bytes = header->cell_size;
+	for (int d = header->dims - 1; d >= 0; d--) {
+		c[d] = index % chunked_grid(header, d);
+		index /= chunked_grid(header, d);
+		bytes *= chunk_extent(header, d, c[d]);
+	}
+	*offset = header->data_offset + chunk_offset(header, c) * header->cell_size;
+	return bytes;
+}
+
+/**
+ * @brief 64-bit FNV-1a checksum of a chunk.
+ * @param data Bytes of the chunk
+ * @param size Number of bytes
+ * @return The checksum
+ */
+static uint64_t chunk_checksum(const void *data, size_t size) {
+	const unsigned char *bytes = data;
+	uint64_t             hash  = 0xcbf29ce484222325ULL;
+	for (size_t i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+/**
+ * @brief Header of a chunked file of the global tile, with the base type of this build.
+ * Chunks have the same cells in every dimension, about EPSILOD_CHUNK_KB in total, up to the domain sizes.
+ * @param tile Local tile
+ * @param checksums Whether the file has a checksum per chunk
+ * @return The header
+ */
+static EpsilodChunkedHeader chunked_header(HitTile(EPSILOD_BASE_TYPE) tile, bool checksums) {
+	HitTile             *root   = (HitTile *)hit_tileRoot(&tile);
+	EpsilodChunkedHeader header = {.version = EPSILOD_CHUNKED_VERSION, .endian = EPSILOD_CHUNKED_ENDIAN};
+	memcpy(header.magic, EPSILOD_CHUNKED_MAGIC, sizeof(header.magic));
+	strncpy(header.scalar_type, STR(EPSILOD_SCALAR_TYPE), sizeof(header.scalar_type) - 1);
+	header.scalar_size = sizeof(EPSILOD_SCALAR_TYPE);
+	header.components  = EPSILOD_SCALAR_COUNT;
+	header.cell_size   = sizeof(EPSILOD_BASE_TYPE);
+	header.dims        = hit_tileDims(tile);
+	header.flags       = checksums ? EPSILOD_CHUNKED_CHECKSUMS : 0;
+
+	double   cells = (double)epsilod_chunk_kb() * 1024 / header.cell_size;
+	uint64_t edge  = (uint64_t)fmax(1.0, floor(pow(cells, 1.0 / header.dims) + 1e-9));
+	for (int d = 0; d < header.dims; d++) {
+		header.sizes[d] = hit_tileDimCard(*root, d);
+		header.chunk[d] = (edge < header.sizes[d]) ? edge : header.sizes[d];
+	}
+	size_t table       = checksums ? sizeof(uint64_t) * chunked_count(&header) : 0;
+	header.data_offset = (sizeof(header) + table + EPSILOD_CHUNKED_ALIGN - 1) / EPSILOD_CHUNKED_ALIGN * EPSILOD_CHUNKED_ALIGN;
+	return header;
+}
+
+/**
+ * @brief Function applied to each run of consecutive cells of a tile in a chunked file.
+ * @param chunk Row-major index of the chunk that holds the run
+ * @param file_offset Offset in bytes of the run in the file
+ * @param mem_offset Offset in bytes of the run from the data of the tile
+ * @param bytes Size in bytes of the run
+ * @param arg Argument of the traversal
+ */
+typedef void (*chunkedRunFunction)(uint64_t chunk, size_t file_offset, size_t mem_offset, size_t bytes, void *arg);
+
+/**
+ * @brief Advances a multi-index to the next one of a box in row-major order.
+ * @param dims Number of dimensions
+ * @param begin First index of the box in each dimension
+ * @param end Last index of the box in each dimension
+ * @param[inout] index Multi-index
+ * @return false if it was the last one of the box, true otherwise
+ */
+static bool next_index(int dims, const uint64_t *begin, const uint64_t *end, uint64_t *index) {
+	for (int d = dims - 1; d >= 0; d--) {
+		if (++index[d] <= end[d])
+			return true;
+		index[d] = begin[d];
+	}
+	return false;
+}
+
+/**
+ * @brief Traverses the cells of a tile in a chunked file, in the order of the file.
+ * Only the chunks that intersect the tile are visited, and in each of them the part of each row of the last
+ * dimension that belongs to the tile is a run.
+ * @param header Header of the file
+ * @param tile Local tile, in the host
+ * @param f_run Function applied to each run
+ * @param arg Argument passed to \p f_run
+ */
+static void chunked_runs(const EpsilodChunkedHeader *header, HitTile(EPSILOD_BASE_TYPE) tile, chunkedRunFunction f_run, void *arg) {
+	HitTile *root = (HitTile *)hit_tileRoot(&tile);
+	int      dims = header->dims;
+	int      last = dims - 1;
+	uint64_t lo[EPSILOD_MAX_DIMS], hi[EPSILOD_MAX_DIMS];
+	uint64_t first[EPSILOD_MAX_DIMS], final[EPSILOD_MAX_DIMS], c[EPSILOD_MAX_DIMS];
+	size_t   stride[EPSILOD_MAX_DIMS];
+	if (hit_tileCard(tile) <= 0)
+		return;
+	for (int d = 0; d < dims; d++) {
+		lo[d]     = hit_tileDimBegin(tile, d) - hit_tileDimBegin(*root, d);
+		hi[d]     = lo[d] + hit_tileDimCard(tile, d) - 1;
+		first[d]  = lo[d] / header->chunk[d];
+		final[d]  = hi[d] / header->chunk[d];
+		c[d]      = first[d];
+		stride[d] = (size_t)tile.origAcumCard[d + 1] * tile.qstride[d] * header->cell_size;
+	}
+
+	do {
+		// Intersection of the chunk and the tile
+		uint64_t begin[EPSILOD_MAX_DIMS], end[EPSILOD_MAX_DIMS], extent[EPSILOD_MAX_DIMS], pos[EPSILOD_MAX_DIMS];
+		uint64_t index = 0;
+		for (int d = 0; d < dims; d++) {
+			uint64_t origin = c[d] * header->chunk[d];
+			extent[d]       = chunk_extent(header, d, c[d]);
+			begin[d]        = (lo[d] > origin) ? lo[d] : origin;
+			end[d]          = (hi[d] < origin + extent[d] - 1) ? hi[d] : origin + extent[d] - 1;
+			pos[d]          = begin[d];
+			index           = index * chunked_grid(header, d) + c[d];
+		}
+		size_t base  = header->data_offset + chunk_offset(header, c) * header->cell_size;
+		size_t bytes = (end[last] - begin[last] + 1) * header->cell_size;
+
+		// Rows of the intersection
+		do {
+			size_t in_chunk = 0;
+			size_t mem      = 0;
+			for (int d = 0; d < dims; d++) {
+				in_chunk = in_chunk * extent[d] + (pos[d] - c[d] * header->chunk[d]);
+				mem += (pos[d] - lo[d]) * stride[d];
+			}
+			f_run(index, base + in_chunk * header->cell_size, mem, bytes, arg);
+		} while (next_index(last, begin, end, pos));
+	} while (next_index(dims, first, final, c));
+}
+
+/**
+ * Runs of a tile in a chunked file, gathered to build the MPI-IO datatypes
+ */
+typedef struct ChunkedRuns {
+	int       count;    /**< Number of runs */
+	int       capacity; /**< Allocated runs */
+	int      *bytes;    /**< Size in bytes of each run */
+	MPI_Aint *file;     /**< Offset of each run in the file */
+	MPI_Aint *mem;      /**< Offset of each run from the data of the tile */
+} ChunkedRuns;
+
+/**
+ * @brief Adds a run to a ChunkedRuns. @see chunkedRunFunction
+ * Runs consecutive both in the file and in memory are merged, up to the int counts of MPI.
+ */
+static void add_run(uint64_t chunk, size_t file_offset, size_t mem_offset, size_t bytes, void *arg) {
+	ChunkedRuns *runs = arg;
+	int          n    = runs->count;
+	if (n > 0 && (size_t)(runs->file[n - 1] + runs->bytes[n - 1]) == file_offset && (size_t)(runs->mem[n - 1] + runs->bytes[n - 1]) == mem_offset && runs->bytes[n - 1] + bytes <= INT_MAX) {
+		runs->bytes[n - 1] += bytes;
+		return;
+	}
+	if (n == runs->capacity) {
+		runs->capacity = (n > 0) ? 2 * n : 64;
+		runs->bytes    = realloc(runs->bytes, sizeof(int) * runs->capacity);
+		runs->file     = realloc(runs->file, sizeof(MPI_Aint) * runs->capacity);
+		runs->mem      = realloc(runs->mem, sizeof(MPI_Aint) * runs->capacity);
+	}
+	runs->bytes[n] = bytes;
+	runs->file[n]  = file_offset;
+	runs->mem[n]   = mem_offset;
+	runs->count++;
+}
+
+/**
+ * Maximum size in bytes of each collective write of compressed blocks, to keep the int counts of MPI
+ */
+#define EPSILOD_CHUNKED_PIECE (1 << 30)
+
+/**
+ * @brief Intersection of a tile and a block of a compressed chunked file.
+ * @param header Header of the file
+ * @param tile Local tile, in the host
+ * @param block Block
+ * @param[out] lo First index of the tile in the domain, borders included
+ * @param[out] begin First index of the intersection
+ * @param[out] end Last index of the intersection
+ * @return false if they do not intersect, true otherwise
+ */
+static bool block_box(const EpsilodChunkedHeader *header, HitTile(EPSILOD_BASE_TYPE) tile, const EpsilodChunkedBlock *block, uint64_t *lo, uint64_t *begin, uint64_t *end) {
+	HitTile *root = (HitTile *)hit_tileRoot(&tile);
+	if (hit_tileCard(tile) <= 0)
+		return false;
+	for (int d = 0; d < header->dims; d++) {
+		lo[d]         = hit_tileDimBegin(tile, d) - hit_tileDimBegin(*root, d);
+		uint64_t hi   = lo[d] + hit_tileDimCard(tile, d) - 1;
+		uint64_t last = block->begin[d] + block->card[d] - 1;
+		begin[d]      = (lo[d] > block->begin[d]) ? lo[d] : block->begin[d];
+		end[d]        = (hi < last) ? hi : last;
+		if (begin[d] > end[d])
+			return false;
+	}
+	return true;
+}
+
+/**
+ * @brief Size in bytes of the cells of a block of a compressed chunked file.
+ * @param header Header of the file
+ * @param block Block
+ * @return The uncompressed size
+ */
+static size_t block_bytes(const EpsilodChunkedHeader *header, const EpsilodChunkedBlock *block) {
+	size_t bytes = header->cell_size;
+	for (int d = 0; d < header->dims; d++)
+		bytes *= block->card[d];
+	return bytes;
+}
+
+/**
+ * @brief Copies the cells shared by a tile and a block, between the tile and the packed cells of the block.
+ * @param header Header of the file
+ * @param tile Local tile, in the host
+ * @param block Block
+ * @param cells Cells of the block, in row-major order
+ * @param to_tile Whether the cells are copied from the block to the tile, or from the tile to the block
+ */
+static void copy_block(const EpsilodChunkedHeader *header, HitTile(EPSILOD_BASE_TYPE) tile, const EpsilodChunkedBlock *block, char *cells, bool to_tile) {
+	int      dims = header->dims;
+	int      last = dims - 1;
+	uint64_t lo[EPSILOD_MAX_DIMS], begin[EPSILOD_MAX_DIMS], end[EPSILOD_MAX_DIMS], pos[EPSILOD_MAX_DIMS];
+	if (!block_box(header, tile, block, lo, begin, end))
+		return;
+	memcpy(pos, begin, sizeof(uint64_t) * dims);
+	size_t bytes = (end[last] - begin[last] + 1) * header->cell_size;
+
+	// Rows of the intersection
+	do {
+		size_t in_block = 0;
+		size_t mem      = 0;
+		for (int d = 0; d < dims; d++) {
+			in_block = in_block * block->card[d] + (pos[d] - block->begin[d]);
+			mem += (pos[d] - lo[d]) * (size_t)tile.origAcumCard[d + 1] * tile.qstride[d] * header->cell_size;
+		}
+		char *data = (char *)tile.data + mem;
+		if (to_tile)
+			memcpy(data, cells + in_block * header->cell_size, bytes);
+		else
+			memcpy(cells + in_block * header->cell_size, data, bytes);
+	} while (next_index(last, begin, end, pos));
+}
+
+/**
+ * @brief Blocks of a tile in a compressed chunked file: its intersections with the chunks.
+ * @param header Header of the file
+ * @param tile Local tile, in the host
+ * @param[out] count Number of blocks
+ * @return The blocks, with their position and cells only. NULL if the tile is empty
+ */
+static EpsilodChunkedBlock *tile_blocks(const EpsilodChunkedHeader *header, HitTile(EPSILOD_BASE_TYPE) tile, int *count) {
+	HitTile *root = (HitTile *)hit_tileRoot(&tile);
+	int      dims = header->dims;
+	int      num  = 1;
+	uint64_t lo[EPSILOD_MAX_DIMS], hi[EPSILOD_MAX_DIMS];
+	uint64_t first[EPSILOD_MAX_DIMS], final[EPSILOD_MAX_DIMS], c[EPSILOD_MAX_DIMS];
+	*count = 0;
+	if (hit_tileCard(tile) <= 0)
+		return NULL;
+	for (int d = 0; d < dims; d++) {
+		lo[d]    = hit_tileDimBegin(tile, d) - hit_tileDimBegin(*root, d);
+		hi[d]    = lo[d] + hit_tileDimCard(tile, d) - 1;
+		first[d] = lo[d] / header->chunk[d];
+		final[d] = hi[d] / header->chunk[d];
+		c[d]     = first[d];
+		num *= (int)(final[d] - first[d] + 1);
+	}
+
+	EpsilodChunkedBlock *blocks = calloc(num, sizeof(EpsilodChunkedBlock));
+	do {
+		EpsilodChunkedBlock *block = &blocks[(*count)++];
+		for (int d = 0; d < dims; d++) {
+			uint64_t origin = c[d] * header->chunk[d];
+			uint64_t last   = origin + chunk_extent(header, d, c[d]) - 1;
+			block->begin[d] = (lo[d] > origin) ? lo[d] : origin;
+			block->card[d]  = ((hi[d] < last) ? hi[d] : last) - block->begin[d] + 1;
+		}
+	} while (next_index(dims, first, final, c));
+	return blocks;
+}
+
+/**
+ * @brief Writes a tile in a compressed chunked file, with collective MPI-IO.
+ * The blocks of the tile are packed, byte shuffled and compressed in parallel by the OpenMP threads. A prefix
+ * sum of the blocks and compressed sizes of the processes places their index entries and their data, which
+ * each process writes with collective calls. The first process writes the header and the number of blocks.
+ * @param tile Local tile, in the host
+ * @param file_name Name of the file
+ */
+static void compressed_write(HitTile(EPSILOD_BASE_TYPE) tile, const char *file_name) {
+	EpsilodChunkedHeader header = chunked_header(tile, epsilod_chunk_checksums());
+	header.codec                = epsilod_chunk_codec();
+
+	int                  count;
+	EpsilodChunkedBlock *blocks = tile_blocks(&header, tile, &count);
+
+	// Each block is compressed in its own slot of a buffer sized for the worst case
+	size_t *slots     = malloc(sizeof(size_t) * (count + 1));
+	size_t  max_bytes = 0;
+	slots[0]          = 0;
+	for (int b = 0; b < count; b++) {
+		size_t bytes = block_bytes(&header, &blocks[b]);
+		max_bytes    = (bytes > max_bytes) ? bytes : max_bytes;
+		slots[b + 1] = slots[b] + epsilod_chunk_compress_bound(header.codec, bytes);
+	}
+	char *data = malloc(slots[count]);
+	#pragma omp parallel
+	{
+		char *cells   = malloc(max_bytes);
+		char *scratch = malloc(max_bytes);
+		#pragma omp for schedule(dynamic)
+		for (int b = 0; b < count; b++) {
+			size_t bytes = block_bytes(&header, &blocks[b]);
+			copy_block(&header, tile, &blocks[b], cells, false);
+			blocks[b].checksum = (header.flags & EPSILOD_CHUNKED_CHECKSUMS) ? chunk_checksum(cells, bytes) : 0;
+			blocks[b].bytes    = epsilod_chunk_compress(header.codec, cells, bytes, data + slots[b], slots[b + 1] - slots[b], scratch);
+		}
+		free(scratch);
+		free(cells);
+	}
+
+	// Compressed blocks one after another
+	unsigned long long local[2] = {(unsigned long long)count, 0};
+	for (int b = 0; b < count; b++) {
+		memmove(data + local[1], data + slots[b], blocks[b].bytes);
+		blocks[b].offset = local[1];
+		local[1] += blocks[b].bytes;
+	}
+
+	// Position of the blocks of this process in the index and in the data
+	int rank;
+	MPI_Comm_rank(io_comm, &rank);
+	unsigned long long first[2] = {0, 0};
+	unsigned long long total[2];
+	int                ok = MPI_Exscan(local, first, 2, MPI_UNSIGNED_LONG_LONG, MPI_SUM, io_comm);
+	hit_mpiTestError(ok, "Failed scanning the compressed block sizes");
+	if (rank == 0)
+		first[0] = first[1] = 0;
+	ok = MPI_Allreduce(local, total, 2, MPI_UNSIGNED_LONG_LONG, MPI_SUM, io_comm);
+	hit_mpiTestError(ok, "Failed reducing the compressed block sizes");
+	for (int b = 0; b < count; b++)
+		blocks[b].offset += first[1];
+	uint64_t num_blocks = total[0];
+	size_t   index      = sizeof(header) + sizeof(uint64_t);
+	header.data_offset  = (index + sizeof(EpsilodChunkedBlock) * num_blocks + EPSILOD_CHUNKED_ALIGN - 1) / EPSILOD_CHUNKED_ALIGN * EPSILOD_CHUNKED_ALIGN;
+
+	MPI_Info info = mpiio_hints();
+	MPI_File file;
+	ok = MPI_File_open(io_comm, file_name, MPI_MODE_CREATE | MPI_MODE_RDWR, info, &file);
+	if (ok != MPI_SUCCESS) {
+		fprintf(stderr, "\nError: File %s cannot be opened with MPI-IO.\n\n", file_name);
+		MPI_Abort(MPI_COMM_WORLD, MPI_ERR_OTHER);
+		exit(EXIT_FAILURE);
+	}
+	ok = MPI_File_set_size(file, header.data_offset + total[1]);
+	hit_mpiTestError(ok, "Failed setting the MPI-IO file size");
+	ok = MPI_File_write_at_all(file, index + sizeof(EpsilodChunkedBlock) * first[0], blocks, (int)(sizeof(EpsilodChunkedBlock) * count), MPI_BYTE, MPI_STATUS_IGNORE);
+	hit_mpiTestError(ok, "Failed writing with MPI-IO");
+
+	// Compressed data, in as many collective writes as the largest one needs
+	long long pieces = (local[1] + EPSILOD_CHUNKED_PIECE - 1) / EPSILOD_CHUNKED_PIECE;
+	ok               = MPI_Allreduce(MPI_IN_PLACE, &pieces, 1, MPI_LONG_LONG, MPI_MAX, io_comm);
+	hit_mpiTestError(ok, "Failed reducing the compressed block sizes");
+	for (long long p = 0; p < pieces; p++) {
+		size_t begin = (size_t)p * EPSILOD_CHUNKED_PIECE;
+		size_t bytes = (begin < local[1]) ? local[1] - begin : 0;
+		bytes        = (bytes < EPSILOD_CHUNKED_PIECE) ? bytes : EPSILOD_CHUNKED_PIECE;
+		ok           = MPI_File_write_at_all(file, header.data_offset + first[1] + begin, data + ((bytes > 0) ? begin : 0), (int)bytes, MPI_BYTE, MPI_STATUS_IGNORE);
+		hit_mpiTestError(ok, "Failed writing with MPI-IO");
+	}
+	if (rank == 0) {
+		ok = MPI_File_write_at(file, 0, &header, sizeof(header), MPI_BYTE, MPI_STATUS_IGNORE);
+		hit_mpiTestError(ok, "Failed writing with MPI-IO");
+		ok = MPI_File_write_at(file, sizeof(header), &num_blocks, sizeof(num_blocks), MPI_BYTE, MPI_STATUS_IGNORE);
+		hit_mpiTestError(ok, "Failed writing with MPI-IO");
+	}
+	MPI_File_close(&file);
+
+	MPI_Info_free(&info);
+	free(data);
+	free(slots);
+	free(blocks);
+}
+
+/**
+ * @brief Writes a tile in a chunked file, with collective MPI-IO.
+ * The view of each process is the list of its runs in the file, which is in increasing order, and the memory
+ * is described by the same runs, so the cells are not copied. Overlapping tiles hold the same values.
+ * Once the cells are written, the checksums of the chunks are computed in parallel reading them back.
+ * Files with an EPSILOD_CHUNK_CODEC are written by compressed_write().
+ * @param tile Local tile, in the host
+ * @param file_name Name of the file
+ */
+static void chunked_write(HitTile(EPSILOD_BASE_TYPE) tile, const char *file_name) {
+	if (epsilod_chunk_codec() != EPSILOD_CHUNK_CODEC_NONE) {
+		compressed_write(tile, file_name);
+		return;
+	}
+	EpsilodChunkedHeader header     = chunked_header(tile, epsilod_chunk_checksums());
+	uint64_t             num_chunks = chunked_count(&header);
+	MPI_Offset           file_size  = header.cell_size;
+	for (int d = 0; d < header.dims; d++)
+		file_size *= header.sizes[d];
+	file_size += header.data_offset;
+
+	// Position of the tile in the file, and its cells in memory
+	ChunkedRuns runs = {0};
+	chunked_runs(&header, tile, add_run, &runs);
+	MPI_Datatype view, memory;
+	MPI_Type_create_hindexed(runs.count, runs.bytes, runs.file, MPI_BYTE, &view);
+	MPI_Type_commit(&view);
+	MPI_Type_create_hindexed(runs.count, runs.bytes, runs.mem, MPI_BYTE, &memory);
+	MPI_Type_commit(&memory);
+
+	MPI_Info info = mpiio_hints();
+	MPI_File file;
+	int      ok = MPI_File_open(io_comm, file_name, MPI_MODE_CREATE | MPI_MODE_RDWR, info, &file);
+	if (ok != MPI_SUCCESS) {
+		fprintf(stderr, "\nError: File %s cannot be opened with MPI-IO.\n\n", file_name);
+		MPI_Abort(MPI_COMM_WORLD, MPI_ERR_OTHER);
+		exit(EXIT_FAILURE);
+	}
+	ok = MPI_File_set_size(file, file_size);
+	hit_mpiTestError(ok, "Failed setting the MPI-IO file size");
+	ok = MPI_File_set_view(file, 0, MPI_BYTE, view, "native", info);
+	hit_mpiTestError(ok, "Failed setting the MPI-IO file view");
+	ok = MPI_File_write_all(file, tile.data, 1, memory, MPI_STATUS_IGNORE);
+	hit_mpiTestError(ok, "Failed writing with MPI-IO");
+	ok = MPI_File_set_view(file, 0, MPI_BYTE, MPI_BYTE, "native", info);
+	hit_mpiTestError(ok, "Failed setting the MPI-IO file view");
+
+	int rank;
+	MPI_Comm_rank(io_comm, &rank);
+	if (header.flags & EPSILOD_CHUNKED_CHECKSUMS) {
+		// Each process hashes a share of the chunks, once all the cells are in the file
+		int size;
+		MPI_Comm_size(io_comm, &size);
+		MPI_File_sync(file);
+		MPI_Barrier(io_comm);
+		MPI_File_sync(file);
+
+		uint64_t *checksums = calloc(num_chunks, sizeof(uint64_t));
+		size_t    max_bytes = header.cell_size;
+		for (int d = 0; d < header.dims; d++)
+			max_bytes *= header.chunk[d];
+		char *buffer = malloc(max_bytes);
+		for (uint64_t k = rank; k < num_chunks; k += size) {
+			size_t offset;
+			size_t bytes = chunk_range(&header, k, &offset);
+			ok           = MPI_File_read_at(file, offset, buffer, (int)bytes, MPI_BYTE, MPI_STATUS_IGNORE);
+			hit_mpiTestError(ok, "Failed reading with MPI-IO");
+			checksums[k] = chunk_checksum(buffer, bytes);
+		}
+		free(buffer);
+		ok = MPI_Reduce((rank == 0) ? MPI_IN_PLACE : checksums, checksums, (int)num_chunks, MPI_UINT64_T, MPI_SUM, 0, io_comm);
+		hit_mpiTestError(ok, "Failed reducing the chunk checksums");
+		if (rank == 0) {
+			ok = MPI_File_write_at(file, sizeof(header), checksums, (int)(sizeof(uint64_t) * num_chunks), MPI_BYTE, MPI_STATUS_IGNORE);
+			hit_mpiTestError(ok, "Failed writing with MPI-IO");
+		}
+		free(checksums);
+	}
+	if (rank == 0) {
+		ok = MPI_File_write_at(file, 0, &header, sizeof(header), MPI_BYTE, MPI_STATUS_IGNORE);
+		hit_mpiTestError(ok, "Failed writing with MPI-IO");
+	}
+	MPI_File_close(&file);
+
+	MPI_Info_free(&info);
+	MPI_Type_free(&memory);
+	MPI_Type_free(&view);
+	free(runs.bytes);
+	free(runs.file);
+	free(runs.mem);
+}
+
+/**
+ * State of the copy of a mapped chunked file to a tile
+ */
+typedef struct ChunkedRead {
+	const char                 *file_name; /**< Name of the file */
+	const char                 *map;       /**< Mapped file */
+	const EpsilodChunkedHeader *header;    /**< Header of the file */
+	char                       *data;      /**< Data of the tile */
+	uint64_t                    verified;  /**< Last chunk whose checksum has been verified */
+} ChunkedRead;
+
+/**
+ * @brief Copies a run from a mapped chunked file to a tile. @see chunkedRunFunction
+ * The checksum of each chunk is verified before its first run is copied.
+ */
+static void read_run(uint64_t chunk, size_t file_offset, size_t mem_offset, size_t bytes, void *arg) {
+	ChunkedRead *state = arg;
+	if ((state->header->flags & EPSILOD_CHUNKED_CHECKSUMS) && chunk != state->verified) {
+		const uint64_t *checksums = (const uint64_t *)(state->map + sizeof(EpsilodChunkedHeader));
+		size_t          offset;
+		size_t          chunk_bytes = chunk_range(state->header, chunk, &offset);
+		if (chunk_checksum(state->map + offset, chunk_bytes) != checksums[chunk]) {
+			fprintf(stderr, "\nError: Chunk %llu of file %s does not match its checksum.\n\n", (unsigned long long)chunk, state->file_name);
+			MPI_Abort(MPI_COMM_WORLD, MPI_ERR_OTHER);
+			exit(EXIT_FAILURE);
+		}
+		state->verified = chunk;
+	}
+	memcpy(state->data + mem_offset, state->map + file_offset, bytes);
+}
+
+/**
+ * @brief Reads a tile from a compressed chunked file, mapped in memory and already validated.
+ * The blocks that intersect the tile are decompressed in parallel by the OpenMP threads, their checksums are
+ * verified if the file has them, and only their cells in the tile are copied.
+ * @param tile Local tile, in the host
+ * @param file_name Name of the file
+ * @param map Mapped file
+ * @param map_size Size of the file
+ */
+static void compressed_read(HitTile(EPSILOD_BASE_TYPE) tile, const char *file_name, const char *map, size_t map_size) {
+	const EpsilodChunkedHeader *header     = (const EpsilodChunkedHeader *)map;
+	uint64_t                    num_blocks = *(const uint64_t *)(map + sizeof(*header));
+	const EpsilodChunkedBlock  *blocks     = (const EpsilodChunkedBlock *)(map + sizeof(*header) + sizeof(uint64_t));
+
+	// Blocks of the file that hold cells of the tile
+	int       count     = 0;
+	size_t    max_bytes = 0;
+	uint64_t *selected  = malloc(sizeof(uint64_t) * num_blocks);
+	for (uint64_t b = 0; b < num_blocks; b++) {
+		bool valid = blocks[b].offset + blocks[b].bytes <= map_size - header->data_offset;
+		for (int d = 0; valid && d < header->dims; d++)
+			valid = blocks[b].card[d] > 0 && blocks[b].begin[d] + blocks[b].card[d] <= header->sizes[d];
+		if (!valid) {
+			fprintf(stderr, "\nError: Block %llu of file %s is out of the bounds of the file or the domain.\n\n", (unsigned long long)b, file_name);
+			MPI_Abort(MPI_COMM_WORLD, MPI_ERR_OTHER);
+			exit(EXIT_FAILURE);
+		}
+		uint64_t lo[EPSILOD_MAX_DIMS], begin[EPSILOD_MAX_DIMS], end[EPSILOD_MAX_DIMS];
+		if (!block_box(header, tile, &blocks[b], lo, begin, end))
+			continue;
+		size_t bytes      = block_bytes(header, &blocks[b]);
+		max_bytes         = (bytes > max_bytes) ? bytes : max_bytes;
+		selected[count++] = b;
+	}
+
+	#pragma omp parallel
+	{
+		char *cells   = malloc(max_bytes);
+		char *scratch = malloc(max_bytes);
+		#pragma omp for schedule(dynamic)
+		for (int k = 0; k < count; k++) {
+			const EpsilodChunkedBlock *block = &blocks[selected[k]];
+			size_t                     bytes = block_bytes(header, block);
+			epsilod_chunk_decompress(header->codec, map + header->data_offset + block->offset, block->bytes, cells, bytes, scratch);
+			if ((header->flags & EPSILOD_CHUNKED_CHECKSUMS) && chunk_checksum(cells, bytes) != block->checksum) {
+				fprintf(stderr, "\nError: Block %llu of file %s does not match its checksum.\n\n", (unsigned long long)selected[k], file_name);
+				MPI_Abort(MPI_COMM_WORLD, MPI_ERR_OTHER);
+				exit(EXIT_FAILURE);
+			}
+			copy_block(header, tile, block, cells, true);
+		}
+		free(scratch);
+		free(cells);
+	}
+	free(selected);
+}
+
+/**
+ * @brief Reads a tile from a chunked file, mapped in memory.
+ * The header must describe the domain and the base type of this build. Only the pages of the chunks that
+ * intersect the tile are touched, and only the runs of the tile are copied. Compressed files are read by
+ * compressed_read().
+ * @param tile Local tile, in the host
+ * @param file_name Name of the file
+ */
+static void chunked_read(HitTile(EPSILOD_BASE_TYPE) tile, const char *file_name) {
+	struct stat stat_buf;
+	int         fd  = open(file_name, O_RDONLY);
+	const char *map = MAP_FAILED;
+	if (fd >= 0 && fstat(fd, &stat_buf) == 0 && stat_buf.st_size > 0)
+		map = mmap(NULL, stat_buf.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED) {
+		fprintf(stderr, "\nError: File %s cannot be mapped.\n\n", file_name);
+		MPI_Abort(MPI_COMM_WORLD, MPI_ERR_OTHER);
+		exit(EXIT_FAILURE);
+	}
+
+	EpsilodChunkedHeader        expected = chunked_header(tile, false);
+	const EpsilodChunkedHeader *header   = (const EpsilodChunkedHeader *)map;
+	bool                        valid    = (size_t)stat_buf.st_size >= sizeof(*header) && memcmp(header->magic, expected.magic, sizeof(header->magic)) == 0 && header->version == expected.version && header->endian == expected.endian && strncmp(header->scalar_type, expected.scalar_type, sizeof(header->scalar_type)) == 0 && header->scalar_size == expected.scalar_size && header->components == expected.components && header->cell_size == expected.cell_size && header->dims == expected.dims;
+	uint64_t                    cells    = 1;
+	for (int d = 0; valid && d < header->dims; d++) {
+		valid = header->sizes[d] == expected.sizes[d] && header->chunk[d] > 0;
+		cells *= header->sizes[d];
+	}
+	if (valid && header->codec != EPSILOD_CHUNK_CODEC_NONE) {
+		size_t index = sizeof(*header) + sizeof(uint64_t);
+		valid        = header->codec <= EPSILOD_CHUNK_CODEC_ZSTD && (size_t)stat_buf.st_size >= index;
+		if (valid) {
+			uint64_t num_blocks = *(const uint64_t *)(map + sizeof(*header));
+			valid               = num_blocks <= (stat_buf.st_size - index) / sizeof(EpsilodChunkedBlock) && header->data_offset >= index + num_blocks * sizeof(EpsilodChunkedBlock) && (uint64_t)stat_buf.st_size >= header->data_offset;
+		}
+	} else if (valid) {
+		size_t table = (header->flags & EPSILOD_CHUNKED_CHECKSUMS) ? sizeof(uint64_t) * chunked_count(header) : 0;
+		valid        = header->data_offset >= sizeof(*header) + table && (uint64_t)stat_buf.st_size >= header->data_offset + cells * header->cell_size;
+	}
+	if (!valid) {
+		fprintf(stderr, "\nError: File %s is not a chunked file of the domain sizes and base type (%s) of this run.\n\n", file_name, expected.scalar_type);
+		MPI_Abort(MPI_COMM_WORLD, MPI_ERR_OTHER);
+		exit(EXIT_FAILURE);
+	}
+
+	if (header->codec != EPSILOD_CHUNK_CODEC_NONE) {
+		compressed_read(tile, file_name, map, stat_buf.st_size);
+	} else {
+		ChunkedRead state = {.file_name = file_name, .map = map, .header = header, .data = (char *)tile.data, .verified = UINT64_MAX};
+		chunked_runs(header, tile, read_run, &state);
+	}
+	munmap((void *)map, stat_buf.st_size);
+	close(fd);
+}
+
+/**
+ * @brief Writes a tile in a file with the given mode.
+ * @param mode File mode, not EPSILOD_FILE_NONE
+ * @param tile Local tile, in the host
+ * @param file_name Name of the file
+ */
+static void write_tile(IOTileMode mode, HitTile(EPSILOD_BASE_TYPE) tile, const char *file_name) {
+	if (mode == EPSILOD_FILE_MPIIO) {
+		mpiio_tile(tile, file_name, true);
+	} else if (mode == EPSILOD_FILE_CHUNKED) {
+		chunked_write(tile, file_name);
+	} else {
+		hit_tileFileWriteOptions(&tile, (char *)file_name, NULL, HIT_FILE_RUNTIME, HIT_FILE_RUNTIME, mode - 1, HIT_FILE_RUNTIME, EPSILOD_HIT_FILE_TYPE, HIT_FILE_RUNTIME, HIT_FILE_RUNTIME);
+	}
+}
 
 void epsilod_read_input_default(HitTile(EPSILOD_BASE_TYPE) io_tile, EpsilodCoords global, Epsilod_ext *ext_params) {
 	IOTileMode io_read_input = epsilod_read_input();
-	if (io_read_input != EPSILOD_FILE_NONE) {
-		hit_tileFileReadOptions(&io_tile, "Matrix.in", NULL, HIT_FILE_RUNTIME, HIT_FILE_RUNTIME, io_read_input - 1, HIT_FILE_RUNTIME, HIT_FILE_FLOAT, HIT_FILE_RUNTIME, HIT_FILE_RUNTIME);
+	if (io_read_input == EPSILOD_FILE_MPIIO) {
+		mpiio_tile(io_tile, epsilod_input_file(), false);
+	} else if (io_read_input == EPSILOD_FILE_CHUNKED) {
+		chunked_read(io_tile, epsilod_input_file());
+	} else if (io_read_input != EPSILOD_FILE_NONE) {
+		hit_tileFileReadOptions(&io_tile, epsilod_input_file(), NULL, HIT_FILE_RUNTIME, HIT_FILE_RUNTIME, io_read_input - 1, HIT_FILE_RUNTIME, EPSILOD_HIT_FILE_TYPE, HIT_FILE_RUNTIME, HIT_FILE_RUNTIME);
 	}
 }
 
 void epsilod_write_input_default(HitTile(EPSILOD_BASE_TYPE) io_tile, EpsilodCoords global, Epsilod_ext *ext_params) {
 	IOTileMode io_write_input = epsilod_write_input();
-	if (io_write_input != EPSILOD_FILE_NONE) {
-		hit_tileFileWriteOptions(&io_tile, "Matrix.copy", NULL, HIT_FILE_RUNTIME, HIT_FILE_RUNTIME, io_write_input - 1, HIT_FILE_RUNTIME, HIT_FILE_FLOAT, HIT_FILE_RUNTIME, HIT_FILE_RUNTIME);
-	}
+	if (io_write_input != EPSILOD_FILE_NONE)
+		write_tile(io_write_input, io_tile, epsilod_input_copy_file());
 }
 
 void epsilod_write_output_default(HitTile(EPSILOD_BASE_TYPE) io_tile, Epsilod_ext *ext_params) {
 	IOTileMode io_write_output = epsilod_write_output();
-	if (io_write_output != EPSILOD_FILE_NONE) {
-		hit_tileFileWriteOptions(&io_tile, "Matrix.out", NULL, HIT_FILE_RUNTIME, HIT_FILE_RUNTIME, io_write_output - 1, HIT_FILE_RUNTIME, HIT_FILE_FLOAT, HIT_FILE_RUNTIME, HIT_FILE_RUNTIME);
+	if (io_write_output != EPSILOD_FILE_NONE)
+		write_tile(io_write_output, io_tile, epsilod_output_file());
+}
+
+/**
+ * @brief Copies the cells of a tile to another one with the same shape, row by row of the last dimension.
+ * @param dst Destination tile
+ * @param src Source tile
+ */
+static void copy_cells(HitTile(EPSILOD_BASE_TYPE) dst, HitTile(EPSILOD_BASE_TYPE) src) {
+	int    dims = hit_tileDims(src);
+	int    last = dims - 1;
+	int    len  = hit_tileDimCard(src, last);
+	size_t rows = (size_t)hit_tileCard(src) / len;
+
+	HitInd idx[EPSILOD_MAX_DIMS] = {0};
+	for (size_t r = 0; r < rows; r++) {
+		size_t from = 0;
+		size_t to   = 0;
+		for (int d = 0; d < last; d++) {
+			from += idx[d] * src.origAcumCard[d + 1] * src.qstride[d];
+			to += idx[d] * dst.origAcumCard[d + 1] * dst.qstride[d];
+		}
+		for (int i = 0; i < len; i++)
+			dst.data[to + i * dst.qstride[last]] = src.data[from + i * src.qstride[last]];
+		for (int d = last - 1; d >= 0; d--) {
+			if (++idx[d] < hit_tileDimCard(src, d))
+				break;
+			idx[d] = 0;
+		}
+	}
+}
+
+/**
+ * @brief Background writer main function: writes the tile and frees the MPI-IO communicator if it owns it.
+ */
+static void *writer_main(void *arg) {
+	io_comm = writer.comm;
+	if (writer.f_output != NULL)
+		writer.f_output(writer.buffer, writer.ext_params);
+	else
+		write_tile(writer.mode, writer.buffer, writer.file_name);
+	if (writer.free_comm && io_comm != MPI_COMM_NULL)
+		MPI_Comm_free(&io_comm);
+	io_comm = MPI_COMM_NULL;
+
+	pthread_mutex_lock(&writer.lock);
+	writer.done = true;
+	pthread_mutex_unlock(&writer.lock);
+	return NULL;
+}
+
+/**
+ * @brief Whether a file mode can be written by the background writer.
+ * Only the mpiio and chunked modes, which use their own communicators. The array and tile modes of Hitmap
+ * use the communicators of the run, which cannot be used by two threads at the same time.
+ * @param mode File mode
+ * @return true if the mode can be written in the background, false otherwise
+ */
+static bool writer_mode(IOTileMode mode) {
+	return mode == EPSILOD_FILE_MPIIO || mode == EPSILOD_FILE_CHUNKED;
+}
+
+/**
+ * @brief Whether the background writer can be used. Otherwise, a warning is printed once.
+ * @return true if MPI supports MPI_THREAD_MULTIPLE, false otherwise
+ */
+static bool writer_available() {
+	static bool warned = false;
+	int         provided;
+	MPI_Query_thread(&provided);
+	if (provided >= MPI_THREAD_MULTIPLE)
+		return true;
+	if (!warned)
+		print_once("Warning: Asynchronous output and snapshots require MPI_THREAD_MULTIPLE. They are written synchronously.\n");
+	warned = true;
+	return false;
+}
+
+/**
+ * @brief Starts the writer thread on the prepared writer state.
+ * @return true if it has been started, false if it could not be created
+ */
+static bool writer_launch() {
+	writer.done = false;
+	if (pthread_create(&writer.thread, NULL, writer_main, NULL) != 0) {
+		print_all("[%d] Warning: the output writer thread could not be created. The output is written synchronously.\n", hit_Rank);
+		return false;
+	}
+	writer.running = true;
+	return true;
+}
+
+void epsilod_output_start(outputDataFunction f_output, HitTile(EPSILOD_BASE_TYPE) io_tile, Epsilod_ext *ext_params) {
+	epsilod_output_wait();
+	if (!epsilod_async_output()) {
+		f_output(io_tile, ext_params);
+		return;
+	}
+	// Custom output functions may use any communicator of the run
+	if (f_output != epsilod_write_output_default || !writer_mode(epsilod_write_output())) {
+		print_once("Warning: Asynchronous output only applies to the default output in mpiio or chunked mode. The output is written synchronously.\n");
+		f_output(io_tile, ext_params);
+		return;
+	}
+	if (!writer_available()) {
+		f_output(io_tile, ext_params);
+		return;
+	}
+
+	// Own copy of the tile, in the global coordinates of the domain
+	writer.root = *hit_tileRoot(&io_tile);
+	hit_tileDomainShapeAlloc(&writer.buffer, EPSILOD_BASE_TYPE, hit_tileShape(io_tile));
+	copy_cells(writer.buffer, io_tile);
+	writer.buffer.ref = &writer.root;
+	writer.owned      = true;
+	writer.f_output   = f_output;
+	writer.ext_params = ext_params;
+	writer.comm       = io_comm;
+	writer.free_comm  = true;
+	io_comm           = MPI_COMM_NULL;
+	if (!writer_launch()) {
+		io_comm           = writer.comm;
+		writer.buffer.ref = NULL;
+		hit_tileFree(writer.buffer);
+		f_output(io_tile, ext_params);
+	}
+}
+
+void epsilod_output_snapshot(HitTile(EPSILOD_BASE_TYPE) io_tile, int iteration) {
+	epsilod_output_wait();
+	IOTileMode mode = epsilod_snapshot_mode();
+	snprintf(writer.file_name, sizeof(writer.file_name), "%s.%06d", epsilod_snapshot_file(), iteration);
+	if (!writer_mode(mode) || !writer_available()) {
+		write_tile(mode, io_tile, writer.file_name);
+		return;
+	}
+
+	if (snapshot_comm == MPI_COMM_NULL && io_comm != MPI_COMM_NULL) {
+		int ok = MPI_Comm_dup(io_comm, &snapshot_comm);
+		hit_mpiTestError(ok, "Failed creating the snapshots communicator");
+	}
+	writer.buffer    = io_tile;
+	writer.owned     = false;
+	writer.f_output  = NULL;
+	writer.mode      = mode;
+	writer.comm      = snapshot_comm;
+	writer.free_comm = false;
+	if (!writer_launch())
+		write_tile(mode, io_tile, writer.file_name);
+}
+
+bool epsilod_output_test() {
+	pthread_mutex_lock(&writer.lock);
+	bool done = !writer.running || writer.done;
+	pthread_mutex_unlock(&writer.lock);
+	return done;
+}
+
+void epsilod_output_wait() {
+	if (!writer.running)
+		return;
+
+	pthread_join(writer.thread, NULL);
+	writer.running = false;
+	if (writer.owned) {
+		writer.buffer.ref = NULL;
+		hit_tileFree(writer.buffer);
 	}
 }
@@ -1,5 +1,5 @@
 /**
- * @file epsilod_io.c
+ * @file epsilod_io.h
  * @brief Epsilod: Input / output handling
  *
  * @copyright This software is part of the EPSILOD project by Trasgo Group, UVa.
@@ -9,11 +9,136 @@
 #ifndef _EPSILOD_IO_H_
 #define _EPSILOD_IO_H_
 
+#include <stdint.h>
+
 #include "epsilod_structs.h"
 
+/**
+ * Magic string at the beginning of the files of the chunked file mode
+ */
+#define EPSILOD_CHUNKED_MAGIC "EPSCHUNK"
+
+/**
+ * Version of the chunked file format
+ */
+#define EPSILOD_CHUNKED_VERSION 1
+
+/**
+ * Value of the \e endian field written in the native byte order
+ */
+#define EPSILOD_CHUNKED_ENDIAN 0x01020304
+
+/**
+ * Flag of the chunked files with a checksum per chunk
+ */
+#define EPSILOD_CHUNKED_CHECKSUMS 1
+
+/**
+ * Alignment in bytes of the first chunk, so that the chunks can be mapped page by page
+ */
+#define EPSILOD_CHUNKED_ALIGN 4096
+
+/**
+ * Header of the files of the chunked file mode.
+ * The header is followed by a table with the 64-bit FNV-1a checksum of the bytes of each chunk, if the
+ * EPSILOD_CHUNKED_CHECKSUMS flag is set, and by the chunks from \e data_offset.
+ * The domain, borders included, is split in chunks of \e chunk cells, except the last ones of each dimension
+ * that are truncated to the domain. Chunks are stored in row-major order of their grid, and the cells of each
+ * chunk in row-major order, without padding. All the fields and cells are in the native representation.
+ * Compressed files, with a \e codec other than EPSILOD_CHUNK_CODEC_NONE, store blocks instead of chunks.
+ * @see EpsilodChunkedBlock
+ */
+typedef struct EpsilodChunkedHeader {
+	char     magic[8];                /**< EPSILOD_CHUNKED_MAGIC, without the null character */
+	uint32_t version;                 /**< EPSILOD_CHUNKED_VERSION */
+	uint32_t endian;                  /**< EPSILOD_CHUNKED_ENDIAN */
+	char     scalar_type[16];         /**< Name of the base type, or of the type of the components of compound cells */
+	uint32_t scalar_size;             /**< Size in bytes of the scalar type */
+	uint32_t components;              /**< Components of the compound cells, 1 for non compound base types */
+	uint32_t cell_size;               /**< Size in bytes of a cell */
+	uint32_t dims;                    /**< Number of dimensions */
+	uint64_t sizes[EPSILOD_MAX_DIMS]; /**< Global sizes of the domain, borders included */
+	uint64_t chunk[EPSILOD_MAX_DIMS]; /**< Chunk shape */
+	uint64_t data_offset;             /**< Offset in bytes of the first chunk */
+	uint32_t flags;                   /**< EPSILOD_CHUNKED_CHECKSUMS if there is a checksum per chunk */
+	uint32_t codec;                   /**< EpsilodChunkCodec of the blocks, EPSILOD_CHUNK_CODEC_NONE for plain chunks */
+} EpsilodChunkedHeader;
+
+/**
+ * Entry of the block index of compressed chunked files.
+ * The header of these files is followed by the number of blocks, as a uint64_t, and by an entry per block.
+ * A block is the part of a chunk written by a process, so each process compresses its blocks on its own and
+ * in parallel. Its cells are byte shuffled and compressed in row-major order of the block, and the compressed
+ * blocks are stored from \e data_offset in the order of the index. Blocks of overlapping tiles hold the same
+ * values. The checksums are computed on the uncompressed cells.
+ */
+typedef struct EpsilodChunkedBlock {
+	uint64_t begin[EPSILOD_MAX_DIMS]; /**< First index of the block in the domain, borders included */
+	uint64_t card[EPSILOD_MAX_DIMS];  /**< Cells of the block in each dimension */
+	uint64_t offset;                  /**< Offset in bytes of the compressed block from \e data_offset */
+	uint64_t bytes;                   /**< Compressed size in bytes */
+	uint64_t checksum;                /**< FNV-1a checksum of the cells if the EPSILOD_CHUNKED_CHECKSUMS flag is set, 0 otherwise */
+} EpsilodChunkedBlock;
+
+/**
+ * @brief Prepares the collective MPI-IO of the mpiio and chunked file modes, if they are used by the input,
+ * the output or the snapshots.
+ * It must be called by all the processes, as the files are opened by the active ones only.
+ * @param active Whether this process is active in the partition
+ */
+void epsilod_io_init(bool active);
+
+/**
+ * @brief Frees the resources of epsilod_io_init().
+ */
+void epsilod_io_finalize();
+
+/**
+ * @brief File mode of the snapshots: the one of EPSILOD_WRITE_OUTPUT, or chunked if the output is not written.
+ * @return The file mode
+ */
+IOTileMode epsilod_snapshot_mode();
+
+/**
+ * @brief Writes the final output, in a background thread if EPSILOD_ASYNC_OUTPUT is set.
+ * Only the default output function in the mpiio or chunked mode is written in the background. It takes over
+ * the MPI-IO communicator of the run and works on its own copy of the io tile, so the tiles can be freed and
+ * control returns right away. Custom output functions and the array and tile modes may use the communicators
+ * of the run, so they are written synchronously. A previous background output is waited for first.
+ * Without MPI_THREAD_MULTIPLE support, the output is written synchronously.
+ * @param f_output Output function
+ * @param io_tile Tile to write, in the host
+ * @param ext_params extra parameters
+ */
+void epsilod_output_start(outputDataFunction f_output, HitTile(EPSILOD_BASE_TYPE) io_tile, Epsilod_ext *ext_params);
+
+/**
+ * @brief Writes a snapshot of the domain in the background, if MPI_THREAD_MULTIPLE is supported.
+ * The file is named with the EPSILOD_SNAPSHOT_FILE prefix and the iteration, and written with the
+ * epsilod_snapshot_mode(). Only the mpiio and chunked modes are written in the background: the array and
+ * tile modes of Hitmap use the communicators of the run, so they are written synchronously. The tile is not
+ * copied, so it must not be modified or freed until the snapshot is completed. A previous background output
+ * is waited for first.
+ * @param io_tile Tile to write, in the host
+ * @param iteration Number of iterations computed
+ */
+void epsilod_output_snapshot(HitTile(EPSILOD_BASE_TYPE) io_tile, int iteration);
+
+/**
+ * @brief Whether the last output has been completed.
+ * @return true if it has been written or there is none, false if it is still being written.
+ */
+bool epsilod_output_test();
+
+/**
+ * @brief Waits for the background output to be completed and frees its copy of the tile.
+ * It must be called before Ctrl_Finalize() when the output is asynchronous.
+ */
+void epsilod_output_wait();
+
 /**
  * @brief Default method to read EPSILOD's input tile from a file.
- * Uses environement variable EPSILOD_READ_INPUT with posible values: "none", "array" or "tile".
+ * Uses environement variable EPSILOD_READ_INPUT with posible values: "none", "array", "tile", "mpiio" or "chunked".
  * @param io_tile Tile to read
  * @param global global coordinates
  * @param ext_params extra parameters
@@ -22,7 +147,7 @@ void epsilod_read_input_default(HitTile(EPSILOD_BASE_TYPE) io_tile, EpsilodCoord
 
 /**
  * @brief Default method to write EPSILOD's initial state tile to a file.
- * Uses environement variable EPSILOD_WRITE_INPUT with posible values: "none", "array" or "tile".
+ * Uses environement variable EPSILOD_WRITE_INPUT with posible values: "none", "array", "tile", "mpiio" or "chunked".
  * @param io_tile Tile to write
  * @param global global coordinates
  * @param ext_params extra parameters
@@ -31,7 +156,7 @@ void epsilod_write_input_default(HitTile(EPSILOD_BASE_TYPE) io_tile, EpsilodCoor
 
 /**
  * @brief Default method to write EPSILOD's output tile to a file.
- * Uses environement variable EPSILOD_WRITE_OUTPUT with posible values: "none", "array" or "tile".
+ * Uses environement variable EPSILOD_WRITE_OUTPUT with posible values: "none", "array", "tile", "mpiio" or "chunked".
  * @param io_tile Tile to write
  * @param global global coordinates
  * @param ext_params extra parameters
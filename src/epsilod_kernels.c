@@ -103,5 +103,31 @@ CTRL_KERNEL(epsilod_dev_copy_4d, GENERIC, DEFAULT, KHitTileR(EPSILOD_BASE_TYPE)
 		hit(matrix_out, h, thr_i, thr_j, thr_k) = hit(matrix, h, thr_i, thr_j, thr_k);
 });
 
+#if CTRL_COUNTPARAM(EPSILOD_BASE_TYPE_COMPOUND) == 2
+/* Copy kernels for the components of compound cells selected by a mask. Used to pack and unpack halos */
+#define EPSILOD_CELL_COMPONENT(cell, c) (((EPSILOD_GET_COMPOUND_TYPE(EPSILOD_BASE_TYPE_COMPOUND) *)&(cell))[c])
+
+CTRL_KERNEL(epsilod_dev_copy_masked_1d, GENERIC, DEFAULT, KHitTileR(EPSILOD_BASE_TYPE) matrix, const KHitTileR(EPSILOD_BASE_TYPE) matrix_out, EpsilodComponentMask mask, {
+	for (int c = 0; c < mask.count; c++)
+		EPSILOD_CELL_COMPONENT(hit(matrix_out, thr_i), mask.index[c]) = EPSILOD_CELL_COMPONENT(hit(matrix, thr_i), mask.index[c]);
+});
+
+CTRL_KERNEL(epsilod_dev_copy_masked_2d, GENERIC, DEFAULT, KHitTileR(EPSILOD_BASE_TYPE) matrix, const KHitTileR(EPSILOD_BASE_TYPE) matrix_out, EpsilodComponentMask mask, {
+	for (int c = 0; c < mask.count; c++)
+		EPSILOD_CELL_COMPONENT(hit(matrix_out, thr_i, thr_j), mask.index[c]) = EPSILOD_CELL_COMPONENT(hit(matrix, thr_i, thr_j), mask.index[c]);
+});
+
+CTRL_KERNEL(epsilod_dev_copy_masked_3d, GENERIC, DEFAULT, KHitTileR(EPSILOD_BASE_TYPE) matrix, const KHitTileR(EPSILOD_BASE_TYPE) matrix_out, EpsilodComponentMask mask, {
+	for (int c = 0; c < mask.count; c++)
+		EPSILOD_CELL_COMPONENT(hit(matrix_out, thr_i, thr_j, thr_k), mask.index[c]) = EPSILOD_CELL_COMPONENT(hit(matrix, thr_i, thr_j, thr_k), mask.index[c]);
+});
+
+CTRL_KERNEL(epsilod_dev_copy_masked_4d, GENERIC, DEFAULT, KHitTileR(EPSILOD_BASE_TYPE) matrix, const KHitTileR(EPSILOD_BASE_TYPE) matrix_out, EpsilodComponentMask mask, {
+	for (int h = 0; h < hit_tileDimCard(matrix, 0); h++)
+		for (int c = 0; c < mask.count; c++)
+			EPSILOD_CELL_COMPONENT(hit(matrix_out, h, thr_i, thr_j, thr_k), mask.index[c]) = EPSILOD_CELL_COMPONENT(hit(matrix, h, thr_i, thr_j, thr_k), mask.index[c]);
+});
+#endif // CTRL_COUNTPARAM(EPSILOD_BASE_TYPE_COMPOUND) == 2
+
 /* Empty kernel: to signal subselection and root tiles as modified to track dependencies */
 CTRL_KERNEL(epsilod_dev_touch, GENERIC, DEFAULT, KHitTileR(EPSILOD_BASE_TYPE) matrix, { ; });
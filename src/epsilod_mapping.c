@@ -0,0 +1,216 @@
+/**
+ * @file epsilod_mapping.c
+ * @brief Epsilod: Node and socket aware mapping of processes to the blocks of a grid topology
+ *
+ * @copyright This software is part of the EPSILOD project by Trasgo Group, UVa.
+ * The relevant license, warranty and copyright notice is available in the EPSILOD project repository.
+ */
+
+#ifdef _EPSILOD_HWLOC_
+	#include <hwloc.h>
+#endif // _EPSILOD_HWLOC_
+
+#include "epsilod_mapping.h"
+#include "epsilod_log.h"
+
+/**
+ * Location of a process in the machine
+ */
+typedef struct EpsilodLocation {
+	int node;   /**< Rank of the first process of the node */
+	int socket; /**< Index of the socket in the node, 0 if unknown */
+	int rank;   /**< Rank in the topology communicator */
+} EpsilodLocation;
+
+/**
+ * @brief Socket where the calling process is bound.
+ * @return Logical index of the socket, or 0 if it is unknown or the process is not bound to a single socket.
+ */
+static int local_socket() {
+	int socket = 0;
+	#ifdef _EPSILOD_HWLOC_
+	hwloc_topology_t topology;
+	hwloc_bitmap_t   cpuset = hwloc_bitmap_alloc();
+	hwloc_topology_init(&topology);
+	hwloc_topology_load(topology);
+	if (hwloc_get_cpubind(topology, cpuset, HWLOC_CPUBIND_PROCESS) == 0) {
+		hwloc_obj_t obj = hwloc_get_obj_covering_cpuset(topology, cpuset);
+		if (obj != NULL && obj->type != HWLOC_OBJ_PACKAGE)
+			obj = hwloc_get_ancestor_obj_by_type(topology, HWLOC_OBJ_PACKAGE, obj);
+		if (obj != NULL)
+			socket = (int)obj->logical_index;
+	}
+	hwloc_bitmap_free(cpuset);
+	hwloc_topology_destroy(topology);
+	#endif // _EPSILOD_HWLOC_
+	return socket;
+}
+
+/**
+ * @brief Orders locations by node, socket and rank.
+ */
+static int compare_locations(const void *a, const void *b) {
+	const EpsilodLocation *la = a;
+	const EpsilodLocation *lb = b;
+	if (la->node != lb->node) return la->node - lb->node;
+	if (la->socket != lb->socket) return la->socket - lb->socket;
+	return la->rank - lb->rank;
+}
+
+/**
+ * @brief Size of the groups of consecutive locations with the same key.
+ * @param locations Sorted locations.
+ * @param num Number of locations.
+ * @param by_socket Whether groups are sockets or nodes.
+ * @return The size of the groups, or 0 if they have different sizes.
+ */
+static int group_size(const EpsilodLocation *locations, int num, bool by_socket) {
+	int size = 0, count = 0;
+	for (int i = 0; i < num; i++) {
+		count++;
+		bool last = i == num - 1 || locations[i + 1].node != locations[i].node || (by_socket && locations[i + 1].socket != locations[i].socket);
+		if (!last)
+			continue;
+		if (size != 0 && count != size)
+			return 0;
+		size  = count;
+		count = 0;
+	}
+	return size;
+}
+
+/**
+ * @brief Finds the most compact sub-block with a given number of positions that tiles a grid.
+ * @param dims Number of dimensions of the grid.
+ * @param card Positions of the grid in each dimension.
+ * @param size Positions of the sub-block.
+ * @param[out] tile Positions of the sub-block in each dimension. Each one divides \p card.
+ * @return true if such a sub-block exists, false otherwise.
+ */
+static bool fold_shape(int dims, const int *card, int size, int *tile) {
+	int    candidate[EPSILOD_MAX_DIMS];
+	int    d         = 0;
+	double best_cost = -1;
+
+	// Depth-first enumeration of the divisors of each dimension
+	candidate[0] = 0;
+	while (d >= 0) {
+		candidate[d]++;
+		int rest = size;
+		for (int i = 0; i < d; i++)
+			rest /= candidate[i];
+		if (candidate[d] > card[d] || candidate[d] > rest) {
+			d--;
+			continue;
+		}
+		if (card[d] % candidate[d] != 0 || rest % candidate[d] != 0)
+			continue;
+		if (d < dims - 1) {
+			candidate[++d] = 0;
+			continue;
+		}
+		if (candidate[d] != rest)
+			continue;
+
+		// Cost: faces of the sub-block, the neighbours in other sub-blocks
+		double cost = 0;
+		for (int i = 0; i < dims; i++)
+			cost += (double)size / candidate[i];
+		if (best_cost < 0 || cost < best_cost) {
+			best_cost = cost;
+			for (int i = 0; i < dims; i++)
+				tile[i] = candidate[i];
+		}
+	}
+	return best_cost >= 0;
+}
+
+/**
+ * @brief Coordinates of a row-major index in a grid, last dimension first to vary.
+ * @param dims Number of dimensions of the grid.
+ * @param card Positions of the grid in each dimension.
+ * @param index Row-major index.
+ * @param[out] coords Coordinates.
+ */
+static void index_to_coords(int dims, const int *card, int index, int *coords) {
+	for (int d = dims - 1; d >= 0; d--) {
+		coords[d] = index % card[d];
+		index /= card[d];
+	}
+}
+
+void epsilod_map_topology(HitTopology *p_topo) {
+	MPI_Comm comm = p_topo->pTopology->comm;
+	int      dims = hit_topDims(*p_topo);
+	int      rank, num_procs;
+	MPI_Comm_rank(comm, &rank);
+	MPI_Comm_size(comm, &num_procs);
+
+	int card[EPSILOD_MAX_DIMS];
+	int grid_procs = 1;
+	for (int d = 0; d < dims; d++) {
+		card[d] = hit_topDimCard(*p_topo, d);
+		grid_procs *= card[d];
+	}
+	if (grid_procs != num_procs) {
+		print_once("Warning: Node mapping skipped, the grid does not use every process.\n");
+		return;
+	}
+
+	// Locate the processes
+	MPI_Comm node_comm;
+	MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &node_comm);
+	EpsilodLocation self = {.node = rank, .socket = local_socket(), .rank = rank};
+	MPI_Bcast(&self.node, 1, MPI_INT, 0, node_comm);
+	MPI_Comm_free(&node_comm);
+
+	EpsilodLocation *locations = malloc(sizeof(EpsilodLocation) * num_procs);
+	MPI_Allgather(&self, 3, MPI_INT, locations, 3, MPI_INT, comm);
+	qsort(locations, num_procs, sizeof(EpsilodLocation), compare_locations);
+
+	// Sub-blocks of nodes and, inside them, of sockets
+	int node_size   = group_size(locations, num_procs, false);
+	int socket_size = group_size(locations, num_procs, true);
+	int node_tile[EPSILOD_MAX_DIMS], socket_tile[EPSILOD_MAX_DIMS];
+	if (node_size == 0 || !fold_shape(dims, card, node_size, node_tile)) {
+		print_once("Warning: Node mapping skipped, nodes with different number of processes or not fitting the grid.\n");
+		free(locations);
+		return;
+	}
+	if (socket_size == 0 || node_size % socket_size != 0 || !fold_shape(dims, node_tile, socket_size, socket_tile)) {
+		socket_size = node_size;
+		for (int d = 0; d < dims; d++)
+			socket_tile[d] = node_tile[d];
+	}
+
+	// Position of this process: its index in the sorted locations, split in node, socket and inner offsets
+	int index = 0;
+	while (locations[index].rank != rank)
+		index++;
+	free(locations);
+
+	int node_grid[EPSILOD_MAX_DIMS], socket_grid[EPSILOD_MAX_DIMS];
+	int node_coords[EPSILOD_MAX_DIMS], socket_coords[EPSILOD_MAX_DIMS], inner_coords[EPSILOD_MAX_DIMS];
+	for (int d = 0; d < dims; d++) {
+		node_grid[d]   = card[d] / node_tile[d];
+		socket_grid[d] = node_tile[d] / socket_tile[d];
+	}
+	index_to_coords(dims, node_grid, index / node_size, node_coords);
+	index_to_coords(dims, socket_grid, index % node_size / socket_size, socket_coords);
+	index_to_coords(dims, socket_tile, index % socket_size, inner_coords);
+
+	int key = 0;
+	for (int d = 0; d < dims; d++) {
+		p_topo->self.rank[d] = node_coords[d] * node_tile[d] + socket_coords[d] * socket_tile[d] + inner_coords[d];
+		key                  = key * card[d] + p_topo->self.rank[d];
+	}
+
+	// Communicator ranked by grid position
+	MPI_Comm mapped_comm;
+	int      ok = MPI_Comm_split(comm, 0, key, &mapped_comm);
+	hit_mpiTestError(ok, "Failed creating the mapped topology communicator");
+	MPI_Comm_free(&p_topo->pTopology->comm);
+	p_topo->pTopology->comm = mapped_comm;
+
+	print_once("Epsilod node mapping: %d processes per node, %d per socket\n", node_size, socket_size);
+}
@@ -0,0 +1,26 @@
+/**
+ * @file epsilod_mapping.h
+ * @brief Epsilod: Node and socket aware mapping of processes to the blocks of a grid topology
+ *
+ * @copyright This software is part of the EPSILOD project by Trasgo Group, UVa.
+ * The relevant license, warranty and copyright notice is available in the EPSILOD project repository.
+ */
+
+#ifndef _EPSILOD_MAPPING_H_
+#define _EPSILOD_MAPPING_H_
+
+#include "epsilod_structs.h"
+
+/**
+ * @brief Reorders the processes of a grid topology so that neighbour blocks share a node or socket.
+ * The grid is folded in sub-blocks with as many positions as processes in a node, and each node sub-block
+ * in sub-blocks with the processes of a socket. Processes are assigned to positions ordered by node and socket.
+ * The communicator of the topology is replaced by one ranked in the new order, so Hitmap patterns and
+ * neighbour ranks follow the mapping. The topology is kept if nodes have different numbers of processes
+ * or their sub-blocks do not fit the grid.
+ * Sockets are only detected when EPSILOD is built with hwloc.
+ * @param[inout] p_topo Array topology to reorder.
+ */
+void epsilod_map_topology(HitTopology *p_topo);
+
+#endif // _EPSILOD_MAPPING_H_
@@ -0,0 +1,95 @@
+/**
+ * @file epsilod_mask.c
+ * @brief Epsilod: Activity mask of domains with inactive regions
+ *
+ * @copyright This software is part of the EPSILOD project by Trasgo Group, UVa.
+ * The relevant license, warranty and copyright notice is available in the EPSILOD project repository.
+ */
+
+#include <string.h>
+
+#include "epsilod_mask.h"
+
+/**
+ * Activity mask declared by the user
+ */
+static struct {
+	activeCellFunction f_active; /**< Function that tells whether a cell is active. NULL if there is no mask */
+	void              *arg;      /**< Argument of the function */
+} mask;
+
+void epsilod_set_activity_mask(activeCellFunction f_active, void *arg) {
+	mask.f_active = f_active;
+	mask.arg      = arg;
+}
+
+bool epsilod_mask_set() {
+	return mask.f_active != NULL;
+}
+
+/**
+ * @brief Coordinates of a row-major index in a region, last dimension first to vary.
+ * @param shp Region.
+ * @param index Row-major index of the cell in the region.
+ * @param[out] coords Global coordinates of the cell.
+ */
+static void cell_coords(HitShape shp, size_t index, HitInd *coords) {
+	for (int d = hit_shapeDims(shp) - 1; d >= 0; d--) {
+		size_t card = (size_t)hit_shapeSigCard(shp, d);
+		coords[d]   = hit_shapeSig(shp, d).begin + (HitInd)(index % card);
+		index /= card;
+	}
+}
+
+/**
+ * @brief Advances global coordinates to the next cell of a region in row-major order.
+ * @param shp Region.
+ * @param[inout] coords Global coordinates of the cell.
+ */
+static void next_cell(HitShape shp, HitInd *coords) {
+	for (int d = hit_shapeDims(shp) - 1; d >= 0; d--) {
+		if (++coords[d] <= hit_shapeSig(shp, d).end)
+			return;
+		coords[d] = hit_shapeSig(shp, d).begin;
+	}
+}
+
+bool epsilod_mask_shape_active(HitShape shp) {
+	if (!validShape(shp))
+		return false;
+	if (!epsilod_mask_set())
+		return true;
+
+	int    dims = hit_shapeDims(shp);
+	size_t card = (size_t)hit_shapeCard(shp);
+	HitInd coords[EPSILOD_MAX_DIMS];
+	cell_coords(shp, 0, coords);
+	for (size_t k = 0; k < card; k++) {
+		if (mask.f_active(dims, coords, mask.arg))
+			return true;
+		next_cell(shp, coords);
+	}
+	return false;
+}
+
+void epsilod_mask_count(HitShape shp, int dim, double *counts) {
+	int    dims   = hit_shapeDims(shp);
+	HitInd origin = hit_shapeSig(shp, dim).begin;
+	size_t card   = (size_t)hit_shapeCard(shp);
+	memset(counts, 0, sizeof(double) * hit_shapeSigCard(shp, dim));
+
+	// Each process scans a consecutive range of cells
+	size_t begin = card * hit_Rank / hit_NProcs;
+	size_t end   = card * (hit_Rank + 1) / hit_NProcs;
+	HitInd coords[EPSILOD_MAX_DIMS];
+	if (begin < end)
+		cell_coords(shp, begin, coords);
+	for (size_t k = begin; k < end; k++) {
+		if (!epsilod_mask_set() || mask.f_active(dims, coords, mask.arg))
+			counts[coords[dim] - origin]++;
+		next_cell(shp, coords);
+	}
+
+	int ok = MPI_Allreduce(MPI_IN_PLACE, counts, hit_shapeSigCard(shp, dim), MPI_DOUBLE, MPI_SUM, hit_Comm);
+	hit_mpiTestError(ok, "Failed reducing the active cell counts");
+}
@@ -0,0 +1,59 @@
+/**
+ * @file epsilod_mask.h
+ * @brief Epsilod: Activity mask of domains with inactive regions
+ *
+ * @copyright This software is part of the EPSILOD project by Trasgo Group, UVa.
+ * The relevant license, warranty and copyright notice is available in the EPSILOD project repository.
+ */
+
+#ifndef _EPSILOD_MASK_H_
+#define _EPSILOD_MASK_H_
+
+#include "epsilod_structs.h"
+
+/**
+ * @brief Function that tells whether a cell of the domain is active.
+ * @param dims Number of dimensions of the domain.
+ * @param index Global coordinates of the cell, in the order of the array dimensions.
+ * @param arg Argument given to epsilod_set_activity_mask().
+ * @return true if the cell is updated by the kernel, false if it keeps its initial value.
+ */
+typedef bool (*activeCellFunction)(int dims, const HitInd *index, void *arg);
+
+/**
+ * @brief Declares the active cells of the domain.
+ * Regions without active cells are skipped: kernels are not launched on their compute tiles, and their halos
+ * are not communicated. Inactive cells must keep their initial value, so the initialization must set them
+ * in every local tile that contains them, halos included.
+ * The mask is not passed to the kernels: regions with some active cells are computed in full, so the kernel
+ * must also keep the value of the inactive cells in them.
+ * Weighted grid partitions balance the active cells instead of the whole domain.
+ * It must be called before stencilComputation().
+ * @param f_active Function that tells whether a cell is active. NULL removes the mask.
+ * @param arg Argument passed to \p f_active.
+ */
+void epsilod_set_activity_mask(activeCellFunction f_active, void *arg);
+
+/**
+ * @brief Whether an activity mask has been declared.
+ * @return true if epsilod_set_activity_mask() set a mask, false otherwise.
+ */
+bool epsilod_mask_set();
+
+/**
+ * @brief Whether a region contains active cells.
+ * @param shp Region in global coordinates.
+ * @return true if some cell is active or there is no mask, false otherwise. Null shapes are inactive.
+ */
+bool epsilod_mask_shape_active(HitShape shp);
+
+/**
+ * @brief Number of active cells in each index of a dimension of a region.
+ * The region is scanned in parallel by the processes of hit_Comm, so it must be called by all of them.
+ * @param shp Region in global coordinates.
+ * @param dim Dimension.
+ * @param[out] counts Active cells of each index of \p dim. Size the cardinality of \p shp in \p dim.
+ */
+void epsilod_mask_count(HitShape shp, int dim, double *counts);
+
+#endif // _EPSILOD_MASK_H_
@@ -0,0 +1,169 @@
+/**
+ * @file epsilod_progress.c
+ * @brief Epsilod: MPI progress engine for halo exchanges overlapped with computation
+ *
+ * @copyright This software is part of the EPSILOD project by Trasgo Group, UVa.
+ * The relevant license, warranty and copyright notice is available in the EPSILOD project repository.
+ */
+
+// Needed for pthread_setaffinity_np and the CPU_* macros
+#define _GNU_SOURCE
+
+#include <omp.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+#include "epsilod_progress.h"
+#include "epsilod_env.h"
+#include "epsilod_log.h"
+
+/**
+ * Tag probed by the progress engine. No message is sent with it,
+ * the probe is only used to enter the MPI library and advance pending transfers.
+ */
+#define EPSILOD_PROGRESS_PROBE_TAG 0x7e50
+
+/** Pause between two polls of the progress thread, in nanoseconds */
+#define EPSILOD_PROGRESS_POLL_NS 2000
+
+/**
+ * @brief State of the progress engine
+ */
+static struct {
+	pthread_t       thread;      /**< Progress thread */
+	pthread_mutex_t lock;        /**< Protects polling and stop */
+	pthread_cond_t  cond;        /**< Wakes up the progress thread */
+	bool            running;     /**< Whether the progress thread has been started */
+	bool            polling;     /**< Whether the progress thread should poll the MPI library */
+	bool            stop;        /**< Whether the progress thread should finish */
+	bool            outstanding; /**< Whether there are outstanding halo requests */
+} progress = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+};
+
+/**
+ * @brief Enters the MPI library once to advance pending transfers
+ */
+static inline void progress_probe() {
+	int flag;
+	MPI_Iprobe(MPI_ANY_SOURCE, EPSILOD_PROGRESS_PROBE_TAG, hit_Comm, &flag, MPI_STATUS_IGNORE);
+}
+
+/**
+ * @brief Progress thread main loop.
+ * Sleeps until there are outstanding requests, then polls the MPI library until they are completed.
+ */
+static void *progress_thread_main(void *arg) {
+	struct timespec pause = {0, EPSILOD_PROGRESS_POLL_NS};
+
+	pthread_mutex_lock(&progress.lock);
+	while (!progress.stop) {
+		if (!progress.polling) {
+			pthread_cond_wait(&progress.cond, &progress.lock);
+			continue;
+		}
+		pthread_mutex_unlock(&progress.lock);
+		progress_probe();
+		nanosleep(&pause, NULL);
+		pthread_mutex_lock(&progress.lock);
+	}
+	pthread_mutex_unlock(&progress.lock);
+	return NULL;
+}
+
+/**
+ * @brief Selects the core where the progress thread is pinned.
+ * Compact OpenMP placements fill the process affinity mask from its beginning,
+ * so the last core of the mask is the one less likely to be shared with compute threads.
+ * @return The core number, or -1 if the affinity mask cannot be queried.
+ */
+static int select_progress_core() {
+	int core = epsilod_progress_core();
+	if (core >= 0)
+		return core;
+
+	cpu_set_t mask;
+	if (sched_getaffinity(0, sizeof(mask), &mask) != 0)
+		return -1;
+
+	for (int cpu = CPU_SETSIZE - 1; cpu >= 0; cpu--) {
+		if (CPU_ISSET(cpu, &mask)) {
+			core = cpu;
+			break;
+		}
+	}
+	if (omp_get_max_threads() >= CPU_COUNT(&mask))
+		print_all("[%d] Warning: the MPI progress thread shares core %d with OpenMP threads. Consider reducing OMP_NUM_THREADS.\n", hit_Rank, core);
+	return core;
+}
+
+void epsilod_progress_init() {
+	if (!epsilod_progress_thread() || progress.running)
+		return;
+
+	int provided;
+	MPI_Query_thread(&provided);
+	if (provided < MPI_THREAD_MULTIPLE) {
+		print_once("Warning: EPSILOD_PROGRESS_THREAD requires MPI_THREAD_MULTIPLE. Progress is made from the host thread.\n");
+		return;
+	}
+
+	progress.stop    = false;
+	progress.polling = false;
+	if (pthread_create(&progress.thread, NULL, progress_thread_main, NULL) != 0) {
+		print_all("[%d] Warning: the MPI progress thread could not be created.\n", hit_Rank);
+		return;
+	}
+	progress.running = true;
+
+	int core = select_progress_core();
+	if (core >= 0) {
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(core, &set);
+		if (pthread_setaffinity_np(progress.thread, sizeof(set), &set) != 0)
+			print_all("[%d] Warning: the MPI progress thread could not be pinned to core %d.\n", hit_Rank, core);
+	}
+	print_once("Epsilod MPI progress thread: y\n");
+}
+
+void epsilod_progress_begin() {
+	progress.outstanding = true;
+	if (!progress.running)
+		return;
+
+	pthread_mutex_lock(&progress.lock);
+	progress.polling = true;
+	pthread_cond_signal(&progress.cond);
+	pthread_mutex_unlock(&progress.lock);
+}
+
+void epsilod_progress_end() {
+	progress.outstanding = false;
+	if (!progress.running)
+		return;
+
+	pthread_mutex_lock(&progress.lock);
+	progress.polling = false;
+	pthread_mutex_unlock(&progress.lock);
+}
+
+void epsilod_progress_poll() {
+	if (!progress.outstanding || progress.running)
+		return;
+	progress_probe();
+}
+
+void epsilod_progress_finalize() {
+	if (!progress.running)
+		return;
+
+	pthread_mutex_lock(&progress.lock);
+	progress.stop = true;
+	pthread_cond_signal(&progress.cond);
+	pthread_mutex_unlock(&progress.lock);
+	pthread_join(progress.thread, NULL);
+	progress.running = false;
+}
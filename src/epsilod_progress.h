@@ -0,0 +1,47 @@
+/**
+ * @file epsilod_progress.h
+ * @brief Epsilod: MPI progress engine for halo exchanges overlapped with computation
+ *
+ * @copyright This software is part of the EPSILOD project by Trasgo Group, UVa.
+ * The relevant license, warranty and copyright notice is available in the EPSILOD project repository.
+ */
+
+#ifndef _EPSILOD_PROGRESS_H_
+#define _EPSILOD_PROGRESS_H_
+
+#include "epsilod_structs.h"
+
+/**
+ * @brief Starts the progress thread if it is enabled by EPSILOD_PROGRESS_THREAD.
+ * The thread is pinned to EPSILOD_PROGRESS_CORE or, by default, to the last core of the process affinity mask,
+ * away from the cores used by a compact placement of the OpenMP threads.
+ * It requires MPI_THREAD_MULTIPLE support. Otherwise, a warning is printed and progress is made by polling
+ * from the host thread (see epsilod_progress_poll()).
+ */
+void epsilod_progress_init();
+
+/**
+ * @brief Marks the beginning of a phase with outstanding halo requests.
+ * The progress thread, if any, starts polling the MPI library.
+ */
+void epsilod_progress_begin();
+
+/**
+ * @brief Marks the end of a phase with outstanding halo requests.
+ * The progress thread, if any, goes back to sleep.
+ */
+void epsilod_progress_end();
+
+/**
+ * @brief Drives MPI progress from the host thread.
+ * Only acts when there are outstanding halo requests and no progress thread is running.
+ * It is cheap enough to be interleaved between kernel launches.
+ */
+void epsilod_progress_poll();
+
+/**
+ * @brief Stops and joins the progress thread, if any.
+ */
+void epsilod_progress_finalize();
+
+#endif
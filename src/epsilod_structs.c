@@ -7,8 +7,11 @@
  */
 
 #include "epsilod_structs.h"
+#include "epsilod_codec.h"
+#include "epsilod_components.h"
 #include "epsilod_env.h"
 #include "epsilod_log.h"
+#include "epsilod_mask.h"
 
 HitTile(EPSILOD_BASE_TYPE) EPSILOD_TILE_NULL = HIT_TILE_NULL_STATIC;
 
@@ -519,6 +522,46 @@ void calc_borderout_merge(int dims, HitShape *shp_border, int *merged_indexes) {
 	}
 }
 
+/**
+ * @brief Number of chunks in which a communication tile is split for pipelined host staging.
+ * It only depends on the tile shape, so sender and receiver of a halo obtain the same number.
+ * @param shp_border Shape of the communication tile.
+ * @param chunk_kb Chunk size in KiB. 0 to avoid splitting.
+ * @return Number of chunks, at least 1.
+ */
+int count_halo_chunks(HitShape shp_border, int chunk_kb) {
+	if (chunk_kb == 0 || hit_shapeCmp(shp_border, HIT_SHAPE_NULL))
+		return 1;
+
+	size_t bytes       = (size_t)hit_shapeCard(shp_border) * sizeof(EPSILOD_BASE_TYPE);
+	size_t chunk_bytes = (size_t)chunk_kb * 1024;
+	int    chunks      = (int)((bytes + chunk_bytes - 1) / chunk_bytes);
+
+	// Chunks are slices of the first dimension to keep them contiguous
+	int max_chunks = (int)hit_shapeSigCard(shp_border, 0);
+	if (max_chunks > EPSILOD_MAX_HALO_CHUNKS)
+		max_chunks = EPSILOD_MAX_HALO_CHUNKS;
+	if (chunks > max_chunks)
+		chunks = max_chunks;
+	return chunks < 1 ? 1 : chunks;
+}
+
+/**
+ * @brief Creates a shape spanning a chunk of a communication tile.
+ * @param shp_border Shape of the communication tile.
+ * @param chunk Chunk index.
+ * @param num_chunks Number of chunks of the tile.
+ * @return Shape of the chunk, a slice of the first dimension.
+ */
+HitShape create_shape_chunk(HitShape shp_border, int chunk, int num_chunks) {
+	int card  = hit_shapeSigCard(shp_border, 0);
+	int begin = chunk * card / num_chunks;
+	int end   = (chunk + 1) * card / num_chunks;
+
+	HitShape shp_chunk = hit_shapeTransform(shp_border, 0, HIT_SHAPE_BEGIN, begin);
+	return hit_shapeTransform(shp_chunk, 0, HIT_SHAPE_END, -(card - end));
+}
+
 // TODO @seralpa these need better names
 /**
  * @brief Packs the necessary data to work out global data coordinates from local thread indexes within a tile and the stencil's border sizes.
@@ -540,6 +583,15 @@ EpsilodCoords build_coords(HitTile(EPSILOD_BASE_TYPE) tile, EpsilodBorders borde
 	return coords;
 }
 
+void forget_halo_shadows(EpsilodTiles *p_tiles) {
+	if (p_tiles->halo_shadows == NULL)
+		return;
+	for (int i = 0; i < epsilod_num_borders(hit_tileDims(p_tiles->mat)) * p_tiles->max_halo_chunks; i++) {
+		free(p_tiles->halo_shadows[i]);
+		p_tiles->halo_shadows[i] = NULL;
+	}
+}
+
 void free_epsilod_tiles(EpsilodTiles *p_tiles) {
 	int dims = hit_tileDims(p_tiles->mat);
 	Ctrl_Free(NULL, p_tiles->mat, p_tiles->inner, p_tiles->io);
@@ -558,11 +610,33 @@ void free_epsilod_tiles(EpsilodTiles *p_tiles) {
 		Ctrl_Free(NULL, p_tiles->border_out_dev[i][0], p_tiles->border_out_dev[i][1]);
 	}
 	hit_patternFree(&(p_tiles->neighSync));
+	for (int i = 0; i < 2 * epsilod_num_borders(dims); i++) {
+		if (p_tiles->num_halo_chunks[i] == 1)
+			continue;
+		for (int c = 0; c < p_tiles->num_halo_chunks[i]; c++) {
+			Ctrl_Free(NULL, p_tiles->halo_chunks[i * p_tiles->max_halo_chunks + c]);
+		}
+	}
+	free(p_tiles->halo_chunks);
+	free(p_tiles->num_halo_chunks);
+	free(p_tiles->halo_requests);
+	if (p_tiles->codec_buffers != NULL) {
+		for (int i = 0; i < 2 * epsilod_num_borders(dims); i++) {
+			free(p_tiles->codec_buffers[i]);
+		}
+		free(p_tiles->codec_buffers);
+	}
+	if (p_tiles->halo_shadows != NULL) {
+		forget_halo_shadows(p_tiles);
+		free(p_tiles->halo_shadows);
+	}
 
 	if (comms_contiguous_buffers()) {
 		free(p_tiles->cont_border_in);
 		free(p_tiles->cont_border_out);
 	}
+	free(p_tiles->cont_mask_in);
+	free(p_tiles->cont_mask_out);
 	free(p_tiles->border_in);
 	free(p_tiles->border_out);
 	free(p_tiles->comms_border_in);
@@ -633,8 +707,136 @@ void set_active_borders_bystencil(EpsilodCommArgs comm_args, HitTile_float stenc
 	}
 }
 
+void partition_dims_order(int dims, int *order) {
+	PartitionInfo info = get_partition_info(dims);
+	bool          skip = info.type == EPSILOD_PARTITION_NOT_DIM;
+
+	int pos = 0;
+	for (int i = 0; i < dims; i++) {
+		if (!skip || i != info.dim)
+			order[pos++] = i;
+	}
+	if (skip)
+		order[pos] = info.dim;
+}
+
+HitShape shape_reorder(HitShape shp, const int *order, bool inverse) {
+	HitShape res = shp;
+	for (int i = 0; i < hit_shapeDims(shp); i++) {
+		if (inverse)
+			hit_shapeSig(res, order[i]) = hit_shapeSig(shp, i);
+		else
+			hit_shapeSig(res, i) = hit_shapeSig(shp, order[i]);
+	}
+	return res;
+}
+
+/**
+ * @brief Estimated cost of the halos exchanged by a process with a given grid of processes.
+ * Each active border with a neighbour in the grid contributes the bytes of its halo.
+ * Halos that are not contiguous in the local tile are weighted by EPSILOD_AUTO_PACK_WEIGHT, as they are packed and unpacked.
+ * @param dims The number of dimensions of the domain.
+ * @param shp_inner Shape to distribute.
+ * @param borders Stencil border sizes.
+ * @param active Active borders, as computed by set_active_borders_bystencil().
+ * @param card Number of processes in each dimension of the domain.
+ * @return The cost, or a negative value if some block is smaller than the borders.
+ */
+static double partition_halo_cost(int dims, HitShape shp_inner, EpsilodBorders borders, const bool *active, const int *card) {
+	HitInd block[EPSILOD_MAX_DIMS];
+	for (int d = 0; d < dims; d++) {
+		block[d] = (hit_shapeSigCard(shp_inner, d) + card[d] - 1) / card[d];
+		if (card[d] > 1 && (hit_shapeSigCard(shp_inner, d) / card[d] < borders.low[d] || hit_shapeSigCard(shp_inner, d) / card[d] < borders.high[d]))
+			return -1;
+	}
+
+	double cost = 0;
+	for (int b = 0; b < epsilod_num_borders(dims); b++) {
+		if (!active[b])
+			continue;
+
+		int shift[EPSILOD_MAX_DIMS];
+		int digits = b;
+		for (int d = dims - 1; d >= 0; d--) {
+			shift[d] = digits % 3 - 1;
+			digits /= 3;
+		}
+
+		// Halo extents. Borders without a neighbour in some displaced dimension are not communicated
+		double cells      = 1;
+		bool   neighbour  = true;
+		bool   contiguous = true;
+		bool   spread     = false;
+		for (int d = 0; d < dims; d++) {
+			HitInd extent = block[d];
+			if (shift[d] != 0) {
+				extent    = (shift[d] < 0) ? borders.low[d] : borders.high[d];
+				neighbour = neighbour && card[d] > 1;
+			}
+			// Row-major: after the first dimension with several indexes, the halo must span the whole tile
+			if (spread && extent != block[d] + borders.low[d] + borders.high[d])
+				contiguous = false;
+			spread = spread || extent > 1;
+			cells *= extent;
+		}
+		if (neighbour)
+			cost += cells * sizeof(EPSILOD_BASE_TYPE) * (contiguous ? 1 : 1 + EPSILOD_AUTO_PACK_WEIGHT);
+	}
+	return cost;
+}
+
+PartitionInfo select_auto_partition(HitShape shp_inner, EpsilodBorders borders, HitTile_float stencil) {
+	int  dims        = hit_shapeDims(shp_inner);
+	int  num_borders = epsilod_num_borders(dims);
+	bool border_in_active[num_borders];
+	bool border_out_active[num_borders];
+
+	EpsilodCommArgs comm_args   = {0};
+	comm_args.border_in_active  = border_in_active;
+	comm_args.border_out_active = border_out_active;
+	set_active_borders_bystencil(comm_args, stencil);
+
+	// Candidates: partitions whose topology can be built by the Hitmap plug-ins
+	PartitionInfo candidates[3 * EPSILOD_MAX_DIMS];
+	int           num_candidates = 0;
+	for (int k = 1; k <= dims; k++)
+		candidates[num_candidates++] = (PartitionInfo){.type = EPSILOD_PARTITION_MULTI_DIM, .dims = k, .dim = -1};
+	for (int d = 1; d < dims; d++)
+		candidates[num_candidates++] = (PartitionInfo){.type = EPSILOD_PARTITION_SINGLE_DIM, .dims = 1, .dim = d};
+	for (int d = 0; d < dims - 1 && dims > 2; d++)
+		candidates[num_candidates++] = (PartitionInfo){.type = EPSILOD_PARTITION_NOT_DIM, .dims = dims - 1, .dim = d};
+
+	PartitionInfo best      = candidates[0];
+	double        best_cost = -1;
+	for (int c = 0; c < num_candidates; c++) {
+		// Balanced factorisation of the processes, as in the array topology
+		int topo_card[EPSILOD_MAX_DIMS] = {0};
+		MPI_Dims_create(hit_NProcs, candidates[c].dims, topo_card);
+
+		int card[EPSILOD_MAX_DIMS];
+		int pos = 0;
+		for (int d = 0; d < dims; d++) {
+			bool partitioned;
+			switch (candidates[c].type) {
+				case EPSILOD_PARTITION_SINGLE_DIM: partitioned = d == candidates[c].dim; break;
+				case EPSILOD_PARTITION_NOT_DIM: partitioned = d != candidates[c].dim; break;
+				default: partitioned = d < candidates[c].dims; break;
+			}
+			card[d] = partitioned ? topo_card[pos++] : 1;
+		}
+
+		double cost = partition_halo_cost(dims, shp_inner, borders, border_in_active, card);
+		if (cost >= 0 && (best_cost < 0 || cost < best_cost)) {
+			best      = candidates[c];
+			best_cost = cost;
+		}
+	}
+	return best;
+}
+
 /**
  * @brief Generates neighbour processor coordinate displacements (shifts).
+ * Shifts follow the order of the domain dimensions. @see layout_neighbor()
  * This function expects border status based on stencil data
  * @param[inout] comm_args Communications related data to update.
  * @param lay HitLayout
@@ -665,6 +867,24 @@ void set_shifts(EpsilodCommArgs comm_args, HitLayout lay) {
 	}
 }
 
+/**
+ * @brief Locates the neighbour in the direction of a shift.
+ * Shifts follow the domain dimensions, that are reordered to the topology dimensions. @see partition_dims_order()
+ * @param lay The layout used to locate the neighbour.
+ * @param shift Displacement to the neighbour, in the order of the domain dimensions.
+ * @return The ranks of the neighbour, or ranks with HIT_RANK_NULL if there is none.
+ */
+static HitRanks layout_neighbor(HitLayout lay, HitRanks shift) {
+	int dims = hit_layNumDims(lay);
+	int order[EPSILOD_MAX_DIMS];
+	partition_dims_order(dims, order);
+
+	HitRanks topo_shift = shift;
+	for (int j = 0; j < dims; j++)
+		topo_shift.rank[j] = shift.rank[order[j]];
+	return hit_layNeighborN(lay, topo_shift);
+}
+
 /**
  * @brief Marks borders as inactive based on the absence of neighbouring processes.
  * @param[inout] p_border_in_active Array to update indicating if borders are active.
@@ -679,19 +899,89 @@ void deactivate_empty_neighbors(bool *p_border_active, HitLayout lay, HitRanks *
 			continue;
 
 		// Deactivate borders without neighbor
-		HitRanks neigh = hit_layNeighborN(lay, shifts[i]);
+		HitRanks neigh = layout_neighbor(lay, shifts[i]);
 		if (neigh.rank[0] == HIT_RANK_NULL) {
 			p_border_active[i] = false;
 		}
 	}
 }
 
+/**
+ * @brief Translates the displacement to a neighbour into its rank in hit_Comm.
+ * @param lay The layout used to locate the neighbour.
+ * @param lay_group Group of the layout communicator.
+ * @param global_group Group of hit_Comm.
+ * @param active Whether the border is active.
+ * @param shift Displacement to the neighbour.
+ * @return The rank of the neighbour, or MPI_PROC_NULL if the border is not active.
+ */
+int neighbor_global_rank(HitLayout lay, MPI_Group lay_group, MPI_Group global_group, bool active, HitRanks shift) {
+	if (!active)
+		return MPI_PROC_NULL;
+
+	HitRanks neigh = layout_neighbor(lay, shift);
+	if (neigh.rank[0] == HIT_RANK_NULL)
+		return MPI_PROC_NULL;
+
+	int lay_rank = hit_topRankInternal(lay.topo, hit_layToTopoRanks(lay, neigh));
+	int global_rank;
+	MPI_Group_translate_ranks(lay_group, 1, &lay_rank, global_group, &global_rank);
+	return global_rank;
+}
+
+/**
+ * @brief Sets the ranks of the neighbours in hit_Comm.
+ * They are used in communications issued outside Hitmap patterns.
+ * This function expects borders already deactivated by the absence of neighbours.
+ * @param[inout] comm_args Communications related data to update.
+ * @param lay The layout used to locate neighbours.
+ */
+void set_neighbor_ranks(EpsilodCommArgs comm_args, HitLayout lay) {
+	MPI_Group lay_group, global_group;
+	MPI_Comm_group(lay.pTopology[0]->comm, &lay_group);
+	MPI_Comm_group(hit_Comm, &global_group);
+
+	for (int i = 0; i < epsilod_num_borders(hit_layNumDims(lay)); i++) {
+		comm_args.ranks_in[i]  = neighbor_global_rank(lay, lay_group, global_group, comm_args.border_in_active[i], comm_args.shifts_in[i]);
+		comm_args.ranks_out[i] = neighbor_global_rank(lay, lay_group, global_group, comm_args.border_out_active[i], comm_args.shifts_out[i]);
+	}
+
+	MPI_Group_free(&lay_group);
+	MPI_Group_free(&global_group);
+}
+
+/**
+ * @brief Marks borders as inactive when their halos have no active cells.
+ * Inactive cells never change, so the halo keeps its initial value. Sender and receiver evaluate the mask on the same cells.
+ * @param[inout] comm_args Communications related data to update.
+ * @param lay The layout.
+ * @param stencil The stencil tile. Used to get the border sizes.
+ */
+void deactivate_inactive_halos(EpsilodCommArgs comm_args, HitLayout lay, HitTile_float stencil) {
+	int            dims = hit_layNumDims(lay);
+	EpsilodBorders borders;
+	for (int j = 0; j < dims; j++) {
+		borders.low[j]  = -hit_tileDimBegin(stencil, j);
+		borders.high[j] = hit_tileDimEnd(stencil, j);
+	}
+
+	for (int i = 0; i < epsilod_num_borders(dims); i++) {
+		if (comm_args.border_in_active[i] && !epsilod_mask_shape_active(create_shape_borderin(lay.shape, true, borders, comm_args.shifts_in[i])))
+			comm_args.border_in_active[i] = false;
+		if (comm_args.border_out_active[i] && !epsilod_mask_shape_active(create_shape_borderout(lay.shape, true, borders, comm_args.shifts_in[i])))
+			comm_args.border_out_active[i] = false;
+	}
+}
+
 void init_comm_args(EpsilodCommArgs *p_comm_args, HitTile_float stencil, HitLayout lay) {
 
 	set_active_borders_bystencil(*p_comm_args, stencil);
 	set_shifts(*p_comm_args, lay);
 	deactivate_empty_neighbors(p_comm_args->border_in_active, lay, p_comm_args->shifts_in);
 	deactivate_empty_neighbors(p_comm_args->border_out_active, lay, p_comm_args->shifts_out);
+	if (epsilod_mask_set())
+		deactivate_inactive_halos(*p_comm_args, lay, stencil);
+	set_neighbor_ranks(*p_comm_args, lay);
 }
 
 EpsilodTiles *create_tiles(PCtrl comm, HitLayout lay, HitTile(EPSILOD_BASE_TYPE) * global_mat, EpsilodBorders borders, EpsilodCommArgs comm_args) {
@@ -706,6 +996,7 @@ EpsilodTiles *create_tiles(PCtrl comm, HitLayout lay, HitTile(EPSILOD_BASE_TYPE)
 	p_tiles->inner         = create_tile_inner(&p_tiles->mat, lay, p_border_out_active, borders);
 	p_tiles->inner_compute = create_tile_inner_compute(&p_tiles->mat, &p_tiles->inner);
 	p_tiles->io            = create_tile_io(&p_tiles->mat, *global_mat, borders);
+	p_tiles->inner_active  = epsilod_mask_shape_active(p_tiles->inner.shape);
 
 	HitShape *p_shp_border_in  = malloc(sizeof(HitShape) * num_borders);
 	HitShape *p_shp_border_out = malloc(sizeof(HitShape) * num_borders);
@@ -741,6 +1032,22 @@ EpsilodTiles *create_tiles(PCtrl comm, HitLayout lay, HitTile(EPSILOD_BASE_TYPE)
 		}
 	}
 
+	// Components carried by each contiguous buffer, including the borders merged into it
+	p_tiles->cont_mask_in  = NULL;
+	p_tiles->cont_mask_out = NULL;
+	if (contiguous && comm_args.border_masks != NULL) {
+		p_tiles->cont_mask_in  = calloc(num_borders, sizeof(EpsilodComponentMask));
+		p_tiles->cont_mask_out = calloc(num_borders, sizeof(EpsilodComponentMask));
+		for (int i = 0; i < num_borders; i++) {
+			int to_in  = border_in_merge_to[i];
+			int to_out = border_out_merge_to[i];
+			if (p_border_in_active[i])
+				p_tiles->cont_mask_in[to_in] = epsilod_mask_union(p_tiles->cont_mask_in[to_in], comm_args.border_masks[i]);
+			if (p_border_out_active[i])
+				p_tiles->cont_mask_out[to_out] = epsilod_mask_union(p_tiles->cont_mask_out[to_out], comm_args.border_masks[i]);
+		}
+	}
+
 	// TODO @seralpa consider making fn build only one tile
 	p_tiles->border_out_dev = malloc(sizeof(HitTile(EPSILOD_BASE_TYPE)) * dims * 2);
 	create_tile_borderoutdev(p_tiles, lay, p_border_out_active, borders);
@@ -758,6 +1065,70 @@ EpsilodTiles *create_tiles(PCtrl comm, HitLayout lay, HitTile(EPSILOD_BASE_TYPE)
 		}
 	}
 
+	// Communication tiles split in chunks for pipelined host staging. Encoded halos are not split
+	int chunk_kb = (contiguous && epsilod_get_halo_codec() == NULL) ? epsilod_halo_chunk_kb() : 0;
+
+	p_tiles->num_halo_chunks = malloc(sizeof(int) * 2 * num_borders);
+	p_tiles->max_halo_chunks = 1;
+	for (int i = 0; i < num_borders; i++) {
+		p_tiles->num_halo_chunks[i]               = count_halo_chunks(p_shp_border_in[i], chunk_kb);
+		p_tiles->num_halo_chunks[num_borders + i] = count_halo_chunks(p_shp_border_out[i], chunk_kb);
+	}
+	for (int i = 0; i < 2 * num_borders; i++) {
+		if (p_tiles->num_halo_chunks[i] > p_tiles->max_halo_chunks)
+			p_tiles->max_halo_chunks = p_tiles->num_halo_chunks[i];
+	}
+
+	int max_chunks       = p_tiles->max_halo_chunks;
+	p_tiles->halo_chunks = malloc(sizeof(HitTile(EPSILOD_BASE_TYPE)) * 2 * num_borders * max_chunks);
+	for (int i = 0; i < num_borders; i++) {
+		HitTile(EPSILOD_BASE_TYPE) *chunks_in  = &p_tiles->halo_chunks[i * max_chunks];
+		HitTile(EPSILOD_BASE_TYPE) *chunks_out = &p_tiles->halo_chunks[(num_borders + i) * max_chunks];
+		int num_chunks_in                      = p_tiles->num_halo_chunks[i];
+		int num_chunks_out                     = p_tiles->num_halo_chunks[num_borders + i];
+		for (int c = 0; c < max_chunks; c++) {
+			chunks_in[c]  = EPSILOD_TILE_NULL;
+			chunks_out[c] = EPSILOD_TILE_NULL;
+		}
+
+		chunks_in[0]  = p_tiles->comms_border_in[i];
+		chunks_out[0] = p_tiles->comms_border_out[i];
+		if (num_chunks_in > 1) {
+			for (int c = 0; c < num_chunks_in; c++)
+				chunks_in[c] = Ctrl_Select(EPSILOD_BASE_TYPE, p_tiles->cont_border_in[border_in_merge_to[i]], create_shape_chunk(p_shp_border_in[i], c, num_chunks_in), CTRL_SELECT_ARR_COORD);
+		}
+		if (num_chunks_out > 1) {
+			for (int c = 0; c < num_chunks_out; c++)
+				chunks_out[c] = Ctrl_Select(EPSILOD_BASE_TYPE, p_tiles->cont_border_out[border_out_merge_to[i]], create_shape_chunk(p_shp_border_out[i], c, num_chunks_out), CTRL_SELECT_ARR_COORD);
+		}
+	}
+
+	// Requests for communications issued outside Hitmap patterns
+	p_tiles->halo_requests = malloc(sizeof(MPI_Request) * 2 * num_borders * max_chunks);
+	for (int i = 0; i < 2 * num_borders * max_chunks; i++) {
+		p_tiles->halo_requests[i] = MPI_REQUEST_NULL;
+	}
+
+	// Buffers for encoded halo messages
+	EpsilodCodec *codec    = epsilod_get_halo_codec();
+	p_tiles->codec_buffers = NULL;
+	if (codec != NULL) {
+		p_tiles->codec_buffers = malloc(sizeof(void *) * 2 * num_borders);
+		for (int i = 0; i < num_borders; i++) {
+			size_t bytes_in  = (size_t)hit_tileCard(p_tiles->comms_border_in[i]) * sizeof(EPSILOD_BASE_TYPE);
+			size_t bytes_out = (size_t)hit_tileCard(p_tiles->comms_border_out[i]) * sizeof(EPSILOD_BASE_TYPE);
+
+			p_tiles->codec_buffers[i]               = p_border_in_active[i] ? malloc(codec->bound(bytes_in)) : NULL;
+			p_tiles->codec_buffers[num_borders + i] = p_border_out_active[i] ? malloc(codec->bound(bytes_out)) : NULL;
+		}
+	}
+
+	// Copies of the last halos sent, allocated on the first send of each chunk
+	p_tiles->halo_shadows = NULL;
+	if (contiguous && epsilod_skip_unchanged_halos()) {
+		p_tiles->halo_shadows = calloc((size_t)num_borders * max_chunks, sizeof(void *));
+	}
+
 	free(p_shp_border_in);
 	free(p_shp_border_in_expanded);
 	free(p_shp_border_out);
@@ -800,12 +1171,13 @@ HitPattern create_comm_pattern(PCtrl comm, EpsilodTiles *p_tiles, EpsilodCommArg
 		HitRanks neigh_in  = HIT_RANKS_NULL;
 		HitRanks neigh_out = HIT_RANKS_NULL;
 		if (border_in_active[i])
-			neigh_in = hit_layNeighborN(lay, comm_args.shifts_in[i]);
+			neigh_in = layout_neighbor(lay, comm_args.shifts_in[i]);
 		if (border_out_active[i])
-			neigh_out = hit_layNeighborN(lay, comm_args.shifts_out[i]);
+			neigh_out = layout_neighbor(lay, comm_args.shifts_out[i]);
 
 		// Add comms to the patterns
-		hit_patternAdd(&pattern, hit_comSendRecv(lay, neigh_out, &(p_tiles->comms_border_out[i]), neigh_in, &(p_tiles->comms_border_in[i]), HIT_CELL));
+		HitType cell_type = comm_args.border_types == NULL ? HIT_CELL : comm_args.border_types[i];
+		hit_patternAdd(&pattern, hit_comSendRecv(lay, neigh_out, &(p_tiles->comms_border_out[i]), neigh_in, &(p_tiles->comms_border_in[i]), cell_type));
 
 		// Annotate the index of the border in the pattern
 		comm_args.index_comm_border[indexCommBorderCount++] = i;
@@ -966,3 +1338,10 @@ EpsilodThreads get_chars(int dims, Ctrl_Type ctrl_type, EpsilodTiles tiles) {
 
 	return chars;
 }
+
+void free_threads(EpsilodThreads *p_threads) {
+	free(p_threads->cont_border_in);
+	free(p_threads->cont_border_out);
+	p_threads->cont_border_in  = NULL;
+	p_threads->cont_border_out = NULL;
+}
@@ -39,6 +39,15 @@ Ctrl_NewType(double);
 
 Ctrl_NewType(EPSILOD_BASE_TYPE);
 
+/* Scalar type and number of the components of a cell. Non compound cells have a single component */
+#if CTRL_COUNTPARAM(EPSILOD_BASE_TYPE_COMPOUND) == 2
+#define EPSILOD_SCALAR_TYPE  EPSILOD_GET_COMPOUND_TYPE(EPSILOD_BASE_TYPE_COMPOUND)
+#define EPSILOD_SCALAR_COUNT EPSILOD_GET_COMPOUND_COUNT(EPSILOD_BASE_TYPE_COMPOUND)
+#else // CTRL_COUNTPARAM(EPSILOD_BASE_TYPE_COMPOUND) < 2
+#define EPSILOD_SCALAR_TYPE  EPSILOD_BASE_TYPE
+#define EPSILOD_SCALAR_COUNT 1
+#endif // CTRL_COUNTPARAM(EPSILOD_BASE_TYPE_COMPOUND)
+
 /* Special functions definition. */
 typedef void (*stencilDeviceFunction)(PCtrl, Ctrl_Thread, Ctrl_Thread, int, HitTile(EPSILOD_BASE_TYPE), HitTile(EPSILOD_BASE_TYPE), EpsilodCoords, HitTile(float), float, Epsilod_ext *);
 typedef void (*initDataDeviceFunction)(PCtrl, Ctrl_Thread, Ctrl_Thread, int, HitTile(EPSILOD_BASE_TYPE), EpsilodCoords, Epsilod_ext *);
@@ -61,6 +70,15 @@ typedef struct EpsilodTiles {
 	HitTile(EPSILOD_BASE_TYPE) * comms_border_in;    /**< Communication tiles for inbound halos. Selections of buffer borders. Size 3^dims. */
 	HitTile(EPSILOD_BASE_TYPE) * comms_border_out;   /**< Communication tiles for outbound borders. Selections of buffer borders. Size 3^dims. */
 	HitPattern neighSync;                            /**< Communication pattern for this set of tiles */
+	MPI_Request *halo_requests;                      /**< Requests of halo exchanges issued outside Hitmap patterns, one per chunk. Receives first, then sends. Size 2*3^dims*max_halo_chunks */
+	HitTile(EPSILOD_BASE_TYPE) * halo_chunks;        /**< Communication tiles split along the first dimension for pipelined host staging. Inbound first, then outbound. Size 2*3^dims*max_halo_chunks */
+	int         *num_halo_chunks;                    /**< Number of chunks of each communication tile. Inbound first, then outbound. Size 2*3^dims */
+	int          max_halo_chunks;                    /**< Maximum number of chunks of a communication tile. Stride of halo_chunks and halo_requests */
+	void       **codec_buffers;                      /**< Encoded halo messages. Receives first, then sends. Size 2*3^dims. NULL if halos are not encoded */
+	void       **halo_shadows;                       /**< Contents of each outbound chunk in its last send, NULL before the first one. Size 3^dims*max_halo_chunks. NULL if unchanged halos are sent */
+	EpsilodComponentMask *cont_mask_in;              /**< Components received in each inbound buffer, merged borders included. Size 3^dims. NULL if cells are communicated whole */
+	EpsilodComponentMask *cont_mask_out;             /**< Components sent from each outbound buffer, merged borders included. Size 3^dims. NULL if cells are communicated whole */
+	bool                  inner_active;              /**< Whether the inner region has active cells. @see epsilod_set_activity_mask() */
 } EpsilodTiles;
 
 /**
@@ -89,13 +107,32 @@ typedef struct EpsilodGlobalCoords {
  * @brief Data needed in tile communications
  */
 typedef struct EpsilodCommArgs {
-	bool     *border_in_active;  /**< Whether inbound halos are active. Size 3^dims */
-	bool     *border_out_active; /**< Whether outbound borders are active. Size 3^dims */
-	HitRanks *shifts_in;         /**< HitRanks list, displacements to neighbors from which data is received.*/
-	HitRanks *shifts_out;        /**< HitRanks list, displacements to neighbors to which data is sent.*/
-	int      *index_comm_border; /**< An array of index ids for borders involved in communications. Size 3^dims */
+	bool                 *border_in_active;  /**< Whether inbound halos are active. Size 3^dims */
+	bool                 *border_out_active; /**< Whether outbound borders are active. Size 3^dims */
+	HitRanks             *shifts_in;         /**< HitRanks list, displacements to neighbors from which data is received.*/
+	HitRanks             *shifts_out;        /**< HitRanks list, displacements to neighbors to which data is sent.*/
+	int                  *index_comm_border; /**< An array of index ids for borders involved in communications. Size 3^dims */
+	int                  *ranks_in;          /**< Ranks in hit_Comm of the neighbors from which data is received, or MPI_PROC_NULL. Size 3^dims */
+	int                  *ranks_out;         /**< Ranks in hit_Comm of the neighbors to which data is sent, or MPI_PROC_NULL. Size 3^dims */
+	HitType               cell_type;         /**< MPI type of domain cells */
+	EpsilodComponentMask *border_masks;      /**< Components of the cells communicated in each border. Size 3^dims */
+	HitType              *border_types;      /**< MPI type of the cells communicated in each border. cell_type if they are communicated whole. Size 3^dims */
 } EpsilodCommArgs;
 
+/** Maximum number of chunks of a halo in pipelined host staging */
+#define EPSILOD_MAX_HALO_CHUNKS 64
+
+/**
+ * Tag of the halo messages of a border in communications issued outside Hitmap patterns.
+ * Sender and receiver use the same border index, and split halos in the same number of chunks.
+ * Chunks of a border are spaced by the maximum number of borders, 3^EPSILOD_MAX_DIMS.
+ * @hideinitializer
+ *
+ * @param border Border index
+ * @param chunk Chunk index
+ */
+#define EPSILOD_HALO_TAG(border, chunk) (0x4500 + (chunk) * 81 + (border))
+
 /**
  * @brief Enumeration of the different methods of domain partition
  */
@@ -104,6 +141,8 @@ typedef enum PartitionType {
 	EPSILOD_PARTITION_SINGLE_DIM,
 	EPSILOD_PARTITION_NOT_DIM,
 	EPSILOD_PARTITION_WEIGHTED,
+	EPSILOD_PARTITION_WEIGHTED_GRID,
+	EPSILOD_PARTITION_AUTO,
 } PartitionType;
 
 /**
@@ -123,6 +162,7 @@ typedef enum EpsilodCommMethod {
 	HOST_WAITANY,
 	HOST_WAITANY_RECVFIRST,
 	HOST_WAITALL,
+	HOST_EARLY_RECV, /**< Halo receives are posted before computing. Requires contiguous buffers */
 } EpsilodCommMethod;
 
 /**
@@ -134,15 +174,56 @@ typedef enum EpsilodMemAlignMode {
 	EPSILOD_MEM_ALIGN_THREADS, /**< Epsilod's tile's last dimension is memory aligned. In addition it attempts to align device threads to the memory region by extending the inner tile in the last dimension */
 } EpsilodMemAlignMode;
 
+/**
+ * Communication settings that can be selected at runtime
+ */
+typedef struct EpsilodCommConfig {
+	EpsilodCommMethod   method;     /**< Host staging communication method. Unused with device-aware MPI */
+	bool                contiguous; /**< Whether separate contiguous buffers are used for communications */
+	EpsilodMemAlignMode align;      /**< Memory alignment mode */
+	bool                dev_aware;  /**< Whether device-aware MPI is used for communications */
+} EpsilodCommConfig;
+
+/**
+ * Communication settings set to \e auto in the environment. Bit flags
+ */
+typedef enum EpsilodCommAuto {
+	EPSILOD_AUTO_COMM_METHOD = 1 << 0, /**< EPSILOD_COMM_METHOD=auto */
+	EPSILOD_AUTO_CONTIGUOUS  = 1 << 1, /**< EPSILOD_COMMS_CONTIGUOUS_BUFFERS=auto */
+	EPSILOD_AUTO_ALIGN       = 1 << 2, /**< EPSILOD_ALIGN=auto */
+	EPSILOD_AUTO_DEV_AWARE   = 1 << 3, /**< EPSILOD_MPI_DEV_AWARE=auto */
+} EpsilodCommAuto;
+
 /**
  * EPSILOD IO file mode
  */
 typedef enum IOTileMode {
-	EPSILOD_FILE_NONE,  /**< Data is not read/written from/to a file */
-	EPSILOD_FILE_ARRAY, /**< Data is read/written in Tile mode. @see HIT_FILE_ARRAY */
-	EPSILOD_FILE_TILE,  /**< Data is read/written in Array mode. @see HIT_FILE_TILE */
+	EPSILOD_FILE_NONE,    /**< Data is not read/written from/to a file */
+	EPSILOD_FILE_ARRAY,   /**< Data is read/written in Tile mode. @see HIT_FILE_ARRAY */
+	EPSILOD_FILE_TILE,    /**< Data is read/written in Array mode. @see HIT_FILE_TILE */
+	EPSILOD_FILE_MPIIO,   /**< Data is read/written in a raw binary file of the whole array, with collective MPI-IO */
+	EPSILOD_FILE_CHUNKED, /**< Data is read/written in a chunked binary file with a header. @see EpsilodChunkedHeader */
 } IOTileMode;
 
+/**
+ * EPSILOD compressor of the chunked file mode
+ */
+typedef enum EpsilodChunkCodec {
+	EPSILOD_CHUNK_CODEC_NONE, /**< Chunks are stored as they are */
+	EPSILOD_CHUNK_CODEC_LZ4,  /**< Blocks are byte shuffled and compressed with LZ4. @see EpsilodChunkedBlock */
+	EPSILOD_CHUNK_CODEC_ZSTD, /**< Blocks are byte shuffled and compressed with zstd. @see EpsilodChunkedBlock */
+} EpsilodChunkCodec;
+
+/**
+ * Parts of the time of an iteration in a process, in seconds
+ */
+typedef struct EpsilodIterTimes {
+	double compute;  /**< Kernels of the inner region and the borders */
+	double pack;     /**< Packing and unpacking kernels of the contiguous buffers */
+	double transfer; /**< Waits for the DtoH and HtoD transfers of the halos */
+	double wait;     /**< Interprocess communications, including the waits for the neighbours */
+} EpsilodIterTimes;
+
 /**
  * @brief Frees the space used by tile data
  * Frees the tiles, the lists of tiles in the structure (borders) and the structure itself
@@ -150,6 +231,13 @@ typedef enum IOTileMode {
  */
 void free_epsilod_tiles(EpsilodTiles *p_tiles);
 
+/**
+ * @brief Forgets the contents of the last halos sent, so the next exchange sends every halo.
+ * Needed when a neighbour gets new tiles, as its buffers no longer hold those halos.
+ * @param p_tiles Pointer to the tiles
+ */
+void forget_halo_shadows(EpsilodTiles *p_tiles);
+
 /**
  * @brief A helper structure to compare border tiles.
  * Stores the border index and the corresponding tile.
@@ -182,6 +270,38 @@ typedef struct CommCompIndex {
 		b         = SWAP; \
 	} while (0)
 
+/**
+ * @brief Order of the domain dimensions in the processes topology.
+ * The dimension skipped by EPSILOD_PARTITION_NOT_DIM is moved after the topology dimensions, so it is not partitioned.
+ * Other partitions keep the domain order.
+ * @param dims The number of dimensions of the domain.
+ * @param[out] order Domain dimension of each topology position. Size \p dims.
+ */
+void partition_dims_order(int dims, int *order);
+
+/**
+ * @brief Reorders the dimensions of a shape.
+ * @param shp Shape to reorder. Null shapes are returned unchanged.
+ * @param order Dimension order, as returned by partition_dims_order().
+ * @param inverse Whether to revert the order instead of applying it.
+ * @return The reordered shape.
+ */
+HitShape shape_reorder(HitShape shp, const int *order, bool inverse);
+
+/** Extra cost of a non-contiguous halo byte in select_auto_partition(), for packing and unpacking */
+#define EPSILOD_AUTO_PACK_WEIGHT 1.0
+
+/**
+ * @brief Selects the partition for EPSILOD_PARTITION=auto.
+ * Candidates are the regular partitions (m<n_dims>, s<dim> and n<dim>) with the balanced process grid built by the topology.
+ * Each one is scored by the halo bytes exchanged by a block with its neighbours, using the stencil radii and active borders.
+ * @param shp_inner Shape to distribute.
+ * @param borders Stencil border sizes.
+ * @param stencil The stencil tile.
+ * @return The partition with the smallest halo cost. m if no candidate has enough data for the processes.
+ */
+PartitionInfo select_auto_partition(HitShape shp_inner, EpsilodBorders borders, HitTile_float stencil);
+
 /**
  * @brief Sorts border tiles indexes used in communication patterns
  * @param tiles Tiles used in EPSILOD.
@@ -217,7 +337,7 @@ EpsilodTiles *create_tiles(PCtrl comm, HitLayout lay, HitTile(EPSILOD_BASE_TYPE)
  * @param comm_args Data needed for communications.
  * @param sorted_comm_indexes Sorted inbound border indexes.
  * @param lay The HitLayout used in the stencil computation.
- * @param HIT_CELL Hitmap type of domain cells.
+ * @param HIT_CELL Hitmap type of domain cells. Only used if the comm_args do not define a type for each border.
  * @return
  */
 HitPattern create_comm_pattern(PCtrl comm, EpsilodTiles *p_tiles, EpsilodCommArgs comm_args, CommCompIndex *sorted_comm_indexes, HitLayout lay, HitType HIT_CELL);
@@ -255,6 +375,26 @@ EpsilodThreads get_threads(EpsilodTiles tiles);
  */
 EpsilodThreads get_chars(int dims, Ctrl_Type ctrl_type, EpsilodTiles tiles);
 
+/**
+ * @brief Frees the thread spaces or block sizes of the contiguous buffers.
+ * @param p_threads Pointer to the threads returned by get_threads() or get_chars().
+ */
+void free_threads(EpsilodThreads *p_threads);
+
+/**
+ * @brief Sets the number of kernel compute threads to spawn based on the cardinalities of a tile.
+ * @param p_tile A pointer to the tile of reference.
+ * @return A Ctrl_Thread with the corresponding number of threads for each dimension.
+ */
+Ctrl_Thread init_thread_from_tile(HitTile(EPSILOD_BASE_TYPE) * p_tile);
+
+/**
+ * @brief Retrieve a block suitable for computations where each device thread accesses only a single element.
+ * @param shape The shape of the tiles that will be used
+ * @return The block dimensions
+ */
+Ctrl_Thread get_char_from_shape(HitShape shape);
+
 #ifdef _EPS_ALB_EXP_MODE_
 /**
  * @brief Allocate memory for ALB exp output (currently 128 bytes per iter)
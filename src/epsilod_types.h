@@ -54,21 +54,26 @@
 #endif // !EPSILOD_USER_TYPES
 
 /* Other types used in user declared functions */
-#define EPSILOD_MAX_DIMS 4
+#define EPSILOD_MAX_DIMS       4
+#define EPSILOD_MAX_COMPONENTS 32
 #ifndef CTRL_USER_TYPES
-#define CTRL_USER_TYPES                          \
-	EPSILOD_USER_TYPES                           \
-	typedef struct {                             \
-		int low[EPSILOD_MAX_DIMS];               \
-		int high[EPSILOD_MAX_DIMS];              \
-	} EpsilodBorders;                            \
-	typedef struct {                             \
-		int            dims;                     \
-		HitInd         size[EPSILOD_MAX_DIMS];   \
-		HitInd         offset[EPSILOD_MAX_DIMS]; \
-		HitInd         inner_last_dim_offset;    \
-		EpsilodBorders borders;                  \
-	} EpsilodCoords;
+#define CTRL_USER_TYPES                                      \
+	EPSILOD_USER_TYPES                                       \
+	typedef struct {                                         \
+		int low[EPSILOD_MAX_DIMS];                           \
+		int high[EPSILOD_MAX_DIMS];                          \
+	} EpsilodBorders;                                        \
+	typedef struct {                                         \
+		int            dims;                                 \
+		HitInd         size[EPSILOD_MAX_DIMS];               \
+		HitInd         offset[EPSILOD_MAX_DIMS];             \
+		HitInd         inner_last_dim_offset;                \
+		EpsilodBorders borders;                              \
+	} EpsilodCoords;                                         \
+	typedef struct {                                         \
+		int           count;                                 \
+		unsigned char index[EPSILOD_MAX_COMPONENTS];         \
+	} EpsilodComponentMask;
 #endif // !CTRL_USER_TYPES
 
 #endif // _EPSILOD_TYPES_H_
@@ -0,0 +1,213 @@
+/**
+ * @file epsilod_weights.c
+ * @brief Epsilod: Initial partition weights, calibrated at startup or learned by ALB and kept in a cache file
+ *
+ * @copyright This software is part of the EPSILOD project by Trasgo Group, UVa.
+ * The relevant license, warranty and copyright notice is available in the EPSILOD project repository.
+ */
+
+// Needed for getline
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <string.h>
+
+#include "epsilod_weights.h"
+#include "epsilod_env.h"
+#include "epsilod_log.h"
+
+/**
+ * Weights learned in this or a previous run
+ */
+static struct {
+	unsigned long long key;       /**< Cache key of the run */
+	bool               loaded;    /**< Whether the cache has been read */
+	bool               dirty;     /**< Whether the weights have changed since the cache was read */
+	int                num_procs; /**< Number of weights. 0 if none has been learned */
+	float             *ratios;    /**< Weights of the processes */
+} learned;
+
+/**
+ * @brief Adds bytes to a FNV-1a hash.
+ * @param hash Current hash.
+ * @param data Bytes to add.
+ * @param size Number of bytes.
+ * @return The new hash.
+ */
+static unsigned long long hash_bytes(unsigned long long hash, const void *data, size_t size) {
+	const unsigned char *bytes = data;
+	for (size_t i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+void epsilod_weights_key(const char *device_selection_file, int dims, const HitInd *sizes, EpsilodBorders borders) {
+	unsigned long long hash = 0xcbf29ce484222325ULL;
+
+	// Device configuration: contents of the file, or its name if it cannot be read
+	FILE *file = (device_selection_file != NULL) ? fopen(device_selection_file, "rb") : NULL;
+	if (file != NULL) {
+		char   buffer[4096];
+		size_t size;
+		while ((size = fread(buffer, 1, sizeof(buffer), file)) > 0)
+			hash = hash_bytes(hash, buffer, size);
+		fclose(file);
+	} else if (device_selection_file != NULL)
+		hash = hash_bytes(hash, device_selection_file, strlen(device_selection_file));
+	hash = hash_bytes(hash, &hit_NProcs, sizeof(hit_NProcs));
+
+	// Problem class
+	PartitionInfo info      = get_partition_info(dims);
+	size_t        cell_size = sizeof(EPSILOD_BASE_TYPE);
+	hash                    = hash_bytes(hash, &dims, sizeof(dims));
+	hash                    = hash_bytes(hash, sizes, sizeof(HitInd) * dims);
+	hash                    = hash_bytes(hash, borders.low, sizeof(HitInd) * dims);
+	hash                    = hash_bytes(hash, borders.high, sizeof(HitInd) * dims);
+	hash                    = hash_bytes(hash, &cell_size, sizeof(cell_size));
+	hash                    = hash_bytes(hash, &info, sizeof(info));
+	learned.key             = hash;
+}
+
+/**
+ * @brief Sets the learned weights.
+ * @param num_procs Number of weights.
+ * @param ratios Weights of the processes.
+ */
+static void set_learned(int num_procs, const float *ratios) {
+	if (learned.num_procs != num_procs) {
+		free(learned.ratios);
+		learned.ratios    = malloc(sizeof(float) * num_procs);
+		learned.num_procs = num_procs;
+	}
+	memcpy(learned.ratios, ratios, sizeof(float) * num_procs);
+}
+
+/**
+ * @brief Reads the weights of the current key from the cache file. The first process reads the file.
+ */
+static void load_cache() {
+	int    num_procs = 0;
+	float *ratios    = NULL;
+	char  *path      = epsilod_weights_cache();
+	if (hit_Rank == 0 && path != NULL) {
+		FILE *file = fopen(path, "r");
+		if (file != NULL) {
+			unsigned long long key;
+			int                num;
+			while (fscanf(file, "%llx %d", &key, &num) == 2 && num > 0) {
+				float *line = malloc(sizeof(float) * num);
+				bool   ok   = true;
+				for (int i = 0; i < num && ok; i++)
+					ok = fscanf(file, "%f", &line[i]) == 1;
+				if (ok && key == learned.key && num == hit_NProcs) {
+					free(ratios);
+					ratios    = line;
+					num_procs = num;
+				} else
+					free(line);
+				if (!ok) break;
+			}
+			fclose(file);
+		}
+	}
+
+	int ok = MPI_Bcast(&num_procs, 1, MPI_INT, 0, hit_Comm);
+	hit_mpiTestError(ok, "Failed broadcasting the cached weights");
+	if (num_procs == 0)
+		return;
+	if (ratios == NULL)
+		ratios = malloc(sizeof(float) * num_procs);
+	ok = MPI_Bcast(ratios, num_procs, MPI_FLOAT, 0, hit_Comm);
+	hit_mpiTestError(ok, "Failed broadcasting the cached weights");
+	set_learned(num_procs, ratios);
+	free(ratios);
+	print_once("Epsilod weights: loaded from the cache %s\n", path);
+}
+
+void epsilod_weights_save() {
+	char *path = epsilod_weights_cache();
+	if (hit_Rank != 0 || path == NULL || !learned.dirty)
+		return;
+	learned.dirty = false;
+
+	// Keep the entries of other keys
+	char *others = NULL;
+	FILE *file   = fopen(path, "r");
+	if (file != NULL) {
+		fseek(file, 0, SEEK_END);
+		long size = ftell(file);
+		fseek(file, 0, SEEK_SET);
+		others       = calloc(size + 1, 1);
+		char  *end   = others;
+		char  *line  = NULL;
+		size_t len   = 0;
+		while (getline(&line, &len, file) != -1) {
+			unsigned long long key;
+			if (sscanf(line, "%llx", &key) == 1 && key == learned.key)
+				continue;
+			strcpy(end, line);
+			end += strlen(line);
+		}
+		free(line);
+		fclose(file);
+	}
+
+	file = fopen(path, "w");
+	if (file == NULL) {
+		fprintf(stderr, "Warning: Epsilod weights cache %s cannot be written\n", path);
+		free(others);
+		return;
+	}
+	if (others != NULL)
+		fputs(others, file);
+	fprintf(file, "%016llx %d", learned.key, learned.num_procs);
+	for (int i = 0; i < learned.num_procs; i++)
+		fprintf(file, " %g", learned.ratios[i]);
+	fprintf(file, "\n");
+	fclose(file);
+	free(others);
+}
+
+HitWeights epsilod_weights() {
+	if (!learned.loaded) {
+		learned.loaded = true;
+		load_cache();
+	}
+	if (learned.num_procs > 0)
+		return hitWeights(learned.num_procs, learned.ratios);
+	return Ctrl_GetWeights();
+}
+
+bool epsilod_weights_learned() {
+	return learned.num_procs > 0;
+}
+
+void epsilod_weights_update(HitWeights weights) {
+	set_learned(weights.num_procs, weights.ratios);
+	learned.loaded = true;
+	learned.dirty  = true;
+}
+
+HitWeights epsilod_weights_from_times(double local_size, double time) {
+	HitTopology topo       = hit_topology(plug_topPlain);
+	int         num_procs  = hit_topDimCard(topo, 0);
+	double      throughput = (time > 0.0) ? local_size / time : 0.0;
+	double     *all        = malloc(sizeof(double) * num_procs);
+	int         ok         = MPI_Allgather(&throughput, 1, MPI_DOUBLE, all, 1, MPI_DOUBLE, topo.pTopology->comm);
+	hit_mpiTestError(ok, "Failed gathering the calibration times");
+	hit_topFree(topo);
+
+	float ratios[num_procs];
+	bool  any = false;
+	for (int i = 0; i < num_procs; i++) {
+		ratios[i] = (float)all[i];
+		any       = any || all[i] > 0.0;
+	}
+	if (!any) ratios[0] = 1;
+	free(all);
+
+	epsilod_weights_update(hitWeights(num_procs, ratios));
+	return hitWeights(learned.num_procs, learned.ratios);
+}
@@ -0,0 +1,68 @@
+/**
+ * @file epsilod_weights.h
+ * @brief Epsilod: Initial partition weights, calibrated at startup or learned by ALB and kept in a cache file
+ *
+ * @copyright This software is part of the EPSILOD project by Trasgo Group, UVa.
+ * The relevant license, warranty and copyright notice is available in the EPSILOD project repository.
+ */
+
+#ifndef _EPSILOD_WEIGHTS_H_
+#define _EPSILOD_WEIGHTS_H_
+
+#include "epsilod_structs.h"
+
+/**
+ * Number of timed iterations of the startup calibration. The first one is not used
+ */
+#define EPSILOD_CALIBRATION_ITERS 5
+
+/**
+ * @brief Computes the cache key of the current run.
+ * The key identifies the device configuration and the problem class: contents of the device selection
+ * file, number of processes, domain sizes, stencil radii, cell size and partition.
+ * It must be called by all the processes before epsilod_weights().
+ * @param device_selection_file Controller device configuration file.
+ * @param dims Number of dimensions of the domain.
+ * @param sizes Sizes of the domain.
+ * @param borders Stencil border sizes.
+ */
+void epsilod_weights_key(const char *device_selection_file, int dims, const HitInd *sizes, EpsilodBorders borders);
+
+/**
+ * @brief Weights for the initial weighted partition.
+ * They are the last ones set with epsilod_weights_update(), or the ones cached for the key of the run in the
+ * file given by EPSILOD_WEIGHTS_CACHE, or the ones in the device selection file, in this order.
+ * It must be called by all the processes.
+ * @return The weights of the processes.
+ */
+HitWeights epsilod_weights();
+
+/**
+ * @brief Whether the weights returned by epsilod_weights() were learned in this or a previous run.
+ * @return true if they come from the cache or an update, false if they come from the device selection file.
+ */
+bool epsilod_weights_learned();
+
+/**
+ * @brief Sets the weights learned by calibration or ALB. They are stored at the end of the run. @see epsilod_weights_save()
+ * @param weights The weights of the processes.
+ */
+void epsilod_weights_update(HitWeights weights);
+
+/**
+ * @brief Writes the learned weights in the cache file if there is one and they have changed,
+ * replacing the previous ones of the same key. Only the first process writes the file.
+ */
+void epsilod_weights_save();
+
+/**
+ * @brief Weights proportional to the throughput measured in each process.
+ * They are set as the learned weights. @see epsilod_weights_update()
+ * Collective on the processes of the plain topology, like the ALB time exchanges.
+ * @param local_size Local size: rows of the partitioned dimension for w partitions, cells for g partitions.
+ * @param time Average load of the process. 0 if it is not active.
+ * @return The weights of the processes.
+ */
+HitWeights epsilod_weights_from_times(double local_size, double time);
+
+#endif // _EPSILOD_WEIGHTS_H_